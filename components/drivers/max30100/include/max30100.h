@@ -0,0 +1,116 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#define MAX30100_ADDR       0x57 // 7-bit I2C address
+#define MAX30100_FIFO_DEPTH 16
+#define MAX30100_RING_SIZE  256 // must be a power of two
+
+// INT pin of the sensor (open-drain, active low). GPIO_NUM_NC falls back to polling.
+#ifndef MAX30100_INT_GPIO
+#define MAX30100_INT_GPIO GPIO_NUM_27
+#endif
+
+typedef enum {
+    MAX30100_MODE_HR_ONLY = 0x02,
+    MAX30100_MODE_SPO2_HR = 0x03,
+} max30100_mode_t;
+
+typedef enum {
+    MAX30100_SAMPLING_RATE_50HZ = 0,
+    MAX30100_SAMPLING_RATE_100HZ,
+    MAX30100_SAMPLING_RATE_167HZ,
+    MAX30100_SAMPLING_RATE_200HZ,
+    MAX30100_SAMPLING_RATE_400HZ,
+    MAX30100_SAMPLING_RATE_600HZ,
+    MAX30100_SAMPLING_RATE_800HZ,
+    MAX30100_SAMPLING_RATE_1000HZ,
+} max30100_sampling_rate_t;
+
+typedef enum {
+    MAX30100_PULSE_WIDTH_200US_ADC_13 = 0,
+    MAX30100_PULSE_WIDTH_400US_ADC_14,
+    MAX30100_PULSE_WIDTH_800US_ADC_15,
+    MAX30100_PULSE_WIDTH_1600US_ADC_16,
+} max30100_pulse_width_t;
+
+typedef enum {
+    MAX30100_LED_CURRENT_0MA = 0,
+    MAX30100_LED_CURRENT_4_4MA,
+    MAX30100_LED_CURRENT_7_6MA,
+    MAX30100_LED_CURRENT_11MA,
+    MAX30100_LED_CURRENT_14_2MA,
+    MAX30100_LED_CURRENT_17_4MA,
+    MAX30100_LED_CURRENT_20_8MA,
+    MAX30100_LED_CURRENT_24MA,
+    MAX30100_LED_CURRENT_27_1MA,
+    MAX30100_LED_CURRENT_30_6MA,
+    MAX30100_LED_CURRENT_33_8MA,
+    MAX30100_LED_CURRENT_37MA,
+    MAX30100_LED_CURRENT_40_2MA,
+    MAX30100_LED_CURRENT_43_6MA,
+    MAX30100_LED_CURRENT_46_8MA,
+    MAX30100_LED_CURRENT_50MA,
+} max30100_current_t;
+
+// Which sensor interrupt wakes the acquisition task
+typedef enum {
+    MAX30100_INT_FIFO_ALMOST_FULL, // one burst per 15 samples, fewest bus transactions
+    MAX30100_INT_SPO2_READY,       // one burst per sample, lowest latency
+} max30100_int_source_t;
+
+typedef struct {
+    max30100_mode_t mode;
+    max30100_sampling_rate_t sampling_rate;
+    max30100_pulse_width_t pulse_width;
+    max30100_current_t ir_current;
+    max30100_current_t red_current;
+    bool high_res_mode;
+    gpio_num_t int_gpio;
+    max30100_int_source_t int_source;
+} max30100_config_t;
+
+typedef struct {
+    uint16_t ir;
+    uint16_t red;
+    int64_t timestamp_us;
+} max30100_sample_t;
+
+typedef struct {
+    uint32_t samples;        // samples pushed into the ring
+    uint32_t bursts;         // FIFO drains (one multi-byte read each)
+    uint32_t fifo_overflows; // samples lost inside the sensor FIFO
+    uint32_t ring_overflows; // samples dropped because the consumer fell behind
+    uint32_t i2c_errors;
+    uint32_t poll_wakeups;   // drains triggered by timeout instead of INT
+} max30100_stats_t;
+
+esp_err_t max30100_init(const max30100_config_t *cfg);
+
+// Spawns the acquisition task that drains the FIFO on every INT edge
+esp_err_t max30100_start_acquisition(void);
+
+// Pops up to max buffered samples (oldest first); returns the number copied
+size_t max30100_read_samples(max30100_sample_t *out, size_t max);
+
+esp_err_t max30100_set_led_current(max30100_current_t red, max30100_current_t ir);
+
+// Changes rate and pulse width while running; the FIFO is cleared so every
+// later sample is timed at the new rate. Not every pair is valid in SpO2
+// mode (see the datasheet's allowed-settings table).
+esp_err_t max30100_set_sampling(max30100_sampling_rate_t rate, max30100_pulse_width_t pw);
+
+// false: LEDs off and SHDN set, the acquisition task stops touching the bus.
+// true: FIFO cleared and the configured mode and LED currents restored.
+// Register contents survive, so waking takes a few bus writes.
+esp_err_t max30100_set_power(bool on);
+
+uint32_t max30100_sample_rate_hz(max30100_sampling_rate_t rate);
+
+// Largest raw sample value for a pulse width
+uint32_t max30100_adc_full_scale(max30100_pulse_width_t pw);
+
+void max30100_get_stats(max30100_stats_t *out);
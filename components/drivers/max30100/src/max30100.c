@@ -0,0 +1,390 @@
+#include "max30100.h"
+#include "i2c_common.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#define MAX30100_REG_INT_STATUS  0x00
+#define MAX30100_REG_INT_ENABLE  0x01
+#define MAX30100_REG_FIFO_WR_PTR 0x02
+#define MAX30100_REG_FIFO_OVF    0x03
+#define MAX30100_REG_FIFO_RD_PTR 0x04
+#define MAX30100_REG_FIFO_DATA   0x05
+#define MAX30100_REG_MODE_CONFIG 0x06
+#define MAX30100_REG_SPO2_CONFIG 0x07
+#define MAX30100_REG_LED_CONFIG  0x09
+#define MAX30100_REG_PART_ID     0xFF
+
+#define MAX30100_PART_ID        0x11
+#define MAX30100_MODE_SHDN      0x80
+#define MAX30100_MODE_RESET     0x40
+#define MAX30100_SPO2_HI_RES_EN 0x40
+#define MAX30100_INT_A_FULL     0x80
+#define MAX30100_INT_SPO2_RDY   0x10
+
+#define MAX30100_BYTES_PER_SAMPLE 4
+#define MAX30100_I2C_TIMEOUT      pdMS_TO_TICKS(100)
+#define MAX30100_I2C_CLK_HZ       400000 // fast-mode keeps FIFO bursts short
+
+static const char *TAG = "MAX30100";
+
+static max30100_config_t s_cfg;
+static TaskHandle_t s_acq_task = NULL;
+static volatile int64_t s_irq_time_us = 0;
+static uint32_t s_period_us = 10000;
+static volatile bool s_shutdown = false;
+
+// Single-producer (acquisition task) / single-consumer (health tracker) ring
+static max30100_sample_t s_ring[MAX30100_RING_SIZE];
+static atomic_uint s_ring_head = 0;
+static atomic_uint s_ring_tail = 0;
+
+static max30100_stats_t s_stats;
+
+static esp_err_t max30100_write_reg(uint8_t reg, uint8_t value)
+{
+    uint8_t buf[2] = {reg, value};
+    return i2c_common_write_to_device(I2C_MASTER_NUM, MAX30100_ADDR, buf, sizeof(buf), MAX30100_I2C_TIMEOUT);
+}
+
+// FIFO traffic goes ahead of any queued low-priority bus work
+static esp_err_t max30100_read_regs(uint8_t reg, uint8_t *out, size_t len)
+{
+    i2c_txn_t txn = {
+        .addr = MAX30100_ADDR,
+        .write_buf = &reg,
+        .write_size = 1,
+        .read_buf = out,
+        .read_size = len,
+        .timeout = MAX30100_I2C_TIMEOUT,
+        .prio = I2C_PRIO_HIGH,
+    };
+    return i2c_bus_transfer(&txn);
+}
+
+uint32_t max30100_sample_rate_hz(max30100_sampling_rate_t rate)
+{
+    static const uint16_t rates[] = {50, 100, 167, 200, 400, 600, 800, 1000};
+    return rate <= MAX30100_SAMPLING_RATE_1000HZ ? rates[rate] : 100;
+}
+
+uint32_t max30100_adc_full_scale(max30100_pulse_width_t pw)
+{
+    // 13 to 16 bit ADC resolution, one bit per pulse width step
+    return (1u << (13 + (pw & 0x03))) - 1;
+}
+
+static void IRAM_ATTR max30100_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    s_irq_time_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(s_acq_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void ring_push(const max30100_sample_t *s)
+{
+    unsigned head = atomic_load_explicit(&s_ring_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&s_ring_tail, memory_order_acquire);
+    if (head - tail >= MAX30100_RING_SIZE)
+    {
+        s_stats.ring_overflows++;
+        return;
+    }
+    s_ring[head & (MAX30100_RING_SIZE - 1)] = *s;
+    atomic_store_explicit(&s_ring_head, head + 1, memory_order_release);
+}
+
+size_t max30100_read_samples(max30100_sample_t *out, size_t max)
+{
+    unsigned tail = atomic_load_explicit(&s_ring_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&s_ring_head, memory_order_acquire);
+    size_t n = 0;
+    while (tail != head && n < max)
+    {
+        out[n++] = s_ring[tail & (MAX30100_RING_SIZE - 1)];
+        tail++;
+    }
+    atomic_store_explicit(&s_ring_tail, tail, memory_order_release);
+    return n;
+}
+
+// Drains the whole FIFO: one pointer read plus one burst read of all pending samples
+static esp_err_t max30100_drain_fifo(int64_t newest_us)
+{
+    // Status read (clears INT) and pointer read go out as one chained transfer
+    static const uint8_t status_reg = MAX30100_REG_INT_STATUS;
+    static const uint8_t ptr_reg = MAX30100_REG_FIFO_WR_PTR;
+    uint8_t status;
+    uint8_t ptr[3]; // WR_PTR, OVF_COUNTER, RD_PTR
+    i2c_txn_t ptr_txn = {
+        .addr = MAX30100_ADDR,
+        .write_buf = &ptr_reg,
+        .write_size = 1,
+        .read_buf = ptr,
+        .read_size = sizeof(ptr),
+        .timeout = MAX30100_I2C_TIMEOUT,
+        .prio = I2C_PRIO_HIGH,
+    };
+    i2c_txn_t status_txn = {
+        .addr = MAX30100_ADDR,
+        .write_buf = &status_reg,
+        .write_size = 1,
+        .read_buf = &status,
+        .read_size = 1,
+        .timeout = MAX30100_I2C_TIMEOUT,
+        .prio = I2C_PRIO_HIGH,
+        .next = &ptr_txn,
+    };
+    esp_err_t err = i2c_bus_transfer(&status_txn);
+    if (err != ESP_OK)
+        return err;
+
+    size_t count = (ptr[0] - ptr[2]) & (MAX30100_FIFO_DEPTH - 1);
+    if (ptr[1] > 0)
+    {
+        s_stats.fifo_overflows += ptr[1];
+        count = MAX30100_FIFO_DEPTH;
+    }
+    if (count == 0)
+        return ESP_OK;
+
+    uint8_t raw[MAX30100_FIFO_DEPTH * MAX30100_BYTES_PER_SAMPLE];
+    err = max30100_read_regs(MAX30100_REG_FIFO_DATA, raw, count * MAX30100_BYTES_PER_SAMPLE);
+    if (err != ESP_OK)
+        return err;
+
+    // The newest sample was taken at the interrupt; older ones are one period apart
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t *p = &raw[i * MAX30100_BYTES_PER_SAMPLE];
+        max30100_sample_t s = {
+            .ir = (uint16_t)((p[0] << 8) | p[1]),
+            .red = (uint16_t)((p[2] << 8) | p[3]),
+            .timestamp_us = newest_us - (int64_t)(count - 1 - i) * s_period_us,
+        };
+        ring_push(&s);
+    }
+
+    s_stats.samples += count;
+    s_stats.bursts++;
+    return ESP_OK;
+}
+
+// Expected time to fill the FIFO; waiting twice that catches a missed edge
+static TickType_t max30100_poll_ticks(void)
+{
+    uint32_t burst = (s_cfg.int_source == MAX30100_INT_FIFO_ALMOST_FULL) ? MAX30100_FIFO_DEPTH - 1 : 1;
+    if (s_cfg.int_gpio == GPIO_NUM_NC)
+        return pdMS_TO_TICKS((burst * s_period_us) / 1000) + 1;
+    return pdMS_TO_TICKS((2 * burst * s_period_us) / 1000) + 1;
+}
+
+static void max30100_acq_task(void *pv)
+{
+    for (;;)
+    {
+        // No samples and no polling while the sensor is shut down
+        if (s_shutdown)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        int64_t newest_us;
+        if (ulTaskNotifyTake(pdTRUE, max30100_poll_ticks()) > 0)
+        {
+            newest_us = s_irq_time_us;
+        }
+        else
+        {
+            newest_us = esp_timer_get_time();
+            s_stats.poll_wakeups++;
+        }
+
+        if (max30100_drain_fifo(newest_us) != ESP_OK)
+        {
+            s_stats.i2c_errors++;
+        }
+    }
+}
+
+esp_err_t max30100_init(const max30100_config_t *cfg)
+{
+    if (cfg == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    s_cfg = *cfg;
+    s_period_us = 1000000 / max30100_sample_rate_hz(cfg->sampling_rate);
+
+    i2c_device_profile_t profile = {
+        .addr = MAX30100_ADDR,
+        .clk_hz = MAX30100_I2C_CLK_HZ,
+        .timeout = MAX30100_I2C_TIMEOUT,
+    };
+    i2c_common_register_device(&profile);
+
+    uint8_t part_id = 0;
+    esp_err_t err = max30100_read_regs(MAX30100_REG_PART_ID, &part_id, 1);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Sensor not responding: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (part_id != MAX30100_PART_ID)
+    {
+        ESP_LOGE(TAG, "Unexpected part id 0x%02X", part_id);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    err = max30100_write_reg(MAX30100_REG_MODE_CONFIG, MAX30100_MODE_RESET);
+    if (err != ESP_OK)
+        return err;
+    vTaskDelay(pdMS_TO_TICKS(10));
+
+    uint8_t spo2_cfg = (uint8_t)((cfg->sampling_rate << 2) | cfg->pulse_width);
+    if (cfg->high_res_mode)
+        spo2_cfg |= MAX30100_SPO2_HI_RES_EN;
+
+    uint8_t int_en = (cfg->int_source == MAX30100_INT_FIFO_ALMOST_FULL) ? MAX30100_INT_A_FULL : MAX30100_INT_SPO2_RDY;
+
+    if ((err = max30100_write_reg(MAX30100_REG_SPO2_CONFIG, spo2_cfg)) != ESP_OK ||
+        (err = max30100_set_led_current(cfg->red_current, cfg->ir_current)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_FIFO_WR_PTR, 0)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_FIFO_OVF, 0)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_FIFO_RD_PTR, 0)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_INT_ENABLE, int_en)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_MODE_CONFIG, cfg->mode)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Configuration failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Initialized at %lu Hz", (unsigned long)max30100_sample_rate_hz(cfg->sampling_rate));
+    return ESP_OK;
+}
+
+esp_err_t max30100_start_acquisition(void)
+{
+    if (s_acq_task != NULL)
+        return ESP_OK;
+
+    if (xTaskCreate(max30100_acq_task, "max30100_acq", 3072, NULL, 5, &s_acq_task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create acquisition task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (s_cfg.int_gpio == GPIO_NUM_NC)
+    {
+        ESP_LOGW(TAG, "No INT pin configured, polling FIFO");
+        return ESP_OK;
+    }
+
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_NEGEDGE,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .pin_bit_mask = 1ULL << s_cfg.int_gpio,
+    };
+    esp_err_t err = gpio_config(&io_conf);
+    if (err != ESP_OK)
+        return err;
+
+    // The button driver may already have installed the shared ISR service
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+        return err;
+
+    err = gpio_isr_handler_add(s_cfg.int_gpio, max30100_isr, NULL);
+    if (err != ESP_OK)
+        return err;
+
+    // Clear anything latched before the handler existed so the line is released
+    uint8_t status;
+    max30100_read_regs(MAX30100_REG_INT_STATUS, &status, 1);
+    return ESP_OK;
+}
+
+esp_err_t max30100_set_led_current(max30100_current_t red, max30100_current_t ir)
+{
+    s_cfg.red_current = red;
+    s_cfg.ir_current = ir;
+    // Applied on wake-up; the LEDs stay dark while shut down
+    if (s_shutdown)
+        return ESP_OK;
+    return max30100_write_reg(MAX30100_REG_LED_CONFIG, (uint8_t)((red << 4) | ir));
+}
+
+esp_err_t max30100_set_sampling(max30100_sampling_rate_t rate, max30100_pulse_width_t pw)
+{
+    uint8_t spo2_cfg = (uint8_t)((rate << 2) | pw);
+    if (s_cfg.high_res_mode)
+        spo2_cfg |= MAX30100_SPO2_HI_RES_EN;
+
+    // Samples already in the FIFO were taken with the old timing; drop them
+    esp_err_t err;
+    if ((err = max30100_write_reg(MAX30100_REG_SPO2_CONFIG, spo2_cfg)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_FIFO_WR_PTR, 0)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_FIFO_OVF, 0)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_FIFO_RD_PTR, 0)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Sampling change failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_cfg.sampling_rate = rate;
+    s_cfg.pulse_width = pw;
+    s_period_us = 1000000 / max30100_sample_rate_hz(rate);
+    ESP_LOGI(TAG, "Sampling at %lu Hz", (unsigned long)max30100_sample_rate_hz(rate));
+    return ESP_OK;
+}
+
+esp_err_t max30100_set_power(bool on)
+{
+    esp_err_t err;
+    if (!on)
+    {
+        if (s_shutdown)
+            return ESP_OK;
+        s_shutdown = true;
+        if ((err = max30100_write_reg(MAX30100_REG_LED_CONFIG, 0)) != ESP_OK ||
+            (err = max30100_write_reg(MAX30100_REG_MODE_CONFIG, s_cfg.mode | MAX30100_MODE_SHDN)) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Shutdown failed: %s", esp_err_to_name(err));
+            s_shutdown = false;
+            return err;
+        }
+        ESP_LOGI(TAG, "Shut down");
+        return ESP_OK;
+    }
+
+    if (!s_shutdown)
+        return ESP_OK;
+
+    // Registers survive shutdown; only the FIFO and LEDs need restoring
+    if ((err = max30100_write_reg(MAX30100_REG_FIFO_WR_PTR, 0)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_FIFO_OVF, 0)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_FIFO_RD_PTR, 0)) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_LED_CONFIG, (uint8_t)((s_cfg.red_current << 4) | s_cfg.ir_current))) != ESP_OK ||
+        (err = max30100_write_reg(MAX30100_REG_MODE_CONFIG, s_cfg.mode)) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Wake-up failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    s_shutdown = false;
+    if (s_acq_task)
+        xTaskNotifyGive(s_acq_task);
+    ESP_LOGI(TAG, "Woken up");
+    return ESP_OK;
+}
+
+void max30100_get_stats(max30100_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -1,4 +1,19 @@
 #pragma once
+#include <stdint.h>
 #include "esp_err.h"
 
+#define MLX90614_ADDR 0x5A // 7-bit I2C (SMBus) address
+
+typedef struct {
+    float object_c;       // object (skin) temperature, register 0x07
+    float ambient_c;      // sensor die temperature, register 0x06
+    int64_t timestamp_us;
+} mlx90614_reading_t;
+
+// Registers the SMBus-safe bus profile; safe to call more than once
+esp_err_t mlx90614_init(void);
+
+// Reads object and ambient temperature in one bus transfer, both PEC-checked
+esp_err_t mlx90614_read(mlx90614_reading_t *out);
+
 float mlx90614_read_temp(void);
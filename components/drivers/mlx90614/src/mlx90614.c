@@ -1,75 +1,161 @@
 #include "mlx90614.h"
 #include "i2c_common.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
-#define MLX90614_ADDR     0x5A
+#define MLX90614_AMBIENT_TEMP 0x06
 #define MLX90614_BODY_TEMP 0x07
 #define MLX90614_ERROR_FLAG 0x8000  
+#define MLX90614_TIMEOUT_MS 50      // bounds how long one read can hold the bus
+#define MLX90614_CLK_HZ     100000  // SMBus devices stay at standard mode
 
 static const char *TAG = "MLX90614";
 
-static uint8_t mlx90614_calc_pec(uint8_t pec, uint8_t data)
+// CRC-8, polynomial x^8 + x^2 + x + 1 (SMBus PEC)
+static const uint8_t s_crc8_table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+static inline uint8_t mlx90614_calc_pec(uint8_t pec, uint8_t data)
 {
-    pec ^= data;
-    for (uint8_t i = 8; i > 0; --i) {
-        if (pec & 0x80) {
-            pec = (pec << 1) ^ 0x07;
-        } else {
-            pec <<= 1;
-        }
-    }
-    return pec;
+    return s_crc8_table[pec ^ data];
 }
 
-float mlx90614_read_temp(void)
+// PEC over the constant frame prefix: addr+W, command, addr+R
+static uint8_t mlx90614_pec_prefix(uint8_t cmd)
 {
-    uint8_t cmd = MLX90614_BODY_TEMP;
-    uint8_t buf[3] = {0};
-    
-    esp_err_t ret = i2c_common_write_read_device(I2C_MASTER_NUM, MLX90614_ADDR, &cmd, 1, buf, 3, pdMS_TO_TICKS(2000));
-    
-    //ESP_LOGI(TAG, "Read ret=%d, raw data=%02X %02X %02X", ret, buf[0], buf[1], buf[2]);
-    
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "I2C read failed: %s", esp_err_to_name(ret));
-        return -273.15f;
-    }
-
     uint8_t pec = 0;
     pec = mlx90614_calc_pec(pec, (MLX90614_ADDR << 1));
     pec = mlx90614_calc_pec(pec, cmd);
     pec = mlx90614_calc_pec(pec, (MLX90614_ADDR << 1) | 1);
+    return pec;
+}
+
+// Validates one SMBus read-word frame and converts it to Celsius
+static bool mlx90614_decode(uint8_t cmd, const uint8_t *buf, float *out)
+{
+    uint8_t pec = mlx90614_pec_prefix(cmd);
     pec = mlx90614_calc_pec(pec, buf[0]);
     pec = mlx90614_calc_pec(pec, buf[1]);
-    
+
     //ESP_LOGI(TAG, "PEC calculated: 0x%02X, received: 0x%02X", pec, buf[2]);
-    
+
     if (pec != buf[2]) {
         //ESP_LOGE(TAG, "PEC check failed! Data corrupted.");
-        return -273.15f;
+        i2c_common_report_pec_error(MLX90614_ADDR);
+        return false;
     }
 
     uint16_t raw = buf[0] | (buf[1] << 8);
     
     if (raw & MLX90614_ERROR_FLAG) {
         //ESP_LOGW(TAG, "Error flag set in temperature data (raw: 0x%04X)", raw);
-        return -273.15f;
+        return false;
     }
     
     raw &= 0x7FFF; 
     
     if (raw == 0x0000) {
         //ESP_LOGW(TAG, "Invalid raw data after masking: 0x%04X", raw);
-        return -273.15f;
+        return false;
     }
 
     float temp = raw * 0.02f - 273.15f;
     
     if (temp < -70.0f || temp > 382.0f) {
         //ESP_LOGW(TAG, "Temperature out of valid range: %.2f C (raw: 0x%04X)", temp, raw);
-        return -273.15f;
+        return false;
     }
     
     //ESP_LOGI(TAG, "Valid temperature: %.2f C (raw: 0x%04X)", temp, raw);
+    *out = temp;
+    return true;
+}
+
+esp_err_t mlx90614_init(void)
+{
+    i2c_device_profile_t profile = {
+        .addr = MLX90614_ADDR,
+        .clk_hz = MLX90614_CLK_HZ,
+        .timeout = pdMS_TO_TICKS(MLX90614_TIMEOUT_MS),
+    };
+    return i2c_common_register_device(&profile);
+}
+
+esp_err_t mlx90614_read(mlx90614_reading_t *out)
+{
+    static const uint8_t obj_cmd = MLX90614_BODY_TEMP;
+    static const uint8_t amb_cmd = MLX90614_AMBIENT_TEMP;
+    uint8_t obj_buf[3] = {0};
+    uint8_t amb_buf[3] = {0};
+
+    // Both words go out as one chained transfer (repeated START in between)
+    i2c_txn_t amb = {
+        .addr = MLX90614_ADDR,
+        .write_buf = &amb_cmd,
+        .write_size = 1,
+        .read_buf = amb_buf,
+        .read_size = sizeof(amb_buf),
+        .timeout = pdMS_TO_TICKS(MLX90614_TIMEOUT_MS),
+        .prio = I2C_PRIO_LOW,
+    };
+    i2c_txn_t obj = {
+        .addr = MLX90614_ADDR,
+        .write_buf = &obj_cmd,
+        .write_size = 1,
+        .read_buf = obj_buf,
+        .read_size = sizeof(obj_buf),
+        .timeout = pdMS_TO_TICKS(MLX90614_TIMEOUT_MS),
+        .prio = I2C_PRIO_LOW,
+        .next = &amb,
+    };
+
+    esp_err_t ret = i2c_bus_transfer(&obj);
+    out->timestamp_us = esp_timer_get_time();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "I2C read failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (!mlx90614_decode(obj_cmd, obj_buf, &out->object_c) ||
+        !mlx90614_decode(amb_cmd, amb_buf, &out->ambient_c)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+float mlx90614_read_temp(void)
+{
+    uint8_t cmd = MLX90614_BODY_TEMP;
+    uint8_t buf[3] = {0};
+    
+    esp_err_t ret = i2c_common_write_read_device(I2C_MASTER_NUM, MLX90614_ADDR, &cmd, 1, buf, 3, pdMS_TO_TICKS(MLX90614_TIMEOUT_MS));
+    
+    //ESP_LOGI(TAG, "Read ret=%d, raw data=%02X %02X %02X", ret, buf[0], buf[1], buf[2]);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "I2C read failed: %s", esp_err_to_name(ret));
+        return -273.15f;
+    }
+
+    float temp;
+    if (!mlx90614_decode(cmd, buf, &temp)) {
+        return -273.15f;
+    }
     return temp;
 }
@@ -22,7 +22,8 @@ esp_err_t bluetooth_start_advertising(void);
 
 esp_err_t bluetooth_stop_advertising(void);
 
-esp_err_t bluetooth_notify_heart_rate(uint16_t hr, uint8_t spo2);
+// Payload: HR (uint16 LE), SpO2 %, respiratory rate in breaths/min (0 = unknown)
+esp_err_t bluetooth_notify_heart_rate(uint16_t hr, uint8_t spo2, uint8_t resp_rate);
 esp_err_t bluetooth_notify_temperature(float temp);
 esp_err_t bluetooth_notify_gps(float lat, float lon);
 
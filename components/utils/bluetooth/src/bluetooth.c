@@ -330,7 +330,7 @@ esp_err_t bluetooth_stop_advertising(void)
     return esp_ble_gap_stop_advertising();
 }
 
-esp_err_t bluetooth_notify_heart_rate(uint16_t hr, uint8_t spo2)
+esp_err_t bluetooth_notify_heart_rate(uint16_t hr, uint8_t spo2, uint8_t resp_rate)
 {
     if (!s_ble_connected)
     {
@@ -341,7 +341,7 @@ esp_err_t bluetooth_notify_heart_rate(uint16_t hr, uint8_t spo2)
     hr_data[0] = hr & 0xFF;
     hr_data[1] = (hr >> 8) & 0xFF;
     hr_data[2] = spo2;
-    hr_data[3] = 0; 
+    hr_data[3] = resp_rate;
 
     return esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_handle_table[HEALTH_IDX_HR_VAL],
                                        sizeof(hr_data), hr_data, false);
@@ -2,13 +2,23 @@
 #define HTTP_CLIENT_H
 
 #include <esp_err.h>
+#include <stdint.h>
 
 typedef struct {
     int data_type; 
+    // vitals store sample the reading was produced from (see
+    // vitals_store.h); timestamp_ms is 0 when there is none
+    uint32_t seq;
+    uint32_t timestamp_ms;
     union {
         float temperature;
-        struct { int heart_rate; int spo2; } health;
-        struct { float lat; float lon; } gps;
+        struct { int heart_rate; int spo2; int resp_rate; } health;
+        // track: optional batch from gps_take_track(), heap-allocated by the
+        // sender and freed by the consumer
+        struct { float lat; float lon; uint8_t *track; uint16_t track_len; uint16_t points; } gps;
+        struct { float rmssd; float sdnn; int pnn50; } hrv;
+        struct { int irregular; int score; } rhythm;
+        struct { int zone; int inside; } geofence;
     } data;
 } http_message_t;
 
@@ -9,6 +9,7 @@
 #include "freertos/task.h"
 #include "wifi.h"
 #include <math.h>
+#include <stdlib.h>
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 
@@ -69,6 +70,8 @@ void http_client_task(void *pv)
                 {
                     ESP_LOGW(TAG, "WiFi not connected, skipping request");
                     xSemaphoreGive(http_semaphore);
+                    if (message.data_type == 2)
+                        free(message.data.gps.track);
                     continue;
                 }
 
@@ -86,6 +89,8 @@ void http_client_task(void *pv)
                     http_client_send_gps(
                         message.data.gps.lat,
                         message.data.gps.lon);
+                    // Track batches only go out over MQTT
+                    free(message.data.gps.track);
                     break;
                 }
 
@@ -97,6 +102,8 @@ void http_client_task(void *pv)
             else
             {
                 ESP_LOGW(TAG, "HTTP semaphore timeout");
+                if (message.data_type == 2)
+                    free(message.data.gps.track);
             }
         }
     }
@@ -0,0 +1,284 @@
+// Host run of i2c_common's bus-load accounting on a modelled bus.
+//
+//     i2c_load_sim [--seconds N]    (default 20 per case)
+//
+// i2c_common.c runs unchanged on the stand-ins in host/stubs: the bus task
+// executes when a transaction is queued, and the I2C driver model moves
+// esp_timer on by the bit times of each command link at the SCL clock the
+// bus task programmed. Driver overhead between bytes and clock stretching
+// are not modelled, so the busy times are a floor for the hardware.
+//
+// The traffic is what the drivers put on the bus: max30100_drain_fifo()
+// (status and FIFO pointers as one chain, then the FIFO burst) each time
+// the FIFO is almost full, and mlx90614_read() (object and ambient words as
+// one chain) every TEMP_PERIOD_MS of a temperature scan. Each case runs
+// with the MAX30100 registered at 100 kHz, as before per-device profiles,
+// and at 400 kHz. Bus load is read through i2c_common_get_bus_load() once
+// a second, scaled by its window length and averaged. The run fails if the
+// transfer rates do not match the traffic, if the 400 kHz profile does not
+// cut the busy time at least in half, or if a chain short enough for the
+// static command link went to the heap.
+//
+// A last case checks the per-device telemetry the diagnostics log reads:
+// the bus task is held for CONTENDED_US while a temperature read and a PPG
+// FIFO burst queue up, every NACK_EVERY-th MLX90614 transfer is not
+// acknowledged and every PEC_EVERY-th read reports a PEC failure. Both
+// devices must show the queue wait, the MLX90614 longer since the PPG
+// burst goes first, and only the MLX90614 the faults.
+#include "i2c_common.h"
+#include "max30100.h"
+#include "mlx90614.h"
+#include "esp_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PPG_SAMPLE_SIZE 4
+#define PPG_BURST       (MAX30100_FIFO_DEPTH - 1) // FIFO almost full
+#define TEMP_PERIOD_MS  100
+#define CONTENDED_ROUNDS 200
+#define CONTENDED_US     3000
+#define NACK_EVERY       25
+#define PEC_EVERY        40
+
+typedef struct {
+    const char *name;
+    uint32_t ppg_rate_hz; // 0: PPG off
+    bool temp_scan;
+} sim_case_t;
+
+static const sim_case_t s_cases[] = {
+    {"continuous PPG (100 Hz)", 100, false},
+    {"spot PPG (200 Hz)", 200, false},
+    {"continuous PPG + temperature scan", 100, true},
+    {"temperature scan only", 0, true},
+};
+
+typedef struct {
+    double busy_us; // per second
+    double transfers;
+    double clock_switches;
+    int windows;
+} sim_load_t;
+
+static esp_err_t ppg_drain(void)
+{
+    static const uint8_t status_reg = 0x00, ptr_reg = 0x02, fifo_reg = 0x05;
+    uint8_t status, ptr[3], raw[PPG_BURST * PPG_SAMPLE_SIZE];
+    i2c_txn_t ptr_txn = {
+        .addr = MAX30100_ADDR, .write_buf = &ptr_reg, .write_size = 1, .read_buf = ptr, .read_size = sizeof(ptr),
+        .prio = I2C_PRIO_HIGH,
+    };
+    i2c_txn_t status_txn = {
+        .addr = MAX30100_ADDR, .write_buf = &status_reg, .write_size = 1, .read_buf = &status, .read_size = 1,
+        .prio = I2C_PRIO_HIGH, .next = &ptr_txn,
+    };
+    esp_err_t err = i2c_bus_transfer(&status_txn);
+    if (err != ESP_OK)
+        return err;
+    i2c_txn_t fifo_txn = {
+        .addr = MAX30100_ADDR, .write_buf = &fifo_reg, .write_size = 1, .read_buf = raw, .read_size = sizeof(raw),
+        .prio = I2C_PRIO_HIGH,
+    };
+    return i2c_bus_transfer(&fifo_txn);
+}
+
+static esp_err_t temp_read(void)
+{
+    static const uint8_t obj_cmd = 0x07, amb_cmd = 0x06;
+    uint8_t obj_buf[3], amb_buf[3];
+    i2c_txn_t amb = {
+        .addr = MLX90614_ADDR, .write_buf = &amb_cmd, .write_size = 1, .read_buf = amb_buf, .read_size = 3,
+        .prio = I2C_PRIO_LOW,
+    };
+    i2c_txn_t obj = {
+        .addr = MLX90614_ADDR, .write_buf = &obj_cmd, .write_size = 1, .read_buf = obj_buf, .read_size = 3,
+        .prio = I2C_PRIO_LOW, .next = &amb,
+    };
+    return i2c_bus_transfer(&obj);
+}
+
+static void register_clocks(uint32_t ppg_clk_hz)
+{
+    i2c_device_profile_t ppg = {.addr = MAX30100_ADDR, .clk_hz = ppg_clk_hz, .timeout = pdMS_TO_TICKS(100)};
+    i2c_device_profile_t mlx = {.addr = MLX90614_ADDR, .clk_hz = 100000, .timeout = pdMS_TO_TICKS(50)};
+    i2c_common_register_device(&ppg);
+    i2c_common_register_device(&mlx);
+}
+
+// Runs one case for the given time on a millisecond schedule. *expected
+// counts the bus transfers issued.
+static sim_load_t run(const sim_case_t *c, int seconds, uint32_t *expected, int *errors)
+{
+    sim_load_t load = {0};
+    uint32_t ppg_period_us = c->ppg_rate_hz ? 1000000 / c->ppg_rate_hz * PPG_BURST : 0;
+    int64_t start = esp_timer_get_time(), next_ppg = start, next_temp = start;
+    *expected = 0;
+
+    for (int64_t ms = 0; ms < (int64_t)seconds * 1000; ms++)
+    {
+        int64_t now = esp_timer_get_time();
+        if (ppg_period_us && now >= next_ppg)
+        {
+            *errors += ppg_drain() != ESP_OK;
+            *expected += 2;
+            next_ppg += ppg_period_us;
+        }
+        if (c->temp_scan && now >= next_temp)
+        {
+            *errors += temp_read() != ESP_OK;
+            *expected += 1;
+            next_temp += TEMP_PERIOD_MS * 1000;
+        }
+
+        // Sampled once a second like the diagnostics log does; the first
+        // two windows may still hold the previous case
+        i2c_bus_load_t l;
+        i2c_common_get_bus_load(&l);
+        if (ms % 1000 == 999 && ms >= 2000 && l.window_us > 0)
+        {
+            load.busy_us += l.busy_us * 1e6 / l.window_us;
+            load.transfers += l.transfers * 1e6 / l.window_us;
+            load.clock_switches += l.clock_switches * 1e6 / l.window_us;
+            load.windows++;
+        }
+
+        int64_t target = start + (ms + 1) * 1000;
+        now = esp_timer_get_time();
+        if (now < target)
+            esp_host_skip_time(target - now);
+    }
+    if (load.windows)
+    {
+        load.busy_us /= load.windows;
+        load.transfers /= load.windows;
+        load.clock_switches /= load.windows;
+    }
+    return load;
+}
+
+// Counter increase since before, histograms included
+static void stats_delta(i2c_device_stats_t *now, const i2c_device_stats_t *before)
+{
+    now->transfers -= before->transfers;
+    now->nacks -= before->nacks;
+    now->timeouts -= before->timeouts;
+    now->pec_errors -= before->pec_errors;
+    now->other_errors -= before->other_errors;
+    now->queue_full -= before->queue_full;
+    for (int i = 0; i < I2C_HIST_BUCKETS; i++)
+    {
+        now->wait_hist[i] -= before->wait_hist[i];
+        now->xfer_hist[i] -= before->xfer_hist[i];
+    }
+}
+
+// Same fields as i2c_log_device() in main.c
+static void print_device(const char *name, const i2c_device_stats_t *st)
+{
+    printf("%-8s %lu transfers, %lu NACK, %lu timeout, %lu PEC, %lu other, %lu queue full; wait p50 <%lu us p99 "
+           "<%lu us, transfer p99 <%lu us, worst recent %lu us\n",
+           name, (unsigned long)st->transfers, (unsigned long)st->nacks, (unsigned long)st->timeouts,
+           (unsigned long)st->pec_errors, (unsigned long)st->other_errors, (unsigned long)st->queue_full,
+           (unsigned long)i2c_common_hist_quantile_us(st->wait_hist, 500),
+           (unsigned long)i2c_common_hist_quantile_us(st->wait_hist, 990),
+           (unsigned long)i2c_common_hist_quantile_us(st->xfer_hist, 990), (unsigned long)st->worst_recent_us);
+}
+
+static bool contended(void)
+{
+    static const uint8_t fifo_reg = 0x05, obj_cmd = 0x07;
+    uint8_t raw[PPG_BURST * PPG_SAMPLE_SIZE], obj_buf[3];
+    i2c_device_stats_t ppg0, mlx0, ppg, mlx;
+    uint32_t failed = 0;
+
+    register_clocks(400000);
+    i2c_common_get_device_stats(MAX30100_ADDR, &ppg0);
+    i2c_common_get_device_stats(MLX90614_ADDR, &mlx0);
+    esp_host_i2c_nack_every(MLX90614_ADDR, NACK_EVERY);
+    for (int r = 1; r <= CONTENDED_ROUNDS; r++)
+    {
+        i2c_txn_t temp = {
+            .addr = MLX90614_ADDR, .write_buf = &obj_cmd, .write_size = 1, .read_buf = obj_buf, .read_size = 3,
+            .prio = I2C_PRIO_LOW,
+        };
+        i2c_txn_t fifo = {
+            .addr = MAX30100_ADDR, .write_buf = &fifo_reg, .write_size = 1, .read_buf = raw,
+            .read_size = sizeof(raw), .prio = I2C_PRIO_HIGH,
+        };
+        esp_host_hold_tasks(true);
+        i2c_bus_submit(&temp);
+        i2c_bus_submit(&fifo);
+        esp_host_skip_time(CONTENDED_US);
+        esp_host_hold_tasks(false);
+        failed += temp.result != ESP_OK;
+        if (r % PEC_EVERY == 0)
+            i2c_common_report_pec_error(MLX90614_ADDR);
+        esp_host_skip_time(100000);
+    }
+    esp_host_i2c_nack_every(0, 0);
+
+    i2c_common_get_device_stats(MAX30100_ADDR, &ppg);
+    i2c_common_get_device_stats(MLX90614_ADDR, &mlx);
+    stats_delta(&ppg, &ppg0);
+    stats_delta(&mlx, &mlx0);
+    printf("contended bus, %d rounds held %d us, MLX90614 NACK every %d, PEC failure every %d:\n",
+           CONTENDED_ROUNDS, CONTENDED_US, NACK_EVERY, PEC_EVERY);
+    print_device("MAX30100", &ppg);
+    print_device("MLX90614", &mlx);
+
+    bool ok = ppg.transfers == CONTENDED_ROUNDS && mlx.transfers == CONTENDED_ROUNDS &&
+              mlx.nacks == CONTENDED_ROUNDS / NACK_EVERY && failed == mlx.nacks &&
+              mlx.pec_errors == CONTENDED_ROUNDS / PEC_EVERY && ppg.nacks + ppg.pec_errors + ppg.timeouts == 0 &&
+              i2c_common_hist_quantile_us(ppg.wait_hist, 500) > CONTENDED_US &&
+              i2c_common_hist_quantile_us(mlx.wait_hist, 500) > i2c_common_hist_quantile_us(ppg.wait_hist, 500);
+    printf("telemetry: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = 20;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--seconds") && i + 1 < argc)
+            seconds = atoi(argv[++i]);
+    }
+    if (i2c_master_init() != ESP_OK)
+        return EXIT_FAILURE;
+
+    bool ok = true;
+    for (size_t k = 0; k < sizeof(s_cases) / sizeof(s_cases[0]); k++)
+    {
+        const sim_case_t *c = &s_cases[k];
+        sim_load_t at[2];
+        for (int fast = 0; fast < 2; fast++)
+        {
+            uint32_t clk = fast ? 400000 : 100000, expected;
+            int errors = 0;
+            register_clocks(clk);
+            at[fast] = run(c, seconds, &expected, &errors);
+            double want = (double)expected / seconds;
+            bool pass = errors == 0 && at[fast].windows > 0 && at[fast].transfers > want * 0.97 &&
+                        at[fast].transfers < want * 1.03;
+            printf("%-34s MAX30100 at %3lu kHz: busy %6.0f us/s (%4.1f %%), %5.1f transfers/s, %4.1f clock "
+                   "switches/s%s\n",
+                   c->name, (unsigned long)(clk / 1000), at[fast].busy_us, at[fast].busy_us / 1e4,
+                   at[fast].transfers, at[fast].clock_switches, pass ? "" : "  FAIL");
+            ok &= pass;
+        }
+        if (c->ppg_rate_hz)
+        {
+            printf("%-34s headroom gained: %.0f us/s\n", "", at[0].busy_us - at[1].busy_us);
+            ok &= at[1].busy_us < at[0].busy_us * 0.5;
+        }
+    }
+
+    ok &= contended();
+
+    uint32_t heap_links = i2c_common_heap_link_count();
+    printf("command links from the heap: %lu\n", (unsigned long)heap_links);
+    ok &= heap_links == 0;
+    printf("i2c_load_sim: %s\n", ok ? "ok" : "FAIL");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -2,23 +2,128 @@
 
 #include "esp_err.h"
 #include "driver/i2c.h"
-#include "freertos/semphr.h"
-
-extern SemaphoreHandle_t s_i2c_mutex;
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 
 // I2C Configuration
 #define I2C_MASTER_NUM      I2C_NUM_0
 #define I2C_MASTER_SDA_IO   21
 #define I2C_MASTER_SCL_IO   22
-#define I2C_MASTER_FREQ_HZ  100000  
-#define I2C_LOCK_TIMEOUT_MS 1000   
+#define I2C_MASTER_FREQ_HZ  100000
+#define I2C_LOCK_TIMEOUT_MS 1000
+
+// Bus-owner task: the only context that touches the I2C peripheral
+#define I2C_BUS_TASK_PRIO   6
+#define I2C_BUS_QUEUE_LEN   16
+#define I2C_BUS_MAX_CHAIN   4 // longest chain served from the static command link
+#define I2C_MAX_DEVICES     8
+#define I2C_LOAD_WINDOW_US  1000000
+#define I2C_HIST_BUCKETS    12 // bucket 0: < 16 us, bucket i: [8 << i, 16 << i) us, last is open-ended
+#define I2C_ADDR_UNREGISTERED 0xFF
+
+typedef enum {
+    I2C_PRIO_HIGH, // latency-critical (PPG FIFO drain), always served first
+    I2C_PRIO_LOW,  // everything else
+    I2C_PRIO_COUNT,
+} i2c_txn_prio_t;
+
+typedef struct i2c_txn i2c_txn_t;
+typedef void (*i2c_txn_cb_t)(i2c_txn_t *txn, void *arg);
+
+// Transaction descriptor. Owned by the caller and must stay valid until
+// completion is signalled. Transactions linked through next are executed
+// back-to-back as a single bus transfer (repeated START between them) and
+// share one result.
+struct i2c_txn {
+    uint8_t addr;
+    const uint8_t *write_buf;
+    size_t write_size;
+    uint8_t *read_buf;
+    size_t read_size;
+    TickType_t timeout;
+    i2c_txn_prio_t prio;
+
+    // Completion: callback runs in the bus task and must not block on the bus;
+    // notify_task receives xTaskNotifyGive(). Either or both may be NULL.
+    i2c_txn_cb_t done_cb;
+    void *cb_arg;
+    TaskHandle_t notify_task;
+
+    i2c_txn_t *next;
+    esp_err_t result;
+    int64_t submit_us; // set by i2c_common, used for queue-wait telemetry
+};
+
+// Per-device bus timing, applied by the bus task before each transfer
+typedef struct {
+    uint8_t addr;
+    uint32_t clk_hz;      // SCL frequency for this device
+    TickType_t timeout;   // used when a transaction leaves timeout at 0
+} i2c_device_profile_t;
+
+// Bus occupancy over the last completed window of about I2C_LOAD_WINDOW_US;
+// busy_us / window_us is the load
+typedef struct {
+    uint32_t busy_us;
+    uint32_t transfers;
+    uint32_t clock_switches;
+    uint32_t window_us; // 0 until the first window has closed
+} i2c_bus_load_t;
+
+// Per-device telemetry. Counters are updated lock-free and can be read at
+// any time; a snapshot may be a few transfers out of step across fields.
+typedef struct {
+    uint8_t addr;                        // I2C_ADDR_UNREGISTERED for the catch-all slot
+    uint32_t transfers;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t pec_errors;                 // reported by the device driver
+    uint32_t other_errors;
+    uint32_t queue_full;
+    uint32_t wait_hist[I2C_HIST_BUCKETS]; // submit -> start of transfer
+    uint32_t xfer_hist[I2C_HIST_BUCKETS]; // time on the wire
+    uint32_t worst_recent_us;            // worst wait + transfer over the last one or two load windows
+} i2c_device_stats_t;
 
 esp_err_t i2c_master_init(void);
 
-esp_err_t i2c_common_write_read_device(i2c_port_t i2c_num, uint8_t device_addr, 
+// Adds or replaces the profile for profile->addr. Unregistered devices run at
+// I2C_MASTER_FREQ_HZ. A chain spanning several devices runs at the slowest
+// clock among them.
+esp_err_t i2c_common_register_device(const i2c_device_profile_t *profile);
+
+void i2c_common_get_bus_load(i2c_bus_load_t *out);
+
+// Telemetry for a registered device, or for all unregistered traffic when
+// addr is I2C_ADDR_UNREGISTERED
+esp_err_t i2c_common_get_device_stats(uint8_t addr, i2c_device_stats_t *out);
+
+// Upper edge in microseconds of the histogram bucket holding the given
+// quantile (per mille) of the counts; 0 for an empty histogram, UINT32_MAX
+// when the quantile falls in the open-ended last bucket
+uint32_t i2c_common_hist_quantile_us(const uint32_t hist[I2C_HIST_BUCKETS], uint32_t permille);
+
+// Lets drivers that check their own CRC (e.g. SMBus PEC) feed the counters
+void i2c_common_report_pec_error(uint8_t addr);
+
+// Queues a transaction (or a chain) for the bus task; does not block
+esp_err_t i2c_bus_submit(i2c_txn_t *txn);
+
+// Submits and waits for completion; returns the transaction result.
+// Uses the tail's done_cb/cb_arg internally. Must not be called from a
+// completion callback.
+esp_err_t i2c_bus_transfer(i2c_txn_t *txn);
+
+esp_err_t i2c_common_write_read_device(i2c_port_t i2c_num, uint8_t device_addr,
                                       const uint8_t* write_buffer, size_t write_size,
                                       uint8_t* read_buffer, size_t read_size, TickType_t ticks_to_wait);
 
-esp_err_t i2c_common_write_to_device(i2c_port_t i2c_num, uint8_t device_addr, 
-                                     const uint8_t* write_buffer, size_t write_size, TickType_t ticks_to_wait);
\ No newline at end of file
+esp_err_t i2c_common_write_to_device(i2c_port_t i2c_num, uint8_t device_addr,
+                                     const uint8_t* write_buffer, size_t write_size, TickType_t ticks_to_wait);
+
+// Command links that had to be heap-allocated since boot. Stays at zero in
+// steady state as long as no client submits a chain longer than
+// I2C_BUS_MAX_CHAIN; the sensor manager task logs a warning whenever it
+// moves.
+uint32_t i2c_common_heap_link_count(void);
@@ -1,161 +1,528 @@
 #include "i2c_common.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include <stdatomic.h>
 
 static const char *TAG = "i2c_common";
-SemaphoreHandle_t s_i2c_mutex = NULL;
 static bool s_i2c_initialized = false;
+static TaskHandle_t s_bus_task = NULL;
+static QueueHandle_t s_queues[I2C_PRIO_COUNT];
 
-esp_err_t i2c_master_init(void)
+// Only the bus task builds command links, so one static buffer serves every
+// transfer. Each chained transaction may need a write and a read phase.
+static uint8_t s_cmd_buf[I2C_LINK_RECOMMENDED_SIZE(2 * I2C_BUS_MAX_CHAIN)];
+static volatile uint32_t s_heap_links = 0;
+
+static i2c_device_profile_t s_profiles[I2C_MAX_DEVICES];
+static int s_profile_count = 0;
+static portMUX_TYPE s_profile_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_clk_hz = I2C_MASTER_FREQ_HZ;
+
+// Bus load accounting, owned by the bus task
+static int64_t s_load_window_start = 0;
+static i2c_bus_load_t s_load_acc;
+static i2c_bus_load_t s_load_last;
+
+typedef struct {
+    atomic_uint transfers;
+    atomic_uint nacks;
+    atomic_uint timeouts;
+    atomic_uint pec_errors;
+    atomic_uint other_errors;
+    atomic_uint queue_full;
+    atomic_uint wait_hist[I2C_HIST_BUCKETS];
+    atomic_uint xfer_hist[I2C_HIST_BUCKETS];
+    atomic_uint worst_cur_us;
+    atomic_uint worst_last_us;
+} i2c_dev_counters_t;
+
+// One slot per profile index plus a catch-all for unregistered addresses
+static i2c_dev_counters_t s_counters[I2C_MAX_DEVICES + 1];
+
+#define COUNT(field) atomic_fetch_add_explicit(&(field), 1, memory_order_relaxed)
+
+static i2c_config_t s_conf = {
+    .mode = I2C_MODE_MASTER,
+    .sda_io_num = I2C_MASTER_SDA_IO,
+    .scl_io_num = I2C_MASTER_SCL_IO,
+    .sda_pullup_en = GPIO_PULLUP_ENABLE,
+    .scl_pullup_en = GPIO_PULLUP_ENABLE,
+    .master.clk_speed = I2C_MASTER_FREQ_HZ,
+    .clk_flags = 0};
+
+// Returns the profile slot for addr, or I2C_MAX_DEVICES if unregistered
+static int i2c_find_profile(uint8_t addr, i2c_device_profile_t *out)
 {
-    if (s_i2c_initialized)
+    int slot = I2C_MAX_DEVICES;
+    portENTER_CRITICAL(&s_profile_lock);
+    for (int i = 0; i < s_profile_count; i++)
     {
-        ESP_LOGI(TAG, "I2C already initialized, skipping");
-        return ESP_OK;
+        if (s_profiles[i].addr == addr)
+        {
+            if (out)
+                *out = s_profiles[i];
+            slot = i;
+            break;
+        }
     }
+    portEXIT_CRITICAL(&s_profile_lock);
+    return slot;
+}
+
+static int i2c_hist_bucket(uint32_t us)
+{
+    int bits = 32 - __builtin_clz(us | 1);
+    int b = bits > 4 ? bits - 4 : 0;
+    return b < I2C_HIST_BUCKETS ? b : I2C_HIST_BUCKETS - 1;
+}
 
-    s_i2c_mutex = xSemaphoreCreateBinary();
-    if (!s_i2c_mutex)
+static void i2c_record(uint8_t addr, esp_err_t ret, uint32_t wait_us, uint32_t xfer_us)
+{
+    i2c_dev_counters_t *c = &s_counters[i2c_find_profile(addr, NULL)];
+
+    COUNT(c->transfers);
+    COUNT(c->wait_hist[i2c_hist_bucket(wait_us)]);
+    COUNT(c->xfer_hist[i2c_hist_bucket(xfer_us)]);
+
+    switch (ret)
     {
-        ESP_LOGE(TAG, "Failed to create I2C semaphore");
-        return ESP_ERR_NO_MEM;
+    case ESP_OK:
+        break;
+    case ESP_FAIL: // legacy driver reports a missing ACK as ESP_FAIL
+        COUNT(c->nacks);
+        break;
+    case ESP_ERR_TIMEOUT:
+        COUNT(c->timeouts);
+        break;
+    default:
+        COUNT(c->other_errors);
+        break;
     }
-    xSemaphoreGive(s_i2c_mutex);
 
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA_IO,
-        .scl_io_num = I2C_MASTER_SCL_IO,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = 100000,
-        .clk_flags = 0};
+    // Only the bus task writes worst_cur_us, so load/store is enough
+    uint32_t total = wait_us + xfer_us;
+    if (total > atomic_load_explicit(&c->worst_cur_us, memory_order_relaxed))
+        atomic_store_explicit(&c->worst_cur_us, total, memory_order_relaxed);
+}
+
+// Reprograms SCL timing only when the chain needs a different clock
+static void i2c_apply_clock(uint32_t clk_hz)
+{
+    if (clk_hz == s_clk_hz)
+        return;
 
-    esp_err_t err = i2c_param_config(I2C_MASTER_NUM, &conf);
+    s_conf.master.clk_speed = clk_hz;
+    esp_err_t err = i2c_param_config(I2C_MASTER_NUM, &s_conf);
     if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "i2c_param_config failed: %s", esp_err_to_name(err));
-        goto cleanup;
+        ESP_LOGW(TAG, "Failed to switch I2C clock to %lu Hz: %s", (unsigned long)clk_hz, esp_err_to_name(err));
+        return;
     }
+    s_clk_hz = clk_hz;
+    s_load_acc.clock_switches++;
+}
 
-    err = i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
-    if (err != ESP_OK)
+static void i2c_account_transfer(int64_t start, int64_t end)
+{
+    if (end - s_load_window_start >= I2C_LOAD_WINDOW_US)
     {
-        ESP_LOGE(TAG, "i2c_driver_install failed: %s", esp_err_to_name(err));
-        goto cleanup;
+        // A window closes at the first transfer after it is due, so it
+        // runs somewhat over I2C_LOAD_WINDOW_US
+        s_load_acc.window_us = (uint32_t)(end - s_load_window_start);
+        s_load_last = s_load_acc;
+        s_load_acc = (i2c_bus_load_t){0};
+        s_load_window_start = end;
+        for (int i = 0; i <= I2C_MAX_DEVICES; i++)
+        {
+            unsigned worst = atomic_exchange_explicit(&s_counters[i].worst_cur_us, 0, memory_order_relaxed);
+            atomic_store_explicit(&s_counters[i].worst_last_us, worst, memory_order_relaxed);
+        }
+        ESP_LOGD(TAG, "Bus busy %lu us/s over %lu transfers",
+                 (unsigned long)s_load_last.busy_us, (unsigned long)s_load_last.transfers);
     }
+    s_load_acc.busy_us += (uint32_t)(end - start);
+    s_load_acc.transfers++;
+}
 
-    s_i2c_initialized = true;
-    ESP_LOGI(TAG, "I2C initialized successfully");
-    return ESP_OK;
+// Appends one transaction to a command link; the caller adds the final STOP
+static void i2c_link_append(i2c_cmd_handle_t cmd, const i2c_txn_t *t)
+{
+    if (t->write_size > 0 || t->read_size == 0)
+    {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (t->addr << 1) | I2C_MASTER_WRITE, true);
+        if (t->write_size > 0)
+        {
+            i2c_master_write(cmd, t->write_buf, t->write_size, true);
+        }
+    }
 
-cleanup:
-    if (s_i2c_mutex)
+    if (t->read_size > 0)
     {
-        vSemaphoreDelete(s_i2c_mutex);
-        s_i2c_mutex = NULL;
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (t->addr << 1) | I2C_MASTER_READ, true);
+        if (t->read_size > 1)
+        {
+            i2c_master_read(cmd, t->read_buf, t->read_size - 1, I2C_MASTER_ACK);
+        }
+        i2c_master_read_byte(cmd, t->read_buf + t->read_size - 1, I2C_MASTER_NACK);
     }
-    return err;
 }
 
-esp_err_t i2c_common_write_to_device(i2c_port_t i2c_num, uint8_t device_addr,
-                                     const uint8_t *write_buffer, size_t write_size,
-                                     TickType_t ticks_to_wait)
+// Runs a whole chain as one bus transfer, then signals every member
+static void i2c_bus_execute(i2c_txn_t *head)
 {
-    if (!s_i2c_mutex || !s_i2c_initialized)
+    esp_err_t ret;
+    TickType_t timeout = 0;
+    int64_t start = esp_timer_get_time();
+    int64_t end = start;
+    int chain_len = 0;
+    uint32_t clk_hz = 0;
+    for (i2c_txn_t *t = head; t != NULL; t = t->next)
     {
-        ESP_LOGE(TAG, "I2C not initialized");
-        return ESP_ERR_INVALID_STATE;
+        i2c_device_profile_t prof = {.clk_hz = I2C_MASTER_FREQ_HZ, .timeout = pdMS_TO_TICKS(I2C_LOCK_TIMEOUT_MS)};
+        i2c_find_profile(t->addr, &prof);
+        if (clk_hz == 0 || prof.clk_hz < clk_hz)
+            clk_hz = prof.clk_hz;
+        timeout += t->timeout ? t->timeout : prof.timeout;
+        chain_len++;
     }
+    i2c_apply_clock(clk_hz);
 
-    if (xSemaphoreTake(s_i2c_mutex, pdMS_TO_TICKS(2000)) != pdTRUE)
+    // Over-long chains fall back to the heap and are counted
+    bool on_heap = chain_len > I2C_BUS_MAX_CHAIN;
+    i2c_cmd_handle_t cmd;
+    if (on_heap)
     {
-        ESP_LOGE(TAG, "Failed to take I2C semaphore");
-        return ESP_ERR_TIMEOUT;
+        cmd = i2c_cmd_link_create();
+        s_heap_links++;
+    }
+    else
+    {
+        cmd = i2c_cmd_link_create_static(s_cmd_buf, sizeof(s_cmd_buf));
     }
 
-    esp_err_t ret = ESP_OK;
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
     if (cmd == NULL)
     {
-        xSemaphoreGive(s_i2c_mutex);
-        return ESP_ERR_NO_MEM;
+        ret = ESP_ERR_NO_MEM;
     }
+    else
+    {
+        for (i2c_txn_t *t = head; t != NULL; t = t->next)
+        {
+            i2c_link_append(cmd, t);
+        }
+        i2c_master_stop(cmd);
 
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (device_addr << 1) | I2C_MASTER_WRITE, true);
-    if (write_size > 0)
+        start = esp_timer_get_time();
+        ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, timeout);
+        end = esp_timer_get_time();
+        i2c_account_transfer(start, end);
+        if (on_heap)
+        {
+            i2c_cmd_link_delete(cmd);
+        }
+        else
+        {
+            i2c_cmd_link_delete_static(cmd);
+        }
+    }
+
+    if (ret != ESP_OK)
     {
-        i2c_master_write(cmd, write_buffer, write_size, true);
+        ESP_LOGD(TAG, "I2C transfer failed: %s (addr=0x%02X)", esp_err_to_name(ret), head->addr);
     }
-    i2c_master_stop(cmd);
 
-    ret = i2c_master_cmd_begin(i2c_num, cmd, ticks_to_wait);
-    i2c_cmd_link_delete(cmd);
+    uint32_t wait_us = start > head->submit_us ? (uint32_t)(start - head->submit_us) : 0;
+    for (i2c_txn_t *t = head; t != NULL; t = t->next)
+    {
+        i2c_record(t->addr, ret, wait_us, (uint32_t)(end - start));
+    }
 
-    xSemaphoreGive(s_i2c_mutex);
+    i2c_txn_t *t = head;
+    while (t != NULL)
+    {
+        // Copy everything first: once signalled, the owner may reuse or free
+        // the descriptor
+        i2c_txn_t *next = t->next;
+        i2c_txn_cb_t cb = t->done_cb;
+        void *arg = t->cb_arg;
+        TaskHandle_t notify = t->notify_task;
 
-    if (ret != ESP_OK)
+        t->result = ret;
+        if (notify)
+        {
+            xTaskNotifyGive(notify);
+        }
+        if (cb)
+        {
+            cb(t, arg);
+        }
+        t = next;
+    }
+}
+
+static void i2c_bus_task(void *pv)
+{
+    (void)pv;
+    i2c_txn_t *txn;
+
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Drain everything pending before sleeping again; high priority is
+        // re-checked between transfers so a PPG drain never waits behind a
+        // queue of slow reads.
+        for (;;)
+        {
+            if (xQueueReceive(s_queues[I2C_PRIO_HIGH], &txn, 0) != pdTRUE &&
+                xQueueReceive(s_queues[I2C_PRIO_LOW], &txn, 0) != pdTRUE)
+            {
+                break;
+            }
+            i2c_bus_execute(txn);
+        }
+    }
+}
+
+esp_err_t i2c_master_init(void)
+{
+    if (s_i2c_initialized)
+    {
+        ESP_LOGI(TAG, "I2C already initialized, skipping");
+        return ESP_OK;
+    }
+
+    esp_err_t err = i2c_param_config(I2C_MASTER_NUM, &s_conf);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "i2c_param_config failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = i2c_driver_install(I2C_MASTER_NUM, s_conf.mode, 0, 0, 0);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "i2c_driver_install failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    for (int p = 0; p < I2C_PRIO_COUNT; p++)
+    {
+        s_queues[p] = xQueueCreate(I2C_BUS_QUEUE_LEN, sizeof(i2c_txn_t *));
+        if (s_queues[p] == NULL)
+        {
+            ESP_LOGE(TAG, "Failed to create I2C queue");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    if (xTaskCreate(i2c_bus_task, "i2c_bus", 3072, NULL, I2C_BUS_TASK_PRIO, &s_bus_task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create I2C bus task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_i2c_initialized = true;
+    ESP_LOGI(TAG, "I2C initialized successfully");
+    return ESP_OK;
+}
+
+esp_err_t i2c_common_register_device(const i2c_device_profile_t *profile)
+{
+    if (profile == NULL || profile->clk_hz == 0)
     {
-        ESP_LOGD(TAG, "I2C write failed: %s (addr=0x%02X)",
-                 esp_err_to_name(ret), device_addr);
+        return ESP_ERR_INVALID_ARG;
     }
 
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_profile_lock);
+    int i = 0;
+    while (i < s_profile_count && s_profiles[i].addr != profile->addr)
+    {
+        i++;
+    }
+    if (i < I2C_MAX_DEVICES)
+    {
+        s_profiles[i] = *profile;
+        if (i == s_profile_count)
+            s_profile_count++;
+    }
+    else
+    {
+        ret = ESP_ERR_NO_MEM;
+    }
+    portEXIT_CRITICAL(&s_profile_lock);
     return ret;
 }
 
-esp_err_t i2c_common_write_read_device(i2c_port_t i2c_num, uint8_t device_addr,
-                                       const uint8_t *write_buffer, size_t write_size,
-                                       uint8_t *read_buffer, size_t read_size,
-                                       TickType_t ticks_to_wait)
+void i2c_common_get_bus_load(i2c_bus_load_t *out)
+{
+    *out = s_load_last;
+}
+
+#define LOAD(field) atomic_load_explicit(&(field), memory_order_relaxed)
+
+esp_err_t i2c_common_get_device_stats(uint8_t addr, i2c_device_stats_t *out)
+{
+    int slot = I2C_MAX_DEVICES;
+    if (addr != I2C_ADDR_UNREGISTERED)
+    {
+        slot = i2c_find_profile(addr, NULL);
+        if (slot == I2C_MAX_DEVICES)
+            return ESP_ERR_NOT_FOUND;
+    }
+
+    const i2c_dev_counters_t *c = &s_counters[slot];
+    out->addr = addr;
+    out->transfers = LOAD(c->transfers);
+    out->nacks = LOAD(c->nacks);
+    out->timeouts = LOAD(c->timeouts);
+    out->pec_errors = LOAD(c->pec_errors);
+    out->other_errors = LOAD(c->other_errors);
+    out->queue_full = LOAD(c->queue_full);
+    for (int i = 0; i < I2C_HIST_BUCKETS; i++)
+    {
+        out->wait_hist[i] = LOAD(c->wait_hist[i]);
+        out->xfer_hist[i] = LOAD(c->xfer_hist[i]);
+    }
+    uint32_t cur = LOAD(c->worst_cur_us);
+    uint32_t last = LOAD(c->worst_last_us);
+    out->worst_recent_us = cur > last ? cur : last;
+    return ESP_OK;
+}
+
+uint32_t i2c_common_hist_quantile_us(const uint32_t hist[I2C_HIST_BUCKETS], uint32_t permille)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < I2C_HIST_BUCKETS; i++)
+        total += hist[i];
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (total * permille + 999) / 1000, seen = 0;
+    for (int i = 0; i < I2C_HIST_BUCKETS - 1; i++)
+    {
+        seen += hist[i];
+        if (seen >= rank)
+            return 16u << i;
+    }
+    return UINT32_MAX;
+}
+
+void i2c_common_report_pec_error(uint8_t addr)
+{
+    COUNT(s_counters[i2c_find_profile(addr, NULL)].pec_errors);
+}
+
+static esp_err_t i2c_bus_enqueue(i2c_txn_t *txn, TickType_t wait)
 {
-    if (!s_i2c_mutex || !s_i2c_initialized)
+    if (!s_i2c_initialized)
     {
         ESP_LOGE(TAG, "I2C not initialized");
         return ESP_ERR_INVALID_STATE;
     }
+    if (txn == NULL || txn->prio >= I2C_PRIO_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    if (xSemaphoreTake(s_i2c_mutex, pdMS_TO_TICKS(2000)) != pdTRUE)
+    txn->submit_us = esp_timer_get_time();
+    if (xQueueSend(s_queues[txn->prio], &txn, wait) != pdTRUE)
     {
-        ESP_LOGE(TAG, "Failed to take I2C semaphore");
+        COUNT(s_counters[i2c_find_profile(txn->addr, NULL)].queue_full);
+        ESP_LOGW(TAG, "I2C queue full (prio %d)", txn->prio);
         return ESP_ERR_TIMEOUT;
     }
+    xTaskNotifyGive(s_bus_task);
+    return ESP_OK;
+}
 
-    esp_err_t ret = ESP_OK;
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    if (cmd == NULL)
+esp_err_t i2c_bus_submit(i2c_txn_t *txn)
+{
+    return i2c_bus_enqueue(txn, 0);
+}
+
+static void i2c_bus_sync_done(i2c_txn_t *txn, void *arg)
+{
+    (void)txn;
+    xSemaphoreGive((SemaphoreHandle_t)arg);
+}
+
+esp_err_t i2c_bus_transfer(i2c_txn_t *txn)
+{
+    // Stack-allocated semaphore: no heap traffic and no clash with the
+    // caller's own task notifications
+    StaticSemaphore_t sem_buf;
+    SemaphoreHandle_t done = xSemaphoreCreateBinaryStatic(&sem_buf);
+
+    // Only the tail of a chain signals; the whole chain completes together
+    i2c_txn_t *tail = txn;
+    while (tail->next != NULL)
     {
-        xSemaphoreGive(s_i2c_mutex);
-        return ESP_ERR_NO_MEM;
+        tail = tail->next;
     }
+    tail->done_cb = i2c_bus_sync_done;
+    tail->cb_arg = done;
 
-    // Write phase
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (device_addr << 1) | I2C_MASTER_WRITE, true);
-    if (write_size > 0)
+    esp_err_t ret = i2c_bus_enqueue(txn, pdMS_TO_TICKS(I2C_LOCK_TIMEOUT_MS));
+    if (ret == ESP_OK)
     {
-        i2c_master_write(cmd, write_buffer, write_size, true);
+        // The descriptor lives on the caller's stack, so wait for completion
+        xSemaphoreTake(done, portMAX_DELAY);
+        ret = txn->result;
     }
+    vSemaphoreDelete(done);
+    return ret;
+}
 
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (device_addr << 1) | I2C_MASTER_READ, true);
-
-    if (read_size > 0)
+esp_err_t i2c_common_write_to_device(i2c_port_t i2c_num, uint8_t device_addr,
+                                     const uint8_t *write_buffer, size_t write_size,
+                                     TickType_t ticks_to_wait)
+{
+    if (i2c_num != I2C_MASTER_NUM)
     {
-        if (read_size > 1)
-        {
-            i2c_master_read(cmd, read_buffer, read_size - 1, I2C_MASTER_ACK);
-        }
-        i2c_master_read_byte(cmd, read_buffer + read_size - 1, I2C_MASTER_NACK);
+        return ESP_ERR_INVALID_ARG;
     }
-    i2c_master_stop(cmd);
 
-    ret = i2c_master_cmd_begin(i2c_num, cmd, ticks_to_wait);
-    i2c_cmd_link_delete(cmd);
+    i2c_txn_t txn = {
+        .addr = device_addr,
+        .write_buf = write_buffer,
+        .write_size = write_size,
+        .timeout = ticks_to_wait,
+        .prio = I2C_PRIO_LOW,
+    };
+    return i2c_bus_transfer(&txn);
+}
 
-    xSemaphoreGive(s_i2c_mutex);
+esp_err_t i2c_common_write_read_device(i2c_port_t i2c_num, uint8_t device_addr,
+                                       const uint8_t *write_buffer, size_t write_size,
+                                       uint8_t *read_buffer, size_t read_size,
+                                       TickType_t ticks_to_wait)
+{
+    if (i2c_num != I2C_MASTER_NUM)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    return ret;
+    i2c_txn_t txn = {
+        .addr = device_addr,
+        .write_buf = write_buffer,
+        .write_size = write_size,
+        .read_buf = read_buffer,
+        .read_size = read_size,
+        .timeout = ticks_to_wait,
+        .prio = I2C_PRIO_LOW,
+    };
+    return i2c_bus_transfer(&txn);
+}
+
+uint32_t i2c_common_heap_link_count(void)
+{
+    return s_heap_links;
 }
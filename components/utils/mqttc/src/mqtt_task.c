@@ -3,6 +3,7 @@
 #include "freertos/queue.h"
 #include "esp_log.h"
 #include "cJSON.h"
+#include "mbedtls/base64.h"
 #include <math.h>
 #include <string.h>
 
@@ -26,10 +27,21 @@ static const char *TAG = "MQTT_TASK";
 #define MQTT_TOPIC_BASE "health_monitor/device01"
 #endif
 
-static void build_and_publish_temperature(float t)
+// Vitals store sequence and device uptime of the sample, for ordering and
+// de-duplication on the server
+static void add_stamp(cJSON *root, const http_message_t *msg)
+{
+    if (msg->timestamp_ms == 0)
+        return;
+    cJSON_AddNumberToObject(root, "seq", msg->seq);
+    cJSON_AddNumberToObject(root, "uptime_ms", msg->timestamp_ms);
+}
+
+static void build_and_publish_temperature(const http_message_t *msg, float t)
 {
     cJSON *root = cJSON_CreateObject();
     cJSON_AddNumberToObject(root, "temperature", roundf(t * 100) / 100);
+    add_stamp(root, msg);
     char *json = cJSON_PrintUnformatted(root);
 
     char topic[96];
@@ -40,11 +52,14 @@ static void build_and_publish_temperature(float t)
     free(json);
 }
 
-static void build_and_publish_health(int hr, int spo2)
+static void build_and_publish_health(const http_message_t *msg, int hr, int spo2, int resp_rate)
 {
     cJSON *root = cJSON_CreateObject();
     cJSON_AddNumberToObject(root, "heart_rate", hr);
     cJSON_AddNumberToObject(root, "spo2", spo2);
+    if (resp_rate > 0)
+        cJSON_AddNumberToObject(root, "resp_rate", resp_rate);
+    add_stamp(root, msg);
     char *json = cJSON_PrintUnformatted(root);
 
     char topic[96];
@@ -55,19 +70,80 @@ static void build_and_publish_health(int hr, int spo2)
     free(json);
 }
 
-static void build_and_publish_gps(float lat, float lon)
+static void build_and_publish_hrv(float rmssd, float sdnn, int pnn50)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "rmssd", roundf(rmssd * 10) / 10);
+    cJSON_AddNumberToObject(root, "sdnn", roundf(sdnn * 10) / 10);
+    cJSON_AddNumberToObject(root, "pnn50", pnn50);
+    char *json = cJSON_PrintUnformatted(root);
+
+    char topic[96];
+    snprintf(topic, sizeof(topic), "%s/hrv", MQTT_TOPIC_BASE);
+    mqttc_publish(topic, json, 1, false);
+
+    cJSON_Delete(root);
+    free(json);
+}
+
+static void build_and_publish_rhythm(int irregular, int score)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "irregular", irregular);
+    cJSON_AddNumberToObject(root, "score", score);
+    char *json = cJSON_PrintUnformatted(root);
+
+    char topic[96];
+    snprintf(topic, sizeof(topic), "%s/rhythm", MQTT_TOPIC_BASE);
+    mqttc_publish(topic, json, 1, false);
+
+    cJSON_Delete(root);
+    free(json);
+}
+
+static void build_and_publish_geofence(int zone, int inside)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "zone", zone);
+    cJSON_AddBoolToObject(root, "inside", inside);
+    char *json = cJSON_PrintUnformatted(root);
+
+    char topic[96];
+    snprintf(topic, sizeof(topic), "%s/geofence", MQTT_TOPIC_BASE);
+    mqttc_publish(topic, json, 1, false);
+
+    cJSON_Delete(root);
+    free(json);
+}
+
+static void build_and_publish_gps(float lat, float lon, const uint8_t *track, size_t track_len, int points)
 {
     cJSON *root = cJSON_CreateObject();
     cJSON_AddNumberToObject(root, "latitude", lat);
     cJSON_AddNumberToObject(root, "longitude", lon);
+
+    // Simplified track batch, zigzag-varint deltas (see track_recorder.h)
+    char *b64 = NULL;
+    if (track && track_len > 0)
+    {
+        size_t b64_len = 0;
+        mbedtls_base64_encode(NULL, 0, &b64_len, track, track_len);
+        b64 = malloc(b64_len);
+        if (b64 && mbedtls_base64_encode((unsigned char *)b64, b64_len, &b64_len, track, track_len) == 0)
+        {
+            cJSON_AddNumberToObject(root, "points", points);
+            cJSON_AddStringToObject(root, "track", b64);
+        }
+    }
     char *json = cJSON_PrintUnformatted(root);
 
     char topic[96];
     snprintf(topic, sizeof(topic), "%s/gps", MQTT_TOPIC_BASE);
-    mqttc_publish(topic, json, 0, false);
+    mqttc_publish(topic, json, track ? 1 : 0, false);
 
     cJSON_Delete(root);
     free(json);
+    free(b64);
 }
 
 void mqtt_client_task(void *pv)
@@ -110,15 +186,34 @@ void mqtt_client_task(void *pv)
             {
             case 0:
                 ESP_LOGI(TAG, "Publish temperature: %.2f", msg.data.temperature);
-                build_and_publish_temperature(msg.data.temperature);
+                build_and_publish_temperature(&msg, msg.data.temperature);
                 break;
             case 1:
-                ESP_LOGI(TAG, "Publish health: HR=%d SpO2=%d", msg.data.health.heart_rate, msg.data.health.spo2);
-                build_and_publish_health(msg.data.health.heart_rate, msg.data.health.spo2);
+                ESP_LOGI(TAG, "Publish health: HR=%d SpO2=%d RR=%d", msg.data.health.heart_rate, msg.data.health.spo2,
+                         msg.data.health.resp_rate);
+                build_and_publish_health(&msg, msg.data.health.heart_rate, msg.data.health.spo2, msg.data.health.resp_rate);
                 break;
             case 2:
-                ESP_LOGI(TAG, "Publish GPS: %.6f, %.6f", msg.data.gps.lat, msg.data.gps.lon);
-                build_and_publish_gps(msg.data.gps.lat, msg.data.gps.lon);
+                ESP_LOGI(TAG, "Publish GPS: %.6f, %.6f, %d track points in %d bytes", msg.data.gps.lat, msg.data.gps.lon,
+                         msg.data.gps.points, msg.data.gps.track_len);
+                build_and_publish_gps(msg.data.gps.lat, msg.data.gps.lon, msg.data.gps.track, msg.data.gps.track_len,
+                                      msg.data.gps.points);
+                free(msg.data.gps.track);
+                break;
+            case 3:
+                ESP_LOGI(TAG, "Publish HRV: RMSSD=%.1f SDNN=%.1f pNN50=%d",
+                         msg.data.hrv.rmssd, msg.data.hrv.sdnn, msg.data.hrv.pnn50);
+                build_and_publish_hrv(msg.data.hrv.rmssd, msg.data.hrv.sdnn, msg.data.hrv.pnn50);
+                break;
+            case 4:
+                ESP_LOGI(TAG, "Publish rhythm: irregular=%d score=%d",
+                         msg.data.rhythm.irregular, msg.data.rhythm.score);
+                build_and_publish_rhythm(msg.data.rhythm.irregular, msg.data.rhythm.score);
+                break;
+            case 5:
+                ESP_LOGI(TAG, "Publish geofence: zone %d %s", msg.data.geofence.zone,
+                         msg.data.geofence.inside ? "entered" : "left");
+                build_and_publish_geofence(msg.data.geofence.zone, msg.data.geofence.inside);
                 break;
             default:
                 ESP_LOGW(TAG, "Unknown message type: %d", msg.data_type);
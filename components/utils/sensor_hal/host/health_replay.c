@@ -0,0 +1,173 @@
+// Host run of health_tracker on a recorded PPG trace, through the replay
+// backend of sensor_hal, so the firmware's sample path is what gets timed.
+//
+//     health_replay [--realtime] [--expect DIGEST] [--ir STEP] [--red STEP] trace.csv
+//     health_replay --synth SECONDS > trace.csv
+//
+// The trace is "timestamp_us,ir,red" as for sensor_replay_set_ppg_csv().
+// By default it is assumed to be recorded with the continuous profile
+// (100 Hz, 1600 us, IR 11 mA, red 7.6 mA); --ir/--red give other LED
+// current register steps. ASAP mode calls health_update() back to back,
+// --realtime calls it every HEALTH_JOB_PERIOD_US like the sensor scheduler.
+// --expect fails the run when the output digest differs.
+#include "health_tracker.h"
+#include "sensor_hal.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HEALTH_JOB_PERIOD_US 100000
+
+static char *load_text(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc((size_t)len + 1);
+    if (text && fread(text, 1, (size_t)len, f) != (size_t)len)
+    {
+        free(text);
+        text = NULL;
+    }
+    if (text)
+        text[len] = '\0';
+    fclose(f);
+    return text;
+}
+
+static uint32_t s_rng = 3;
+
+// Uniform in [-1, 1)
+static double noise(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (double)(s_rng >> 8) / (double)(1u << 23) - 1.0;
+}
+
+// Systolic peak and dicrotic wave over one beat, phase 0..1
+static double pulse_shape(double phase)
+{
+    double s = (phase - 0.15) / 0.07;
+    double d = (phase - 0.45) / 0.10;
+    return exp(-s * s) + 0.35 * exp(-d * d);
+}
+
+// 100 Hz wrist trace at 72 bpm, SpO2 around 96 %, breathing at 15/min
+// modulating baseline, pulse amplitude and beat interval
+static void synth(int seconds)
+{
+    const double fs = 100.0;
+    double beat_start = 0.0, rr = 60.0 / 72.0;
+
+    printf("# synthetic, health_replay --synth %d\ntimestamp_us,ir,red\n", seconds);
+    for (long i = 0; i < (long)(seconds * fs); i++)
+    {
+        double t = i / fs;
+        double breath = sin(2.0 * M_PI * 0.25 * t);
+        while (t >= beat_start + rr)
+        {
+            beat_start += rr;
+            rr = 60.0 / 72.0 * (1.0 + 0.04 * sin(2.0 * M_PI * 0.25 * beat_start) + 0.01 * noise());
+        }
+        double p = pulse_shape((t - beat_start) / rr) * (1.0 + 0.1 * breath);
+        double ir = 30000.0 * (1.0 + 0.003 * breath) * (1.0 - 0.012 * p) + 5.0 * noise();
+        double red = 26000.0 * (1.0 + 0.003 * breath) * (1.0 - 0.0068 * p) + 5.0 * noise();
+        printf("%ld,%ld,%ld\n", 1000000L + i * 10000L, lround(ir), lround(red));
+    }
+}
+
+static void sleep_us(long us)
+{
+    struct timespec ts = {us / 1000000, (us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    bool realtime = false, check = false;
+    uint32_t expect = 0;
+    sensor_replay_ppg_meta_t meta = {
+        .rate = MAX30100_SAMPLING_RATE_100HZ,
+        .pulse_width = MAX30100_PULSE_WIDTH_1600US_ADC_16,
+        .ir_current = MAX30100_LED_CURRENT_11MA,
+        .red_current = MAX30100_LED_CURRENT_7_6MA,
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--synth") && i + 1 < argc)
+        {
+            synth(atoi(argv[i + 1]));
+            return EXIT_SUCCESS;
+        }
+        if (!strcmp(argv[i], "--realtime"))
+            realtime = true;
+        else if (!strcmp(argv[i], "--expect") && i + 1 < argc)
+        {
+            expect = (uint32_t)strtoul(argv[++i], NULL, 16);
+            check = true;
+        }
+        else if (!strcmp(argv[i], "--ir") && i + 1 < argc)
+            meta.ir_current = (max30100_current_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--red") && i + 1 < argc)
+            meta.red_current = (max30100_current_t)atoi(argv[++i]);
+        else
+            path = argv[i];
+    }
+    if (!path)
+    {
+        fprintf(stderr, "usage: %s [--realtime] [--expect DIGEST] [--ir STEP] [--red STEP] trace.csv\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *text = load_text(path);
+    if (!text || sensor_replay_set_ppg_csv(text, &meta) != ESP_OK)
+        return EXIT_FAILURE;
+    sensor_hal_use_replay(realtime ? SENSOR_REPLAY_REALTIME : SENSOR_REPLAY_ASAP);
+    health_init();
+
+    sensor_replay_stats_t st;
+    do
+    {
+        health_update();
+        sensor_replay_get_stats(&st);
+        if (realtime && !st.done)
+            sleep_us(HEALTH_JOB_PERIOD_US);
+    } while (!st.done);
+
+    health_data_t d;
+    health_dsp_stats_t dsp;
+    rhythm_result_t rh;
+    health_get_data(&d);
+    health_get_dsp_stats(&dsp);
+    health_get_rhythm(&rh);
+
+    printf("%s: %lu samples, %lu outputs, digest %08lx\n", path, (unsigned long)st.ppg_samples,
+           (unsigned long)st.outputs, (unsigned long)st.output_digest);
+    printf("throughput %lu samples/s, processing %lu ns/sample avg, %lu max per chunk\n",
+           (unsigned long)st.samples_per_s, (unsigned long)dsp.cycles_per_sample_avg,
+           (unsigned long)dsp.cycles_per_sample_max);
+    if (realtime)
+        printf("latency due -> delivered %lu us avg, %lu us max\n", (unsigned long)st.latency_avg_us,
+               (unsigned long)st.latency_max_us);
+    printf("last reading: hr %d, spo2 %d (confidence %d), sqi %d, resp %d, rhythm score %d%s, clipped %lu\n",
+           d.heart_rate, d.spo2, d.spo2_confidence, d.sqi, d.resp_rate, rh.score, rh.flagged ? " (flagged)" : "",
+           (unsigned long)st.clipped);
+
+    free(text);
+    if (check && st.output_digest != expect)
+    {
+        printf("digest mismatch, expected %08lx\n", (unsigned long)expect);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,243 @@
+// Host run of temperature_tracker on a recorded MLX90614 trace, through the
+// replay backend of sensor_hal, with the scans the UI would start.
+//
+//     temp_replay [--realtime] [--expect DIGEST] [--scan SECONDS]... [--max-scan-ms MS] trace.csv
+//     temp_replay --synth > trace.csv
+//
+// The trace is "timestamp_us,object_c,ambient_c" as for
+// sensor_replay_set_temp_csv(), one reading per TEMP_JOB_PERIOD_US.
+// temperature_tick() is called every TEMP_JOB_PERIOD_US like the sensor
+// scheduler does; ASAP mode skips the esp_timer clock ahead instead of
+// waiting, so the tracker's own period gating still applies. Each --scan
+// starts a scan that many seconds into the trace and reports when and
+// where it converged. --max-scan-ms fails the run when a scan has not
+// converged by then; --expect when the output digest differs.
+#include "temperature_task.h"
+#include "sensor_hal.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEMP_JOB_PERIOD_US 100000
+#define MAX_SCANS          8
+
+typedef struct {
+    double start_s;
+    bool started, done, converged;
+    int64_t request_us;
+    uint32_t latency_ms;
+    temperature_scan_t result;
+} scan_t;
+
+static char *load_text(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc((size_t)len + 1);
+    if (text && fread(text, 1, (size_t)len, f) != (size_t)len)
+    {
+        free(text);
+        text = NULL;
+    }
+    if (text)
+        text[len] = '\0';
+    fclose(f);
+    return text;
+}
+
+static uint32_t s_rng = 5;
+
+// Uniform in [-1, 1)
+static double noise(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (double)(s_rng >> 8) / (double)(1u << 23) - 1.0;
+}
+
+// 120 s at 10 Hz: off-skin, a forehead reading settling on 36.5 C and held
+// there, off-skin again, then a 37.9 C reading held to the end, steady to
+// the last digit for the final 20 s. The sensor die warms slowly and one
+// reading is a spike.
+static void synth(void)
+{
+    const double skin1 = 36.5, skin2 = 37.9;
+    double t_off = 0.0, obj = 23.0;
+
+    printf("# synthetic, temp_replay --synth\ntimestamp_us,object_c,ambient_c\n");
+    for (int i = 0; i < 1200; i++)
+    {
+        double t = i / 10.0;
+        double ambient = 23.0 + 0.4 * t / 120.0;
+        if (t < 5.0)
+            obj = ambient;
+        else if (t < 50.0)
+            obj = skin1 - (skin1 - ambient) * exp(-(t - 5.0) / 2.0);
+        else if (t < 60.0)
+        {
+            if (t_off == 0.0)
+                t_off = obj;
+            obj = ambient + (t_off - ambient) * exp(-(t - 50.0) / 1.0);
+        }
+        else
+            obj = skin2 - (skin2 - 23.5) * exp(-(t - 60.0) / 2.5);
+
+        double reading = obj + (t < 100.0 ? 0.02 * noise() : 0.0);
+        if (i == 123)
+            reading += 1.5;
+        // MLX90614 resolution
+        printf("%ld,%.2f,%.2f\n", 2000000L + i * 100000L, round(reading * 50.0) / 50.0, round(ambient * 50.0) / 50.0);
+    }
+}
+
+static void sleep_us(long us)
+{
+    struct timespec ts = {us / 1000000, (us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+static double host_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL;
+    bool realtime = false, check = false;
+    uint32_t expect = 0, max_scan_ms = 0;
+    scan_t scans[MAX_SCANS] = {0};
+    int n_scans = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--synth"))
+        {
+            synth();
+            return EXIT_SUCCESS;
+        }
+        if (!strcmp(argv[i], "--realtime"))
+            realtime = true;
+        else if (!strcmp(argv[i], "--expect") && i + 1 < argc)
+        {
+            expect = (uint32_t)strtoul(argv[++i], NULL, 16);
+            check = true;
+        }
+        else if (!strcmp(argv[i], "--scan") && i + 1 < argc && n_scans < MAX_SCANS)
+            scans[n_scans++].start_s = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--max-scan-ms") && i + 1 < argc)
+            max_scan_ms = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else
+            path = argv[i];
+    }
+    if (!path)
+    {
+        fprintf(stderr, "usage: %s [--realtime] [--expect DIGEST] [--scan SECONDS]... [--max-scan-ms MS] trace.csv\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *text = load_text(path);
+    if (!text || sensor_replay_set_temp_csv(text) != ESP_OK)
+        return EXIT_FAILURE;
+    sensor_hal_use_replay(realtime ? SENSOR_REPLAY_REALTIME : SENSOR_REPLAY_ASAP);
+    temperature_init();
+
+    sensor_replay_stats_t st;
+    int64_t start_us = esp_timer_get_time();
+    double host_start = host_s();
+    do
+    {
+        int64_t now = esp_timer_get_time();
+        for (int k = 0; k < n_scans; k++)
+        {
+            scan_t *s = &scans[k];
+            if (!s->started && now - start_us >= (int64_t)(s->start_s * 1e6))
+            {
+                // A new scan supersedes the one still running
+                for (int j = 0; j < n_scans; j++)
+                {
+                    if (scans[j].started && !scans[j].done)
+                    {
+                        scans[j].done = true;
+                        scans[j].latency_ms = (uint32_t)((now - scans[j].request_us) / 1000);
+                    }
+                }
+                temperature_start_scan();
+                s->started = true;
+                s->request_us = now;
+            }
+        }
+
+        temperature_tick();
+
+        for (int k = 0; k < n_scans; k++)
+        {
+            scan_t *s = &scans[k];
+            if (!s->started || s->done)
+                continue;
+            temperature_get_scan(&s->result);
+            uint32_t age_ms = (uint32_t)((esp_timer_get_time() - s->request_us) / 1000);
+            if (s->result.converged || age_ms >= TEMP_SCAN_MAX_MS)
+            {
+                s->done = true;
+                s->converged = s->result.converged;
+                s->latency_ms = age_ms;
+            }
+        }
+
+        sensor_replay_get_stats(&st);
+        if (realtime)
+            sleep_us(TEMP_JOB_PERIOD_US);
+        else
+            esp_host_skip_time(TEMP_JOB_PERIOD_US);
+    } while (!st.temp_done);
+    double host_elapsed = host_s() - host_start;
+
+    temperature_stats_t ts;
+    temperature_get_stats(&ts);
+    printf("%s: %lu readings, %lu outputs, digest %08lx\n", path, (unsigned long)st.temp_readings,
+           (unsigned long)st.outputs, (unsigned long)st.output_digest);
+    printf("throughput %.0f readings/s, %.2f us/reading (tracker and estimator)\n", st.temp_readings / host_elapsed,
+           host_elapsed * 1e6 / st.temp_readings);
+    printf("reads ok %lu, failed %lu, retries %lu\n", (unsigned long)ts.reads_ok, (unsigned long)ts.reads_failed,
+           (unsigned long)ts.retries);
+
+    bool ok = true;
+    for (int k = 0; k < n_scans; k++)
+    {
+        const scan_t *s = &scans[k];
+        const temperature_scan_t *r = &s->result;
+        bool pass = s->converged && (max_scan_ms == 0 || s->latency_ms <= max_scan_ms);
+        if (!s->started)
+            printf("scan at %.1f s: not reached\n", s->start_s);
+        else if (s->converged)
+            printf("scan at %.1f s: %.2f C after %lu ms, confidence %d (%lu samples, %lu rejected)\n", s->start_s,
+                   r->value_c, (unsigned long)s->latency_ms, r->confidence, (unsigned long)r->samples,
+                   (unsigned long)r->rejected);
+        else
+            printf("scan at %.1f s: not converged after %lu ms, last %.2f C\n", s->start_s,
+                   (unsigned long)s->latency_ms, r->value_c);
+        if (max_scan_ms)
+            ok &= pass;
+    }
+
+    free(text);
+    if (check && st.output_digest != expect)
+    {
+        printf("digest mismatch, expected %08lx\n", (unsigned long)expect);
+        ok = false;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "max30100.h"
+#include "mlx90614.h"
+
+// Sensor access for the trackers. health_tracker and temperature_tracker
+// reach the PPG and thermometer only through these calls, so a backend can
+// stand in for the hardware. The default backend is the real drivers. The
+// replay backend feeds recorded traces through the same path, either in
+// real time or as fast as the trackers consume them.
+//
+// Typical replay run, before health_init()/temperature_init():
+//     sensor_replay_set_ppg_csv(trace_csv, &meta);
+//     sensor_replay_set_temp_csv(temp_csv);
+//     sensor_hal_use_replay(SENSOR_REPLAY_ASAP);
+// Then read sensor_replay_get_stats() once done (PPG) or temp_done is set. output_digest is
+// equal between two builds exactly when the trackers produced the same
+// outputs from the same trace.
+
+#define SENSOR_REPLAY_ASAP_BURST MAX30100_RING_SIZE // samples between yields in ASAP mode
+
+typedef struct {
+    esp_err_t (*ppg_init)(const max30100_config_t *cfg);
+    esp_err_t (*ppg_start)(void);
+    size_t (*ppg_read)(max30100_sample_t *out, size_t max);
+    esp_err_t (*ppg_set_led_current)(max30100_current_t red, max30100_current_t ir);
+    esp_err_t (*ppg_set_sampling)(max30100_sampling_rate_t rate, max30100_pulse_width_t pw);
+    esp_err_t (*ppg_set_power)(bool on);
+    esp_err_t (*temp_init)(void);
+    esp_err_t (*temp_read)(mlx90614_reading_t *out);
+} sensor_hal_ops_t;
+
+typedef enum {
+    SENSOR_REPLAY_REALTIME, // samples become available at their recorded time
+    SENSOR_REPLAY_ASAP,     // as fast as the trackers drain them
+} sensor_replay_pace_t;
+
+// Conditions the PPG trace was recorded under
+typedef struct {
+    max30100_sampling_rate_t rate;  // sample rate of a FIFO dump; CSV carries its own timestamps
+    max30100_pulse_width_t pulse_width;
+    max30100_current_t ir_current;
+    max30100_current_t red_current;
+} sensor_replay_ppg_meta_t;
+
+typedef struct {
+    uint32_t ppg_samples;     // samples handed to the health tracker
+    uint32_t temp_readings;
+    int64_t elapsed_us;       // first to last delivery
+    uint32_t samples_per_s;   // PPG throughput over elapsed_us
+    uint32_t latency_avg_us;  // due time -> handed over, REALTIME only
+    uint32_t latency_max_us;
+    uint32_t clipped;         // samples saturated by the LED current emulation
+    uint32_t outputs;         // records passed to sensor_hal_note_output()
+    uint32_t output_digest;   // FNV-1a over those records
+    bool done;                // the PPG trace has been played to the end
+    bool temp_done;           // the temperature trace has been played to the end
+} sensor_replay_stats_t;
+
+// Backend switch; must happen before the trackers are initialised
+esp_err_t sensor_hal_use_replay(sensor_replay_pace_t pace);
+void sensor_hal_use_hardware(void);
+bool sensor_hal_is_replay(void);
+
+esp_err_t sensor_hal_ppg_init(const max30100_config_t *cfg);
+esp_err_t sensor_hal_ppg_start(void);
+size_t sensor_hal_ppg_read(max30100_sample_t *out, size_t max);
+esp_err_t sensor_hal_ppg_set_led_current(max30100_current_t red, max30100_current_t ir);
+esp_err_t sensor_hal_ppg_set_sampling(max30100_sampling_rate_t rate, max30100_pulse_width_t pw);
+esp_err_t sensor_hal_ppg_set_power(bool on);
+esp_err_t sensor_hal_temp_init(void);
+esp_err_t sensor_hal_temp_read(mlx90614_reading_t *out);
+
+// Trackers report each output record here; only hashed while replaying
+void sensor_hal_note_output(const void *data, size_t len);
+
+// Traces are used in place and must outlive the replay. CSV text must be
+// NUL-terminated (EMBED_TXTFILES does this); lines that do not start with a
+// digit are skipped, so headers and # comments are allowed.
+//   PPG CSV:         timestamp_us,ir,red
+//   PPG FIFO dump:   raw FIFO bytes, IR then red, big-endian, 4 per sample
+//   temperature CSV: timestamp_us,object_c,ambient_c
+esp_err_t sensor_replay_set_ppg_csv(const char *text, const sensor_replay_ppg_meta_t *meta);
+esp_err_t sensor_replay_set_ppg_fifo(const uint8_t *dump, size_t len, const sensor_replay_ppg_meta_t *meta);
+esp_err_t sensor_replay_set_temp_csv(const char *text);
+
+void sensor_replay_get_stats(sensor_replay_stats_t *out);
+
+// Backend tables, selected by sensor_hal_use_*()
+extern const sensor_hal_ops_t sensor_hal_hw_ops;
+extern const sensor_hal_ops_t sensor_replay_ops;
+
+// Used by sensor_hal_use_replay() to rewind the traces and stats
+void sensor_replay_start(sensor_replay_pace_t pace);
+void sensor_replay_note_output(const void *data, size_t len);
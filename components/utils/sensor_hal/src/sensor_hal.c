@@ -0,0 +1,81 @@
+#include "sensor_hal.h"
+#include "esp_log.h"
+
+static const char *TAG = "sensor_hal";
+
+const sensor_hal_ops_t sensor_hal_hw_ops = {
+    .ppg_init = max30100_init,
+    .ppg_start = max30100_start_acquisition,
+    .ppg_read = max30100_read_samples,
+    .ppg_set_led_current = max30100_set_led_current,
+    .ppg_set_sampling = max30100_set_sampling,
+    .ppg_set_power = max30100_set_power,
+    .temp_init = mlx90614_init,
+    .temp_read = mlx90614_read,
+};
+
+static const sensor_hal_ops_t *s_ops = &sensor_hal_hw_ops;
+
+esp_err_t sensor_hal_use_replay(sensor_replay_pace_t pace)
+{
+    sensor_replay_start(pace);
+    s_ops = &sensor_replay_ops;
+    ESP_LOGW(TAG, "Replaying recorded traces (%s)", pace == SENSOR_REPLAY_ASAP ? "as fast as possible" : "real time");
+    return ESP_OK;
+}
+
+void sensor_hal_use_hardware(void)
+{
+    s_ops = &sensor_hal_hw_ops;
+}
+
+bool sensor_hal_is_replay(void)
+{
+    return s_ops == &sensor_replay_ops;
+}
+
+esp_err_t sensor_hal_ppg_init(const max30100_config_t *cfg)
+{
+    return s_ops->ppg_init(cfg);
+}
+
+esp_err_t sensor_hal_ppg_start(void)
+{
+    return s_ops->ppg_start();
+}
+
+size_t sensor_hal_ppg_read(max30100_sample_t *out, size_t max)
+{
+    return s_ops->ppg_read(out, max);
+}
+
+esp_err_t sensor_hal_ppg_set_led_current(max30100_current_t red, max30100_current_t ir)
+{
+    return s_ops->ppg_set_led_current(red, ir);
+}
+
+esp_err_t sensor_hal_ppg_set_sampling(max30100_sampling_rate_t rate, max30100_pulse_width_t pw)
+{
+    return s_ops->ppg_set_sampling(rate, pw);
+}
+
+esp_err_t sensor_hal_ppg_set_power(bool on)
+{
+    return s_ops->ppg_set_power(on);
+}
+
+esp_err_t sensor_hal_temp_init(void)
+{
+    return s_ops->temp_init();
+}
+
+esp_err_t sensor_hal_temp_read(mlx90614_reading_t *out)
+{
+    return s_ops->temp_read(out);
+}
+
+void sensor_hal_note_output(const void *data, size_t len)
+{
+    if (s_ops == &sensor_replay_ops)
+        sensor_replay_note_output(data, len);
+}
@@ -0,0 +1,414 @@
+#include "sensor_hal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "sensor_replay";
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME  16777619u
+
+typedef struct {
+    int64_t t_us; // relative to the first record
+    uint32_t ir;
+    uint32_t red;
+} ppg_rec_t;
+
+typedef struct {
+    int64_t t_us;
+    float object_c;
+    float ambient_c;
+} temp_rec_t;
+
+// PPG trace and its playback cursor. Playback resamples the trace onto the
+// rate the tracker asked for (zero-order hold), so profile switches work.
+static const char *s_ppg_csv = NULL;
+static const uint8_t *s_ppg_fifo = NULL;
+static size_t s_ppg_fifo_len = 0;
+static sensor_replay_ppg_meta_t s_meta;
+
+static const char *s_ppg_pos;
+static size_t s_ppg_index;
+static int64_t s_ppg_t0;
+static ppg_rec_t s_ppg_cur, s_ppg_next;
+static bool s_ppg_have_next;
+
+// Emulated sensor state
+static uint32_t s_period_us = 10000;
+static uint32_t s_full_scale;
+static max30100_pulse_width_t s_pw;
+static max30100_current_t s_ir_current, s_red_current;
+static bool s_powered = false;
+static bool s_started = false;
+static int64_t s_next_us;    // timestamp of the next delivered sample
+static int64_t s_trace_us;   // trace time it is taken from
+static uint32_t s_burst = 0;
+
+static const char *s_temp_csv = NULL;
+static const char *s_temp_pos;
+static int64_t s_temp_t0;
+static temp_rec_t s_temp_cur, s_temp_next;
+static bool s_temp_have_cur, s_temp_have_next;
+static int64_t s_temp_start_us = -1;
+
+static sensor_replay_pace_t s_pace = SENSOR_REPLAY_REALTIME;
+static sensor_replay_stats_t s_stats;
+static uint64_t s_latency_sum = 0;
+static int64_t s_first_us = -1;
+
+// Skips to the next line that starts with a digit; NULL at the end
+static const char *csv_next_line(const char *p)
+{
+    while (*p && !isdigit((unsigned char)*p))
+    {
+        while (*p && *p != '\n')
+            p++;
+        if (*p)
+            p++;
+    }
+    return *p ? p : NULL;
+}
+
+static const char *csv_skip_field(const char *p)
+{
+    while (*p == ' ')
+        p++;
+    return *p == ',' ? p + 1 : NULL;
+}
+
+static bool ppg_load(ppg_rec_t *r)
+{
+    if (s_ppg_fifo)
+    {
+        if ((s_ppg_index + 1) * 4 > s_ppg_fifo_len)
+            return false;
+        const uint8_t *b = &s_ppg_fifo[s_ppg_index * 4];
+        r->t_us = (int64_t)s_ppg_index * 1000000 / max30100_sample_rate_hz(s_meta.rate);
+        r->ir = ((uint32_t)b[0] << 8) | b[1];
+        r->red = ((uint32_t)b[2] << 8) | b[3];
+        s_ppg_index++;
+        return true;
+    }
+
+    while (s_ppg_pos && (s_ppg_pos = csv_next_line(s_ppg_pos)) != NULL)
+    {
+        char *end;
+        const char *p = s_ppg_pos;
+        long long t = strtoll(p, &end, 10);
+        p = csv_skip_field(end);
+        if (p)
+        {
+            r->ir = strtoul(p, &end, 10);
+            p = csv_skip_field(end);
+        }
+        if (p)
+            r->red = strtoul(p, &end, 10);
+
+        // Move past this line whether or not it parsed
+        while (*s_ppg_pos && *s_ppg_pos != '\n')
+            s_ppg_pos++;
+
+        if (!p)
+            continue;
+        if (s_ppg_index++ == 0)
+            s_ppg_t0 = t;
+        r->t_us = t - s_ppg_t0;
+        return true;
+    }
+    return false;
+}
+
+static bool temp_load(temp_rec_t *r)
+{
+    while (s_temp_pos && (s_temp_pos = csv_next_line(s_temp_pos)) != NULL)
+    {
+        char *end;
+        const char *p = s_temp_pos;
+        long long t = strtoll(p, &end, 10);
+        p = csv_skip_field(end);
+        if (p)
+        {
+            r->object_c = strtof(p, &end);
+            p = csv_skip_field(end);
+        }
+        if (p)
+            r->ambient_c = strtof(p, &end);
+
+        while (*s_temp_pos && *s_temp_pos != '\n')
+            s_temp_pos++;
+
+        if (!p)
+            continue;
+        if (!s_temp_have_cur && !s_temp_have_next)
+            s_temp_t0 = t;
+        r->t_us = t - s_temp_t0;
+        return true;
+    }
+    return false;
+}
+
+// LED current in 0.1 mA. The register steps are close to 3.2 mA apart from
+// 4.4 mA up; the emulation only needs the ratio between two settings.
+static uint32_t led_ma10(max30100_current_t c)
+{
+    return c ? 32u * c + 12u : 0;
+}
+
+static uint32_t emulate(uint32_t raw, max30100_current_t now, max30100_current_t rec)
+{
+    uint64_t v = raw;
+    if (led_ma10(rec))
+        v = v * led_ma10(now) / led_ma10(rec);
+    if (s_pw >= s_meta.pulse_width)
+        v <<= (s_pw - s_meta.pulse_width);
+    else
+        v >>= (s_meta.pulse_width - s_pw);
+
+    if (v > s_full_scale)
+    {
+        s_stats.clipped++;
+        v = s_full_scale;
+    }
+    return (uint32_t)v;
+}
+
+void sensor_replay_start(sensor_replay_pace_t pace)
+{
+    s_pace = pace;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.output_digest = FNV_OFFSET;
+    s_latency_sum = 0;
+    s_first_us = -1;
+    s_burst = 0;
+    s_started = false;
+    s_trace_us = 0;
+
+    s_ppg_pos = s_ppg_csv;
+    s_ppg_index = 0;
+    s_ppg_have_next = false;
+    if (ppg_load(&s_ppg_cur))
+        s_ppg_have_next = ppg_load(&s_ppg_next);
+    else
+        s_stats.done = true;
+
+    s_temp_pos = s_temp_csv;
+    s_temp_have_cur = false;
+    s_temp_have_next = false;
+    s_temp_have_cur = temp_load(&s_temp_cur);
+    if (s_temp_have_cur)
+        s_temp_have_next = temp_load(&s_temp_next);
+    s_stats.temp_done = !s_temp_have_cur;
+    s_temp_start_us = -1;
+}
+
+esp_err_t sensor_replay_set_ppg_csv(const char *text, const sensor_replay_ppg_meta_t *meta)
+{
+    if (!text || !meta)
+        return ESP_ERR_INVALID_ARG;
+    s_ppg_csv = text;
+    s_ppg_fifo = NULL;
+    s_meta = *meta;
+    return ESP_OK;
+}
+
+esp_err_t sensor_replay_set_ppg_fifo(const uint8_t *dump, size_t len, const sensor_replay_ppg_meta_t *meta)
+{
+    if (!dump || len < 4 || !meta)
+        return ESP_ERR_INVALID_ARG;
+    s_ppg_fifo = dump;
+    s_ppg_fifo_len = len;
+    s_ppg_csv = NULL;
+    s_meta = *meta;
+    return ESP_OK;
+}
+
+esp_err_t sensor_replay_set_temp_csv(const char *text)
+{
+    if (!text)
+        return ESP_ERR_INVALID_ARG;
+    s_temp_csv = text;
+    return ESP_OK;
+}
+
+static esp_err_t replay_ppg_init(const max30100_config_t *cfg)
+{
+    s_period_us = 1000000 / max30100_sample_rate_hz(cfg->sampling_rate);
+    s_pw = cfg->pulse_width;
+    s_full_scale = max30100_adc_full_scale(cfg->pulse_width);
+    s_ir_current = cfg->ir_current;
+    s_red_current = cfg->red_current;
+    s_powered = true;
+    ESP_LOGI(TAG, "PPG replay at %lu Hz", (unsigned long)max30100_sample_rate_hz(cfg->sampling_rate));
+    return ESP_OK;
+}
+
+static esp_err_t replay_ppg_start(void)
+{
+    if (!s_started)
+    {
+        s_next_us = esp_timer_get_time();
+        s_started = true;
+    }
+    return ESP_OK;
+}
+
+static size_t replay_ppg_read(max30100_sample_t *out, size_t max)
+{
+    if (!s_powered || !s_started || s_stats.done)
+        return 0;
+
+    int64_t now = esp_timer_get_time();
+    size_t n = 0;
+    while (n < max)
+    {
+        if (s_pace == SENSOR_REPLAY_REALTIME && s_next_us > now)
+            break;
+        // Look like an empty FIFO now and then so health_update() returns
+        if (s_pace == SENSOR_REPLAY_ASAP && s_burst >= SENSOR_REPLAY_ASAP_BURST)
+        {
+            if (n == 0)
+                s_burst = 0;
+            break;
+        }
+
+        while (s_ppg_have_next && s_ppg_next.t_us <= s_trace_us)
+        {
+            s_ppg_cur = s_ppg_next;
+            s_ppg_have_next = ppg_load(&s_ppg_next);
+        }
+        if (!s_ppg_have_next && s_trace_us > s_ppg_cur.t_us)
+        {
+            s_stats.done = true;
+            ESP_LOGI(TAG, "PPG trace finished after %lu samples", (unsigned long)s_stats.ppg_samples + n);
+            break;
+        }
+
+        out[n].ir = (uint16_t)emulate(s_ppg_cur.ir, s_ir_current, s_meta.ir_current);
+        out[n].red = (uint16_t)emulate(s_ppg_cur.red, s_red_current, s_meta.red_current);
+        out[n].timestamp_us = s_next_us;
+
+        if (s_pace == SENSOR_REPLAY_REALTIME)
+        {
+            uint32_t latency = (uint32_t)(now - s_next_us);
+            s_latency_sum += latency;
+            if (latency > s_stats.latency_max_us)
+                s_stats.latency_max_us = latency;
+        }
+
+        s_next_us += s_period_us;
+        s_trace_us += s_period_us;
+        s_burst++;
+        n++;
+    }
+
+    if (n > 0)
+    {
+        if (s_first_us < 0)
+            s_first_us = now;
+        s_stats.ppg_samples += n;
+        s_stats.elapsed_us = now - s_first_us;
+    }
+    return n;
+}
+
+static esp_err_t replay_ppg_set_led_current(max30100_current_t red, max30100_current_t ir)
+{
+    s_red_current = red;
+    s_ir_current = ir;
+    return ESP_OK;
+}
+
+static esp_err_t replay_ppg_set_sampling(max30100_sampling_rate_t rate, max30100_pulse_width_t pw)
+{
+    s_period_us = 1000000 / max30100_sample_rate_hz(rate);
+    s_pw = pw;
+    s_full_scale = max30100_adc_full_scale(pw);
+    return ESP_OK;
+}
+
+static esp_err_t replay_ppg_set_power(bool on)
+{
+    // The trace pauses while the sensor is off
+    if (on && !s_powered && s_started)
+    {
+        int64_t now = esp_timer_get_time();
+        if (s_next_us < now)
+            s_next_us = now;
+    }
+    s_powered = on;
+    return ESP_OK;
+}
+
+static esp_err_t replay_temp_init(void)
+{
+    return ESP_OK;
+}
+
+static esp_err_t replay_temp_read(mlx90614_reading_t *out)
+{
+    if (!s_temp_have_cur)
+        return ESP_ERR_NOT_FOUND;
+
+    int64_t now = esp_timer_get_time();
+    if (s_pace == SENSOR_REPLAY_REALTIME)
+    {
+        if (s_temp_start_us < 0)
+            s_temp_start_us = now;
+        while (s_temp_have_next && s_temp_next.t_us <= now - s_temp_start_us)
+        {
+            s_temp_cur = s_temp_next;
+            s_temp_have_next = temp_load(&s_temp_next);
+        }
+    }
+    else if (s_stats.temp_readings > 0)
+    {
+        // One record per read; the trace ends like a sensor that went away
+        if (!s_temp_have_next)
+            return ESP_ERR_NOT_FOUND;
+        s_temp_cur = s_temp_next;
+        s_temp_have_next = temp_load(&s_temp_next);
+    }
+
+    out->object_c = s_temp_cur.object_c;
+    out->ambient_c = s_temp_cur.ambient_c;
+    out->timestamp_us = now;
+    s_stats.temp_readings++;
+    if (!s_temp_have_next && !s_stats.temp_done)
+    {
+        s_stats.temp_done = true;
+        ESP_LOGI(TAG, "Temperature trace finished after %lu readings", (unsigned long)s_stats.temp_readings);
+    }
+    return ESP_OK;
+}
+
+const sensor_hal_ops_t sensor_replay_ops = {
+    .ppg_init = replay_ppg_init,
+    .ppg_start = replay_ppg_start,
+    .ppg_read = replay_ppg_read,
+    .ppg_set_led_current = replay_ppg_set_led_current,
+    .ppg_set_sampling = replay_ppg_set_sampling,
+    .ppg_set_power = replay_ppg_set_power,
+    .temp_init = replay_temp_init,
+    .temp_read = replay_temp_read,
+};
+
+void sensor_replay_note_output(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint32_t h = s_stats.output_digest;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * FNV_PRIME;
+    s_stats.output_digest = h;
+    s_stats.outputs++;
+}
+
+void sensor_replay_get_stats(sensor_replay_stats_t *out)
+{
+    *out = s_stats;
+    if (s_stats.elapsed_us > 0)
+        out->samples_per_s = (uint32_t)((uint64_t)s_stats.ppg_samples * 1000000 / s_stats.elapsed_us);
+    if (s_pace == SENSOR_REPLAY_REALTIME && s_stats.ppg_samples > 0)
+        out->latency_avg_us = (uint32_t)(s_latency_sum / s_stats.ppg_samples);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Deadline-driven sensor scheduler. Every sensor registers a period, a
+// deadline and a power hook; one task runs the due jobs in earliest-deadline
+// order and sleeps on a one-shot esp_timer armed for the next release.
+// Consumers (screens, uplinks) subscribe to the sensors they need: a sensor
+// is only powered and scheduled while it has at least one subscriber.
+
+#define SENSOR_SCHED_MAX_SENSORS   8
+#define SENSOR_SCHED_MAX_CONSUMERS 8
+#define SENSOR_SCHED_TASK_PRIO     5
+#define SENSOR_SCHED_STACK         4096
+
+typedef int sensor_id_t;
+
+typedef enum {
+    SENSOR_POWER_OFF,    // powered down, needs a full restart
+    SENSOR_POWER_IDLE,   // standby, quick to resume
+    SENSOR_POWER_ACTIVE, // sampling, job is scheduled
+} sensor_power_t;
+
+// Both hooks run in the scheduler task
+typedef void (*sensor_job_fn_t)(void *arg);
+typedef void (*sensor_power_fn_t)(sensor_power_t state, void *arg);
+
+typedef struct {
+    const char *name;
+    uint32_t period_us;
+    uint32_t deadline_us;      // relative to the release; 0 means the period
+    sensor_power_t idle_power; // state applied while nobody subscribes
+    sensor_job_fn_t job;
+    sensor_power_fn_t set_power; // may be NULL
+    void *arg;
+} sensor_sched_desc_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t overruns;         // finished after release + deadline
+    uint32_t skipped;          // releases dropped because the job ran late
+    uint32_t last_jitter_us;   // release -> start
+    uint32_t avg_jitter_us;
+    uint32_t max_jitter_us;
+    uint32_t last_exec_us;
+    uint32_t max_exec_us;
+    sensor_power_t power;
+} sensor_sched_stats_t;
+
+esp_err_t sensor_sched_init(void);
+
+esp_err_t sensor_sched_register(const sensor_sched_desc_t *desc, sensor_id_t *out_id);
+
+// consumer is a caller-chosen slot below SENSOR_SCHED_MAX_CONSUMERS. If notify
+// is not NULL it gets xTaskNotifyGive() after every run of the sensor's job.
+esp_err_t sensor_sched_subscribe(sensor_id_t id, int consumer, TaskHandle_t notify);
+
+esp_err_t sensor_sched_unsubscribe(sensor_id_t id, int consumer);
+
+esp_err_t sensor_sched_get_stats(sensor_id_t id, sensor_sched_stats_t *out);
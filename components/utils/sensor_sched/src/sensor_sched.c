@@ -0,0 +1,243 @@
+#include "sensor_sched.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char *TAG = "sensor_sched";
+
+typedef struct {
+    sensor_sched_desc_t desc;
+    int64_t release_us;        // next release, valid while active
+    uint32_t subscribers;      // consumer bitmask
+    sensor_sched_stats_t stats;
+} sensor_slot_t;
+
+static sensor_slot_t s_sensors[SENSOR_SCHED_MAX_SENSORS];
+static int s_sensor_count = 0;
+static TaskHandle_t s_consumers[SENSOR_SCHED_MAX_CONSUMERS];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t s_task = NULL;
+static esp_timer_handle_t s_timer = NULL;
+
+static void sensor_sched_wake(void *arg)
+{
+    (void)arg;
+    xTaskNotifyGive(s_task);
+}
+
+// Brings every sensor's power state in line with its subscriptions
+static void sensor_sched_apply_power(int64_t now)
+{
+    for (int i = 0; i < s_sensor_count; i++)
+    {
+        sensor_slot_t *s = &s_sensors[i];
+
+        portENTER_CRITICAL(&s_lock);
+        sensor_power_t want = s->subscribers ? SENSOR_POWER_ACTIVE : s->desc.idle_power;
+        portEXIT_CRITICAL(&s_lock);
+
+        if (want == s->stats.power)
+            continue;
+
+        ESP_LOGI(TAG, "%s: power %d -> %d", s->desc.name, s->stats.power, want);
+        if (s->desc.set_power)
+            s->desc.set_power(want, s->desc.arg);
+        if (want == SENSOR_POWER_ACTIVE)
+            s->release_us = now;
+        s->stats.power = want;
+    }
+}
+
+static void sensor_sched_notify(const sensor_slot_t *s)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint32_t mask = s->subscribers;
+    portEXIT_CRITICAL(&s_lock);
+
+    for (int c = 0; mask; c++, mask >>= 1)
+    {
+        if ((mask & 1) && s_consumers[c])
+            xTaskNotifyGive(s_consumers[c]);
+    }
+}
+
+static void sensor_sched_run(sensor_slot_t *s)
+{
+    sensor_sched_stats_t *st = &s->stats;
+    uint32_t deadline = s->desc.deadline_us ? s->desc.deadline_us : s->desc.period_us;
+
+    int64_t start = esp_timer_get_time();
+    s->desc.job(s->desc.arg);
+    int64_t end = esp_timer_get_time();
+
+    uint32_t jitter = (uint32_t)(start - s->release_us);
+    uint32_t exec = (uint32_t)(end - start);
+    st->runs++;
+    st->last_jitter_us = jitter;
+    st->avg_jitter_us += ((int32_t)jitter - (int32_t)st->avg_jitter_us) / 8;
+    if (jitter > st->max_jitter_us)
+        st->max_jitter_us = jitter;
+    st->last_exec_us = exec;
+    if (exec > st->max_exec_us)
+        st->max_exec_us = exec;
+    if (end > s->release_us + deadline)
+        st->overruns++;
+
+    // Keep the original phase; releases that already passed are dropped
+    // rather than run back-to-back
+    s->release_us += s->desc.period_us;
+    if (s->release_us <= end)
+    {
+        int64_t missed = (end - s->release_us) / s->desc.period_us + 1;
+        st->skipped += (uint32_t)missed;
+        s->release_us += missed * s->desc.period_us;
+    }
+
+    sensor_sched_notify(s);
+}
+
+static void sensor_sched_task(void *arg)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        int64_t now = esp_timer_get_time();
+        sensor_sched_apply_power(now);
+
+        // Earliest deadline first among the jobs that are due
+        for (;;)
+        {
+            sensor_slot_t *next = NULL;
+            int64_t next_deadline = INT64_MAX;
+            for (int i = 0; i < s_sensor_count; i++)
+            {
+                sensor_slot_t *s = &s_sensors[i];
+                if (s->stats.power != SENSOR_POWER_ACTIVE || s->release_us > now)
+                    continue;
+                uint32_t deadline = s->desc.deadline_us ? s->desc.deadline_us : s->desc.period_us;
+                if (s->release_us + deadline < next_deadline)
+                {
+                    next_deadline = s->release_us + deadline;
+                    next = s;
+                }
+            }
+            if (!next)
+                break;
+            sensor_sched_run(next);
+            now = esp_timer_get_time();
+        }
+
+        int64_t wake = INT64_MAX;
+        for (int i = 0; i < s_sensor_count; i++)
+        {
+            if (s_sensors[i].stats.power == SENSOR_POWER_ACTIVE && s_sensors[i].release_us < wake)
+                wake = s_sensors[i].release_us;
+        }
+
+        esp_timer_stop(s_timer);
+        if (wake != INT64_MAX)
+        {
+            int64_t delay = wake - esp_timer_get_time();
+            esp_timer_start_once(s_timer, delay > 0 ? (uint64_t)delay : 1);
+        }
+    }
+}
+
+esp_err_t sensor_sched_init(void)
+{
+    if (s_task)
+        return ESP_OK;
+
+    const esp_timer_create_args_t args = {
+        .callback = sensor_sched_wake,
+        .name = "sensor_sched",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_timer);
+    if (err != ESP_OK)
+        return err;
+
+    if (xTaskCreate(sensor_sched_task, "sensor_sched", SENSOR_SCHED_STACK, NULL,
+                    SENSOR_SCHED_TASK_PRIO, &s_task) != pdPASS)
+    {
+        esp_timer_delete(s_timer);
+        s_timer = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Sensor scheduler started");
+    return ESP_OK;
+}
+
+esp_err_t sensor_sched_register(const sensor_sched_desc_t *desc, sensor_id_t *out_id)
+{
+    if (!desc || !desc->job || desc->period_us == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ESP_OK;
+    portENTER_CRITICAL(&s_lock);
+    if (s_sensor_count >= SENSOR_SCHED_MAX_SENSORS)
+    {
+        err = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+        sensor_slot_t *s = &s_sensors[s_sensor_count];
+        memset(s, 0, sizeof(*s));
+        s->desc = *desc;
+        // Sensors start out powered; the task moves them to idle_power
+        s->stats.power = SENSOR_POWER_ACTIVE;
+        s->release_us = esp_timer_get_time();
+        if (out_id)
+            *out_id = s_sensor_count;
+        s_sensor_count++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (err == ESP_OK && s_task)
+        xTaskNotifyGive(s_task);
+    return err;
+}
+
+static esp_err_t sensor_sched_set_subscriber(sensor_id_t id, int consumer, bool on, TaskHandle_t notify)
+{
+    if (id < 0 || id >= s_sensor_count || consumer < 0 || consumer >= SENSOR_SCHED_MAX_CONSUMERS)
+        return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&s_lock);
+    uint32_t before = s_sensors[id].subscribers;
+    if (on)
+    {
+        s_sensors[id].subscribers |= 1u << consumer;
+        s_consumers[consumer] = notify;
+    }
+    else
+    {
+        s_sensors[id].subscribers &= ~(1u << consumer);
+    }
+    bool changed = (before == 0) != (s_sensors[id].subscribers == 0);
+    portEXIT_CRITICAL(&s_lock);
+
+    if (changed && s_task)
+        xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+esp_err_t sensor_sched_subscribe(sensor_id_t id, int consumer, TaskHandle_t notify)
+{
+    return sensor_sched_set_subscriber(id, consumer, true, notify);
+}
+
+esp_err_t sensor_sched_unsubscribe(sensor_id_t id, int consumer)
+{
+    return sensor_sched_set_subscriber(id, consumer, false, NULL);
+}
+
+esp_err_t sensor_sched_get_stats(sensor_id_t id, sensor_sched_stats_t *out)
+{
+    if (id < 0 || id >= s_sensor_count || !out)
+        return ESP_ERR_INVALID_ARG;
+    *out = s_sensors[id].stats;
+    return ESP_OK;
+}
@@ -0,0 +1,234 @@
+// Host harness for vitals_log on the RAM-emulated NOR backend: append
+// throughput, mount cost of a full ring, wear spread and a power-cut run.
+//
+//     vlog_bench [--records N] [--cuts ITERATIONS]
+//
+// The benchmark fills the 960 KB vitals partition several times over with
+// records the size vitals_logger writes (5..13 bytes), reads everything
+// back, then remounts and counts the flash reads the mount took. Sector
+// erase counts must stay within one of each other.
+//
+// Each power-cut iteration starts from a blank 256 KB area, appends with
+// random flushes until vlog_emul cuts power after a random number of
+// programmed bytes, remounts and checks that every record flushed before
+// the cut is still there, in order and intact, and that appends carry on
+// after the torn block. Exits non-zero on any failure.
+#include "vitals_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define AREA_SIZE   (960 * 1024)
+#define CUT_SIZE    (64 * VLOG_SECTOR_SIZE)
+#define CUT_BYTES   200000 // power cut somewhere in the first this many bytes
+#define CUT_RESUME  5000   // records appended after the remount
+
+static uint8_t s_mem[AREA_SIZE];
+static uint32_t s_erase_counts[AREA_SIZE / VLOG_SECTOR_SIZE];
+static vlog_t s_log;
+
+static uint32_t s_rng = 9;
+
+static uint32_t rnd(uint32_t n)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (s_rng >> 8) % n;
+}
+
+// Record n: its sequence number, then bytes derived from it
+static size_t make_record(uint32_t n, uint8_t *rec)
+{
+    size_t len = 5 + n % 9;
+    memcpy(rec, &n, sizeof(n));
+    for (size_t i = sizeof(n); i < len; i++)
+        rec[i] = (uint8_t)(n * 7 + i);
+    return len;
+}
+
+static bool check_record(const uint8_t *rec, int len, uint32_t *n)
+{
+    uint8_t expect[VLOG_MAX_RECORD];
+    if (len < (int)sizeof(*n))
+        return false;
+    memcpy(n, rec, sizeof(*n));
+    return (int)make_record(*n, expect) == len && !memcmp(expect, rec, (size_t)len);
+}
+
+typedef struct {
+    uint32_t records;
+    uint32_t first, last;
+    uint32_t bad; // corrupt or out of sequence
+} vlog_scan_t;
+
+static vlog_scan_t scan(vlog_t *log)
+{
+    vlog_scan_t s = {0};
+    vlog_cursor_t c;
+    uint8_t rec[VLOG_MAX_RECORD];
+    int len;
+    vlog_cursor_oldest(log, &c);
+    while ((len = vlog_next(log, &c, rec, sizeof(rec))) > 0)
+    {
+        uint32_t n;
+        if (!check_record(rec, len, &n))
+        {
+            s.bad++;
+            continue;
+        }
+        if (s.records == 0)
+            s.first = n;
+        else if (n != s.last + 1)
+            s.bad++;
+        s.last = n;
+        s.records++;
+    }
+    return s;
+}
+
+static double elapsed_ns(const struct timespec *t0, const struct timespec *t1)
+{
+    return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+static int bench(uint32_t records)
+{
+    vlog_emul_t e;
+    vlog_flash_t flash;
+    memset(s_mem, 0xFF, sizeof(s_mem));
+    vlog_emul_init(&e, s_mem, AREA_SIZE, s_erase_counts, &flash);
+    if (vlog_mount(&s_log, &flash) != ESP_OK)
+    {
+        printf("bench: mount of a blank area failed\n");
+        return 1;
+    }
+
+    uint8_t rec[VLOG_MAX_RECORD];
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t n = 0; n < records; n++)
+    {
+        if (vlog_append(&s_log, rec, make_record(n, rec)) != ESP_OK)
+        {
+            printf("bench: append %lu failed\n", (unsigned long)n);
+            return 1;
+        }
+    }
+    vlog_flush(&s_log);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    vlog_stats_t st;
+    vlog_get_stats(&s_log, &st);
+    printf("append: %.1f ns/record, %lu blocks, %lu sectors erased (%lu dropped), %lu/%lu sectors used\n",
+           elapsed_ns(&t0, &t1) / records, (unsigned long)st.blocks_written, (unsigned long)st.sectors_erased,
+           (unsigned long)st.sectors_dropped, (unsigned long)st.sectors_used, (unsigned long)st.sectors);
+
+    uint32_t min_erases = UINT32_MAX, max_erases = 0;
+    for (size_t i = 0; i < sizeof(s_erase_counts) / sizeof(s_erase_counts[0]); i++)
+    {
+        if (s_erase_counts[i] < min_erases)
+            min_erases = s_erase_counts[i];
+        if (s_erase_counts[i] > max_erases)
+            max_erases = s_erase_counts[i];
+    }
+    printf("erase counts: %lu..%lu per sector\n", (unsigned long)min_erases, (unsigned long)max_erases);
+
+    vlog_scan_t s = scan(&s_log);
+    printf("read back: %lu records (%lu..%lu), %lu bad\n", (unsigned long)s.records, (unsigned long)s.first,
+           (unsigned long)s.last, (unsigned long)s.bad);
+
+    uint32_t reads = e.reads;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    esp_err_t err = vlog_mount(&s_log, &flash);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    vlog_get_stats(&s_log, &st);
+    printf("mount of the full ring: %lu flash reads (%lu counted by the backend), %.1f us on the host\n",
+           (unsigned long)st.mount_reads, (unsigned long)(e.reads - reads), elapsed_ns(&t0, &t1) / 1e3);
+
+    vlog_scan_t r = scan(&s_log);
+    bool ok = err == ESP_OK && s.bad == 0 && s.records > 0 && s.last == records - 1 && r.records == s.records &&
+              r.last == s.last && r.bad == 0 && max_erases - min_erases <= 1;
+    printf("bench: %s\n", ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+static int power_cuts(uint32_t iterations)
+{
+    uint32_t failures = 0, torn = 0;
+    uint8_t rec[VLOG_MAX_RECORD];
+
+    for (uint32_t it = 0; it < iterations; it++)
+    {
+        vlog_emul_t e;
+        vlog_flash_t flash;
+        memset(s_mem, 0xFF, CUT_SIZE);
+        vlog_emul_init(&e, s_mem, CUT_SIZE, NULL, &flash);
+        vlog_mount(&s_log, &flash);
+
+        // Append until the cut; flushed counts the records known durable
+        uint32_t flushed = 0, n = 0;
+        e.fail_after = 1 + rnd(CUT_BYTES);
+        while (vlog_append(&s_log, rec, make_record(n, rec)) == ESP_OK)
+        {
+            n++;
+            if (rnd(50) == 0)
+            {
+                if (vlog_flush(&s_log) != ESP_OK)
+                    break;
+                flushed = n;
+            }
+        }
+
+        e.failed = false;
+        e.fail_after = 0;
+        bool ok = vlog_mount(&s_log, &flash) == ESP_OK;
+        vlog_scan_t s = scan(&s_log);
+        vlog_stats_t st;
+        vlog_get_stats(&s_log, &st);
+        torn += st.bad_blocks;
+        // Older records may have been dropped with their sector, but the
+        // newest flushed one must have survived
+        ok &= s.bad == 0 && (flushed == 0 || (s.records > 0 && s.last + 1 >= flushed));
+
+        // Appends carry on after the torn block and survive a remount
+        for (uint32_t k = 0; ok && k < CUT_RESUME; k++)
+            ok = vlog_append(&s_log, rec, make_record(1000000 + k, rec)) == ESP_OK;
+        ok &= vlog_flush(&s_log) == ESP_OK && vlog_mount(&s_log, &flash) == ESP_OK;
+
+        vlog_cursor_t c;
+        vlog_cursor_newest(&s_log, &c);
+        ok &= vlog_next(&s_log, &c, rec, sizeof(rec)) == 0;
+        int len;
+        uint32_t last = 0;
+        vlog_cursor_oldest(&s_log, &c);
+        while ((len = vlog_next(&s_log, &c, rec, sizeof(rec))) > 0)
+            ok &= check_record(rec, len, &last);
+        ok &= last == 1000000 + CUT_RESUME - 1;
+
+        if (!ok && failures++ < 5)
+            printf("power cut %lu: flushed %lu, recovered %lu..%lu, %lu bad\n", (unsigned long)it,
+                   (unsigned long)flushed, (unsigned long)s.first, (unsigned long)s.last, (unsigned long)s.bad);
+    }
+    printf("power cuts: %lu iterations, %lu failures (%lu torn blocks skipped)\n", (unsigned long)iterations,
+           (unsigned long)failures, (unsigned long)torn);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t records = 3000000, cuts = 2000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--records") && i + 1 < argc)
+            records = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--cuts") && i + 1 < argc)
+            cuts = (uint32_t)strtoul(argv[++i], NULL, 0);
+    }
+
+    int errors = 0;
+    if (records)
+        errors += bench(records);
+    if (cuts)
+        errors += power_cuts(cuts);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
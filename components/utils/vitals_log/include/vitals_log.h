@@ -0,0 +1,123 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Append-only record log on raw NOR flash.
+//
+// The area is a ring of VLOG_SECTOR_SIZE sectors used in order, so every
+// sector is erased equally often; once the ring is full the oldest sector
+// is erased and its records are dropped. Slot 0 of a sector holds its
+// header (sequence number, erase count). The other slots hold one
+// VLOG_BLOCK_SIZE block each: a header with the payload length and a CRC-32,
+// then length-prefixed records. Records are gathered in RAM and a block is
+// programmed once it is full or on vlog_flush(), never per record.
+//
+// Mounting reads only the sector headers and the block headers of the
+// newest sector. A block torn by a power cut fails its CRC; readers skip
+// it and appends carry on after it.
+//
+// Flash access goes through vlog_flash_t (an esp_partition on the device,
+// vlog_emul_t on a host). Only esp_err.h is needed from ESP-IDF.
+
+#define VLOG_SECTOR_SIZE 4096
+#define VLOG_BLOCK_SIZE  256 // one flash program page
+#define VLOG_SLOTS       (VLOG_SECTOR_SIZE / VLOG_BLOCK_SIZE) // slot 0 is the sector header
+#define VLOG_BLOCK_HDR   8
+#define VLOG_PAYLOAD     (VLOG_BLOCK_SIZE - VLOG_BLOCK_HDR)
+#define VLOG_MAX_RECORD  64
+#define VLOG_MIN_SECTORS 2
+
+typedef struct {
+    void *ctx;
+    uint32_t size; // bytes, a multiple of VLOG_SECTOR_SIZE
+    esp_err_t (*read)(void *ctx, uint32_t addr, void *buf, size_t len);
+    esp_err_t (*write)(void *ctx, uint32_t addr, const void *buf, size_t len);
+    esp_err_t (*erase)(void *ctx, uint32_t addr); // the sector at addr
+} vlog_flash_t;
+
+typedef struct {
+    uint32_t sectors;
+    uint32_t sectors_used;
+    uint32_t records;         // appended since mount
+    uint32_t blocks_written;
+    uint32_t sectors_erased;
+    uint32_t sectors_dropped; // erased while still holding data
+    uint32_t bad_blocks;      // CRC or layout errors met while mounting or reading
+    uint32_t max_erase_count; // across the sectors written since mount
+    uint32_t mount_reads;     // flash reads the last mount took
+} vlog_stats_t;
+
+typedef struct {
+    vlog_flash_t flash;
+    uint32_t sectors;
+
+    // Ring: sequence numbers of the oldest and newest sectors in use
+    bool empty;
+    uint32_t tail_seq;
+    uint32_t head_seq;
+    uint32_t head_phys;
+    uint8_t head_slot;        // next slot to program in the head sector
+    uint32_t head_erases;
+
+    // Block being filled
+    uint8_t page[VLOG_BLOCK_SIZE];
+    uint16_t page_len;
+
+    vlog_stats_t stats;
+} vlog_t;
+
+// Position of a reader. Blocks are numbered in write order across the
+// whole ring; block ids of erased sectors are skipped over.
+typedef struct {
+    uint32_t block;
+    uint16_t off;             // into the cached block's payload
+    uint32_t cached;          // block id held in buf, UINT32_MAX for none
+    uint16_t len;
+    uint8_t buf[VLOG_PAYLOAD];
+} vlog_cursor_t;
+
+// Recovers the log from flash. A blank or foreign area mounts empty; its
+// sectors are erased as they are reached.
+esp_err_t vlog_mount(vlog_t *log, const vlog_flash_t *flash);
+
+// Erases the whole area
+esp_err_t vlog_format(vlog_t *log);
+
+// Queues a record of 1..VLOG_MAX_RECORD bytes, programming the block first
+// if the record does not fit in it
+esp_err_t vlog_append(vlog_t *log, const void *rec, size_t len);
+
+// Programs the partly filled block; records appended since the last flush
+// are lost on reset otherwise
+esp_err_t vlog_flush(vlog_t *log);
+
+// Cursor at the oldest record on flash
+void vlog_cursor_oldest(const vlog_t *log, vlog_cursor_t *c);
+
+// Cursor past the newest record on flash; it will return only new ones
+void vlog_cursor_newest(const vlog_t *log, vlog_cursor_t *c);
+
+// Copies the next programmed record into rec and returns its length, 0 at
+// the end of the log. Records lost to erasure are skipped.
+int vlog_next(vlog_t *log, vlog_cursor_t *c, void *rec, size_t max);
+
+void vlog_get_stats(const vlog_t *log, vlog_stats_t *out);
+
+// RAM-backed NOR flash for host runs: programming can only clear bits,
+// erase sets a sector to 0xFF. fail_after, when non-zero, cuts power after
+// that many more bytes are programmed; the cut write is partial and
+// returns ESP_FAIL, as do all later calls until it is cleared.
+typedef struct {
+    uint8_t *mem;
+    uint32_t size;
+    uint32_t *erase_counts;   // one per sector, may be NULL
+    uint32_t fail_after;
+    bool failed;
+    uint64_t bytes_read, bytes_written;
+    uint32_t reads, writes, erases;
+} vlog_emul_t;
+
+// mem starts erased (all 0xFF)
+void vlog_emul_init(vlog_emul_t *e, uint8_t *mem, uint32_t size, uint32_t *erase_counts, vlog_flash_t *out);
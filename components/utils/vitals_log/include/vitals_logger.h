@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "vitals_log.h"
+
+// Keeps every sample of the vitals store (see vitals_store.h) in the
+// "vitals" flash partition, so history survives resets and time offline.
+// A low-priority task drains the store once a second and programs a block
+// when one fills, or at least every VITALS_LOG_FLUSH_MS.
+
+#define VITALS_LOG_LABEL      "vitals"
+#define VITALS_LOG_SUBTYPE    0x40 // data partition subtype in partitions.csv
+#define VITALS_LOG_PERIOD_MS  1000
+#define VITALS_LOG_FLUSH_MS   60000 // longest a sample waits in RAM
+#define VITALS_LOG_BATCH      16    // samples read from the store per validation
+#define VITALS_LOG_TASK_PRIO  2
+#define VITALS_LOG_TASK_STACK 3072
+
+// Record: kind, uptime in ms (u32), then the fields below, little-endian.
+// A BOOT record starts each power cycle; uptimes restart after it.
+typedef enum {
+    VITALS_REC_BOOT = 1, // reset reason (u8)
+    VITALS_REC_HR,       // bpm, sqi (u8)
+    VITALS_REC_SPO2,     // percent, confidence (u8)
+    VITALS_REC_TEMP,     // object, ambient (i16, centi-degrees C)
+    VITALS_REC_GPS,      // lat, lon (i32, degrees * 1e7)
+} vitals_rec_kind_t;
+
+#define VITALS_REC_HDR 5
+#define VITALS_REC_MAX (VITALS_REC_HDR + 8)
+
+typedef struct {
+    vlog_stats_t log;
+    uint32_t samples_logged;
+    uint32_t samples_missed; // overwritten in the store before being drained
+    uint32_t write_errors;
+} vitals_logger_stats_t;
+
+// Mounts the partition and starts the logging task
+esp_err_t vitals_logger_init(void);
+
+// Programs whatever is buffered, e.g. before a deliberate restart
+esp_err_t vitals_logger_flush(void);
+
+void vitals_logger_get_stats(vitals_logger_stats_t *out);
+
+// Reads the log back, e.g. to upload what was recorded offline. Records
+// still buffered in RAM are not visible until flushed.
+void vitals_logger_cursor_oldest(vlog_cursor_t *c);
+int vitals_logger_next(vlog_cursor_t *c, void *rec, size_t max);
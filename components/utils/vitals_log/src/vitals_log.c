@@ -0,0 +1,336 @@
+#include "vitals_log.h"
+#include <string.h>
+
+#define VLOG_MAGIC      0x474F4C56u // "VLOG"
+#define VLOG_SECTOR_HDR 16
+#define VLOG_DATA_SLOTS (VLOG_SLOTS - 1)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t erase_count;
+    uint32_t crc;
+} vlog_sector_hdr_t;
+
+typedef struct {
+    uint16_t len;
+    uint16_t len_inv;
+    uint32_t crc;
+} vlog_block_hdr_t;
+
+_Static_assert(sizeof(vlog_sector_hdr_t) == VLOG_SECTOR_HDR, "sector header layout");
+_Static_assert(sizeof(vlog_block_hdr_t) == VLOG_BLOCK_HDR, "block header layout");
+_Static_assert(VLOG_MAX_RECORD + 1 <= VLOG_PAYLOAD, "a record must fit in a block");
+
+static uint32_t vlog_crc32(const uint8_t *p, size_t len)
+{
+    static const uint32_t t[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--)
+    {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ t[crc & 15];
+        crc = (crc >> 4) ^ t[crc & 15];
+    }
+    return ~crc;
+}
+
+static bool vlog_blank(const uint8_t *p, size_t len)
+{
+    while (len--)
+        if (*p++ != 0xFF)
+            return false;
+    return true;
+}
+
+static uint32_t vlog_block_id(uint32_t seq, uint32_t slot)
+{
+    return seq * VLOG_DATA_SLOTS + slot - 1;
+}
+
+static uint32_t vlog_phys(const vlog_t *log, uint32_t seq)
+{
+    return (log->head_phys + log->sectors - (log->head_seq - seq) % log->sectors) % log->sectors;
+}
+
+static esp_err_t vlog_read(vlog_t *log, uint32_t addr, void *buf, size_t len)
+{
+    return log->flash.read(log->flash.ctx, addr, buf, len);
+}
+
+// Reads a sector header; false if it is blank or not ours
+static bool vlog_read_sector_hdr(vlog_t *log, uint32_t phys, vlog_sector_hdr_t *h)
+{
+    log->stats.mount_reads++;
+    if (vlog_read(log, phys * VLOG_SECTOR_SIZE, h, sizeof(*h)) != ESP_OK)
+        return false;
+    return h->magic == VLOG_MAGIC && h->crc == vlog_crc32((const uint8_t *)h, offsetof(vlog_sector_hdr_t, crc));
+}
+
+static void vlog_reset(vlog_t *log)
+{
+    // The first sector opened gets sequence 1 at physical sector 0
+    log->empty = true;
+    log->head_seq = 0;
+    log->tail_seq = 1;
+    log->head_phys = log->sectors - 1;
+    log->head_slot = VLOG_SLOTS;
+    log->head_erases = 0;
+    log->page_len = 0;
+}
+
+esp_err_t vlog_mount(vlog_t *log, const vlog_flash_t *flash)
+{
+    if (flash->size / VLOG_SECTOR_SIZE < VLOG_MIN_SECTORS)
+        return ESP_ERR_INVALID_SIZE;
+
+    memset(log, 0, sizeof(*log));
+    log->flash = *flash;
+    log->sectors = flash->size / VLOG_SECTOR_SIZE;
+    vlog_reset(log);
+
+    // Newest sector
+    vlog_sector_hdr_t h;
+    for (uint32_t i = 0; i < log->sectors; i++)
+    {
+        if (!vlog_read_sector_hdr(log, i, &h))
+            continue;
+        if (log->empty || h.seq > log->head_seq)
+        {
+            log->empty = false;
+            log->head_seq = h.seq;
+            log->head_phys = i;
+            log->head_erases = h.erase_count;
+        }
+    }
+    if (log->empty)
+        return ESP_OK;
+
+    // Oldest: walk back while the sequence runs unbroken
+    log->tail_seq = log->head_seq;
+    uint32_t phys = log->head_phys;
+    for (uint32_t n = 1; n < log->sectors && log->tail_seq > 1; n++)
+    {
+        phys = (phys + log->sectors - 1) % log->sectors;
+        if (!vlog_read_sector_hdr(log, phys, &h) || h.seq != log->tail_seq - 1)
+            break;
+        log->tail_seq--;
+    }
+
+    // First free slot in the newest sector; a slot torn before its header
+    // made it is not blank and gets skipped
+    uint32_t base = log->head_phys * VLOG_SECTOR_SIZE;
+    log->head_slot = VLOG_SLOTS;
+    for (uint32_t slot = 1; slot < VLOG_SLOTS; slot++)
+    {
+        vlog_block_hdr_t b;
+        log->stats.mount_reads++;
+        esp_err_t err = vlog_read(log, base + slot * VLOG_BLOCK_SIZE, &b, sizeof(b));
+        if (err != ESP_OK)
+            return err;
+        if (!vlog_blank((const uint8_t *)&b, sizeof(b)))
+            continue;
+
+        log->stats.mount_reads++;
+        err = vlog_read(log, base + slot * VLOG_BLOCK_SIZE, log->page, VLOG_BLOCK_SIZE);
+        if (err != ESP_OK)
+            return err;
+        if (vlog_blank(log->page, VLOG_BLOCK_SIZE))
+        {
+            log->head_slot = slot;
+            break;
+        }
+        log->stats.bad_blocks++;
+    }
+    log->stats.max_erase_count = log->head_erases;
+    return ESP_OK;
+}
+
+esp_err_t vlog_format(vlog_t *log)
+{
+    for (uint32_t i = 0; i < log->sectors; i++)
+    {
+        esp_err_t err = log->flash.erase(log->flash.ctx, i * VLOG_SECTOR_SIZE);
+        if (err != ESP_OK)
+            return err;
+        log->stats.sectors_erased++;
+    }
+    vlog_reset(log);
+    return ESP_OK;
+}
+
+// Moves the head to the next sector, dropping the oldest one if the ring is full
+static esp_err_t vlog_open_sector(vlog_t *log)
+{
+    uint32_t next = (log->head_phys + 1) % log->sectors;
+    uint32_t seq = log->head_seq + 1;
+
+    vlog_sector_hdr_t h;
+    uint32_t erases = vlog_read_sector_hdr(log, next, &h) ? h.erase_count + 1 : 1;
+    if (!log->empty && seq - log->tail_seq >= log->sectors)
+    {
+        log->tail_seq++;
+        log->stats.sectors_dropped++;
+    }
+
+    esp_err_t err = log->flash.erase(log->flash.ctx, next * VLOG_SECTOR_SIZE);
+    if (err != ESP_OK)
+        return err;
+    log->stats.sectors_erased++;
+
+    h = (vlog_sector_hdr_t){.magic = VLOG_MAGIC, .seq = seq, .erase_count = erases};
+    h.crc = vlog_crc32((const uint8_t *)&h, offsetof(vlog_sector_hdr_t, crc));
+    err = log->flash.write(log->flash.ctx, next * VLOG_SECTOR_SIZE, &h, sizeof(h));
+    if (err != ESP_OK)
+        return err;
+
+    if (log->empty)
+        log->tail_seq = seq;
+    log->empty = false;
+    log->head_seq = seq;
+    log->head_phys = next;
+    log->head_slot = 1;
+    log->head_erases = erases;
+    if (erases > log->stats.max_erase_count)
+        log->stats.max_erase_count = erases;
+    return ESP_OK;
+}
+
+esp_err_t vlog_flush(vlog_t *log)
+{
+    if (log->page_len == 0)
+        return ESP_OK;
+
+    if (log->head_slot >= VLOG_SLOTS)
+    {
+        esp_err_t err = vlog_open_sector(log);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    // Header and payload go down in one write
+    vlog_block_hdr_t h = {
+        .len = log->page_len,
+        .len_inv = (uint16_t)~log->page_len,
+        .crc = vlog_crc32(log->page + VLOG_BLOCK_HDR, log->page_len),
+    };
+    memcpy(log->page, &h, sizeof(h));
+    uint32_t addr = log->head_phys * VLOG_SECTOR_SIZE + log->head_slot * VLOG_BLOCK_SIZE;
+    esp_err_t err = log->flash.write(log->flash.ctx, addr, log->page, VLOG_BLOCK_HDR + log->page_len);
+
+    // A failed write may have left the slot dirty; never reuse it
+    log->head_slot++;
+    log->page_len = 0;
+    if (err == ESP_OK)
+        log->stats.blocks_written++;
+    return err;
+}
+
+esp_err_t vlog_append(vlog_t *log, const void *rec, size_t len)
+{
+    if (len == 0 || len > VLOG_MAX_RECORD)
+        return ESP_ERR_INVALID_SIZE;
+
+    if (log->page_len + 1 + len > VLOG_PAYLOAD)
+    {
+        esp_err_t err = vlog_flush(log);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    uint8_t *p = log->page + VLOG_BLOCK_HDR + log->page_len;
+    p[0] = (uint8_t)len;
+    memcpy(p + 1, rec, len);
+    log->page_len += 1 + len;
+    log->stats.records++;
+    return ESP_OK;
+}
+
+static uint32_t vlog_end_block(const vlog_t *log)
+{
+    return vlog_block_id(log->head_seq, log->head_slot);
+}
+
+void vlog_cursor_oldest(const vlog_t *log, vlog_cursor_t *c)
+{
+    c->block = log->empty ? vlog_end_block(log) : vlog_block_id(log->tail_seq, 1);
+    c->off = 0;
+    c->len = 0;
+    c->cached = UINT32_MAX;
+}
+
+void vlog_cursor_newest(const vlog_t *log, vlog_cursor_t *c)
+{
+    c->block = vlog_end_block(log);
+    c->off = 0;
+    c->len = 0;
+    c->cached = UINT32_MAX;
+}
+
+// Loads c->block into the cursor; false if it holds nothing readable
+static bool vlog_load(vlog_t *log, vlog_cursor_t *c)
+{
+    uint32_t seq = c->block / VLOG_DATA_SLOTS;
+    uint32_t slot = c->block % VLOG_DATA_SLOTS + 1;
+    uint32_t addr = vlog_phys(log, seq) * VLOG_SECTOR_SIZE + slot * VLOG_BLOCK_SIZE;
+
+    c->cached = c->block;
+    c->off = 0;
+    c->len = 0;
+
+    vlog_block_hdr_t h;
+    if (vlog_read(log, addr, &h, sizeof(h)) != ESP_OK)
+        return false;
+    if (h.len == 0 || h.len > VLOG_PAYLOAD || (uint16_t)(h.len ^ h.len_inv) != 0xFFFF ||
+        vlog_read(log, addr + VLOG_BLOCK_HDR, c->buf, h.len) != ESP_OK || vlog_crc32(c->buf, h.len) != h.crc)
+    {
+        // Torn, or a dirty slot skipped by the writer
+        log->stats.bad_blocks++;
+        return false;
+    }
+    c->len = h.len;
+    return true;
+}
+
+int vlog_next(vlog_t *log, vlog_cursor_t *c, void *rec, size_t max)
+{
+    while (1)
+    {
+        if (c->cached == c->block && c->off < c->len)
+        {
+            uint8_t n = c->buf[c->off];
+            if (n == 0 || c->off + 1 + n > c->len)
+            {
+                log->stats.bad_blocks++;
+                c->off = c->len;
+                continue;
+            }
+            const uint8_t *p = c->buf + c->off + 1;
+            c->off += 1 + n;
+            if (n > max)
+                continue;
+            memcpy(rec, p, n);
+            return n;
+        }
+        if (c->cached == c->block)
+            c->block++;
+
+        if (log->empty || c->block >= vlog_end_block(log))
+            return 0;
+        // Sectors erased under the reader
+        uint32_t first = vlog_block_id(log->tail_seq, 1);
+        if (c->block < first)
+            c->block = first;
+        vlog_load(log, c);
+    }
+}
+
+void vlog_get_stats(const vlog_t *log, vlog_stats_t *out)
+{
+    *out = log->stats;
+    out->sectors = log->sectors;
+    out->sectors_used = log->empty ? 0 : log->head_seq - log->tail_seq + 1;
+}
@@ -0,0 +1,249 @@
+#include "vitals_logger.h"
+#include "vitals_store.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "VITALS_LOG";
+
+static vlog_t s_log;
+static SemaphoreHandle_t s_mutex = NULL;
+static TaskHandle_t s_task = NULL;
+static vitals_logger_stats_t s_stats; // guarded by s_mutex
+
+// Next store sequence number to log, per metric
+static uint32_t s_next_hr, s_next_spo2, s_next_temp, s_next_gps;
+
+typedef uint8_t (*vitals_encode_t)(const vitals_store_t *v, uint32_t slot, uint8_t *out);
+
+static esp_err_t vitals_part_read(void *ctx, uint32_t addr, void *buf, size_t len)
+{
+    return esp_partition_read(ctx, addr, buf, len);
+}
+
+static esp_err_t vitals_part_write(void *ctx, uint32_t addr, const void *buf, size_t len)
+{
+    return esp_partition_write(ctx, addr, buf, len);
+}
+
+static esp_err_t vitals_part_erase(void *ctx, uint32_t addr)
+{
+    return esp_partition_erase_range(ctx, addr, VLOG_SECTOR_SIZE);
+}
+
+static void put16(uint8_t *p, int16_t v)
+{
+    p[0] = (uint16_t)v & 0xFF;
+    p[1] = (uint16_t)v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static uint8_t encode_hr(const vitals_store_t *v, uint32_t slot, uint8_t *out)
+{
+    out[0] = v->hr.bpm[slot];
+    out[1] = v->hr.sqi[slot];
+    return 2;
+}
+
+static uint8_t encode_spo2(const vitals_store_t *v, uint32_t slot, uint8_t *out)
+{
+    out[0] = v->spo2.percent[slot];
+    out[1] = v->spo2.confidence[slot];
+    return 2;
+}
+
+static uint8_t encode_temp(const vitals_store_t *v, uint32_t slot, uint8_t *out)
+{
+    put16(out, v->temp.object_cc[slot]);
+    put16(out + 2, v->temp.ambient_cc[slot]);
+    return 4;
+}
+
+static uint8_t encode_gps(const vitals_store_t *v, uint32_t slot, uint8_t *out)
+{
+    put32(out, (uint32_t)v->gps.lat_e7[slot]);
+    put32(out + 4, (uint32_t)v->gps.lon_e7[slot]);
+    return 8;
+}
+
+static void vitals_logger_append(const uint8_t *rec, size_t len)
+{
+    if (vlog_append(&s_log, rec, len) == ESP_OK)
+        s_stats.samples_logged++;
+    else
+        s_stats.write_errors++;
+}
+
+// Copies new samples of one metric into the log. Call with s_mutex held.
+static void vitals_logger_drain(const vitals_ring_t *r, const uint32_t *ts_ms, uint8_t kind,
+                                vitals_encode_t encode, uint32_t *next)
+{
+    const vitals_store_t *v = vitals_store();
+    uint8_t recs[VITALS_LOG_BATCH][VITALS_REC_MAX];
+    uint8_t lens[VITALS_LOG_BATCH];
+
+    while (1)
+    {
+        vitals_snap_t snap;
+        vitals_snapshot(r, *next, &snap);
+        uint32_t n = snap.end - snap.first;
+        if (n == 0)
+            break;
+        if (n > VITALS_LOG_BATCH)
+        {
+            n = VITALS_LOG_BATCH;
+            snap.end = snap.first + n;
+        }
+
+        uint32_t first = snap.first;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint32_t slot = vitals_slot(r, first + i);
+            recs[i][0] = kind;
+            put32(recs[i] + 1, ts_ms[slot]);
+            lens[i] = VITALS_REC_HDR + encode(v, slot, recs[i] + VITALS_REC_HDR);
+        }
+
+        // Anything the writer lapped meanwhile is dropped, never logged torn
+        vitals_validate(r, &snap);
+        s_stats.samples_missed += snap.first - *next;
+        for (uint32_t i = snap.first - first; i < n; i++)
+            vitals_logger_append(recs[i], lens[i]);
+        *next = snap.end;
+    }
+}
+
+static void vitals_logger_task(void *arg)
+{
+    const vitals_store_t *v = vitals_store();
+    int64_t last_flush = esp_timer_get_time();
+
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(VITALS_LOG_PERIOD_MS));
+
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        vitals_logger_drain(&v->hr.ring, v->hr.ts_ms, VITALS_REC_HR, encode_hr, &s_next_hr);
+        vitals_logger_drain(&v->spo2.ring, v->spo2.ts_ms, VITALS_REC_SPO2, encode_spo2, &s_next_spo2);
+        vitals_logger_drain(&v->temp.ring, v->temp.ts_ms, VITALS_REC_TEMP, encode_temp, &s_next_temp);
+        vitals_logger_drain(&v->gps.ring, v->gps.ts_ms, VITALS_REC_GPS, encode_gps, &s_next_gps);
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_flush >= VITALS_LOG_FLUSH_MS * 1000LL)
+        {
+            if (vlog_flush(&s_log) != ESP_OK)
+                s_stats.write_errors++;
+            last_flush = now;
+        }
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+esp_err_t vitals_logger_init(void)
+{
+    if (s_task)
+        return ESP_OK;
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, VITALS_LOG_SUBTYPE, VITALS_LOG_LABEL);
+    if (!part)
+    {
+        ESP_LOGE(TAG, "No \"%s\" partition", VITALS_LOG_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const vlog_flash_t flash = {
+        .ctx = (void *)part,
+        .size = part->size - part->size % VLOG_SECTOR_SIZE,
+        .read = vitals_part_read,
+        .write = vitals_part_write,
+        .erase = vitals_part_erase,
+    };
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = vlog_mount(&s_log, &flash);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Mount failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    vlog_stats_t st;
+    vlog_get_stats(&s_log, &st);
+    ESP_LOGI(TAG, "Mounted in %lld us: %lu of %lu sectors in use, %lu bad blocks",
+             (long long)(esp_timer_get_time() - start), (unsigned long)st.sectors_used, (unsigned long)st.sectors,
+             (unsigned long)st.bad_blocks);
+
+    uint8_t boot[VITALS_REC_HDR + 1] = {VITALS_REC_BOOT};
+    put32(boot + 1, (uint32_t)(esp_timer_get_time() / 1000));
+    boot[VITALS_REC_HDR] = (uint8_t)esp_reset_reason();
+    vlog_append(&s_log, boot, sizeof(boot));
+
+    s_mutex = xSemaphoreCreateMutex();
+    if (!s_mutex)
+        return ESP_ERR_NO_MEM;
+    if (xTaskCreate(vitals_logger_task, "vitals_log", VITALS_LOG_TASK_STACK, NULL, VITALS_LOG_TASK_PRIO, &s_task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create logger task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t vitals_logger_flush(void)
+{
+    if (!s_mutex)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    esp_err_t err = vlog_flush(&s_log);
+    xSemaphoreGive(s_mutex);
+    return err;
+}
+
+void vitals_logger_get_stats(vitals_logger_stats_t *out)
+{
+    if (!s_mutex)
+    {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *out = s_stats;
+    vlog_get_stats(&s_log, &out->log);
+    xSemaphoreGive(s_mutex);
+}
+
+void vitals_logger_cursor_oldest(vlog_cursor_t *c)
+{
+    if (!s_mutex)
+    {
+        memset(c, 0, sizeof(*c));
+        return;
+    }
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    vlog_cursor_oldest(&s_log, c);
+    xSemaphoreGive(s_mutex);
+}
+
+int vitals_logger_next(vlog_cursor_t *c, void *rec, size_t max)
+{
+    if (!s_mutex)
+        return 0;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    int n = vlog_next(&s_log, c, rec, max);
+    xSemaphoreGive(s_mutex);
+    return n;
+}
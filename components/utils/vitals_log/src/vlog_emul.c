@@ -0,0 +1,75 @@
+#include "vitals_log.h"
+#include <string.h>
+
+static esp_err_t vlog_emul_read(void *ctx, uint32_t addr, void *buf, size_t len)
+{
+    vlog_emul_t *e = ctx;
+    if (e->failed)
+        return ESP_FAIL;
+    if (addr > e->size || len > e->size - addr)
+        return ESP_ERR_INVALID_ARG;
+    memcpy(buf, e->mem + addr, len);
+    e->reads++;
+    e->bytes_read += len;
+    return ESP_OK;
+}
+
+static esp_err_t vlog_emul_write(void *ctx, uint32_t addr, const void *buf, size_t len)
+{
+    vlog_emul_t *e = ctx;
+    if (e->failed)
+        return ESP_FAIL;
+    if (addr > e->size || len > e->size - addr)
+        return ESP_ERR_INVALID_ARG;
+
+    size_t n = len;
+    if (e->fail_after && e->fail_after < len)
+        n = e->fail_after;
+
+    // NOR programming only clears bits
+    const uint8_t *src = buf;
+    for (size_t i = 0; i < n; i++)
+        e->mem[addr + i] &= src[i];
+    e->writes++;
+    e->bytes_written += n;
+
+    if (e->fail_after)
+    {
+        e->fail_after -= n;
+        if (e->fail_after == 0)
+        {
+            e->failed = true;
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t vlog_emul_erase(void *ctx, uint32_t addr)
+{
+    vlog_emul_t *e = ctx;
+    if (e->failed)
+        return ESP_FAIL;
+    if (addr % VLOG_SECTOR_SIZE || addr >= e->size)
+        return ESP_ERR_INVALID_ARG;
+    memset(e->mem + addr, 0xFF, VLOG_SECTOR_SIZE);
+    if (e->erase_counts)
+        e->erase_counts[addr / VLOG_SECTOR_SIZE]++;
+    e->erases++;
+    return ESP_OK;
+}
+
+void vlog_emul_init(vlog_emul_t *e, uint8_t *mem, uint32_t size, uint32_t *erase_counts, vlog_flash_t *out)
+{
+    memset(e, 0, sizeof(*e));
+    e->mem = mem;
+    e->size = size;
+    e->erase_counts = erase_counts;
+    *out = (vlog_flash_t){
+        .ctx = e,
+        .size = size,
+        .read = vlog_emul_read,
+        .write = vlog_emul_write,
+        .erase = vlog_emul_erase,
+    };
+}
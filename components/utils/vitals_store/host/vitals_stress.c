@@ -0,0 +1,161 @@
+// Host stress test of the vitals_store ring: one writer thread and three
+// lock-free readers on the HR ring of a private store.
+//
+//     vitals_stress [--writes N]    (default 20000000)
+//
+// The writer stores sample n as ts_ms n, bpm n * 7 and sqi n * 13 (both
+// truncated to a byte) and checks that vitals_add_hr() returns n. Readers
+// follow the vitals_store.h protocol: snapshot, read the columns in place,
+// validate, and keep only what survived. Reader 0 tails the ring from where
+// it stopped, like vitals_logger; readers 1 and 2 read the whole window each
+// time, so they sit on the slot the writer is about to overwrite.
+//
+// Every kept sample must match its sequence number and a tailing reader
+// must never see the head go backwards. Samples dropped by validate are
+// counted, and so are those among them that really were torn, which shows
+// the run raced at all. The column reads race with the writer by design,
+// so ThreadSanitizer will report them. Exits non-zero on any bad sample.
+#include "vitals_store.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define READERS 3
+
+typedef struct {
+    int id;
+    uint64_t passes;
+    uint64_t kept;
+    uint64_t dropped; // trimmed by vitals_validate()
+    uint64_t torn;    // of those, read with mixed or foreign data
+    uint64_t bad;     // kept but wrong
+    uint64_t gaps;    // tailing reader: samples overwritten before it got there
+} reader_t;
+
+static vitals_store_t s_store;
+static uint32_t s_writes = 20000000;
+static _Atomic int s_done;
+static uint64_t s_bad_seq;
+
+static bool sample_ok(uint32_t seq, uint32_t ts, uint8_t bpm, uint8_t sqi)
+{
+    return ts == seq && bpm == (uint8_t)(seq * 7) && sqi == (uint8_t)(seq * 13);
+}
+
+static void *writer(void *arg)
+{
+    (void)arg;
+    for (uint32_t n = 0; n < s_writes; n++)
+    {
+        if (vitals_add_hr(&s_store, (int64_t)n * 1000, (uint8_t)(n * 7), (uint8_t)(n * 13)) != n)
+            s_bad_seq++;
+    }
+    atomic_store(&s_done, 1);
+    return NULL;
+}
+
+static void *reader(void *arg)
+{
+    reader_t *r = arg;
+    const vitals_hr_t *hr = &s_store.hr;
+    static _Thread_local uint32_t ts[VITALS_HR_CAP];
+    static _Thread_local uint8_t bpm[VITALS_HR_CAP], sqi[VITALS_HR_CAP];
+    uint32_t from = 0, last_end = 0;
+
+    while (!atomic_load(&s_done))
+    {
+        vitals_snap_t snap;
+        vitals_snapshot(&hr->ring, r->id == 0 ? from : 0, &snap);
+        if (r->id == 0)
+        {
+            if (snap.end < last_end)
+                r->bad++;
+            r->gaps += snap.first - from;
+        }
+        last_end = snap.end;
+
+        uint32_t first = snap.first, count = snap.end - snap.first;
+        for (uint32_t k = 0; k < count; k++)
+        {
+            uint32_t i = vitals_slot(&hr->ring, first + k);
+            ts[k] = hr->ts_ms[i];
+            bpm[k] = hr->bpm[i];
+            sqi[k] = hr->sqi[i];
+        }
+        vitals_validate(&hr->ring, &snap);
+
+        for (uint32_t k = 0; k < count; k++)
+        {
+            uint32_t seq = first + k;
+            bool ok = sample_ok(seq, ts[k], bpm[k], sqi[k]);
+            if (seq < snap.first)
+            {
+                r->dropped++;
+                r->torn += !ok;
+            }
+            else
+            {
+                r->kept++;
+                if (!ok && r->bad++ < 5)
+                    printf("reader %d: seq %lu read as ts %lu bpm %u sqi %u\n", r->id, (unsigned long)seq,
+                           (unsigned long)ts[k], bpm[k], sqi[k]);
+            }
+        }
+        from = snap.end;
+        r->passes++;
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--writes") && i + 1 < argc)
+            s_writes = (uint32_t)strtoul(argv[++i], NULL, 0);
+    }
+
+    vitals_store_init(&s_store);
+    pthread_t w, rd[READERS];
+    reader_t readers[READERS] = {0};
+    struct timespec t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int k = 0; k < READERS; k++)
+    {
+        readers[k].id = k;
+        pthread_create(&rd[k], NULL, reader, &readers[k]);
+    }
+    pthread_create(&w, NULL, writer, NULL);
+    pthread_join(w, NULL);
+    for (int k = 0; k < READERS; k++)
+        pthread_join(rd[k], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    uint64_t bad = s_bad_seq, passes = 0;
+    printf("%lu writes in %.2f s (%.1f ns/write with %d readers)\n", (unsigned long)s_writes, secs,
+           secs * 1e9 / s_writes, READERS);
+    for (int k = 0; k < READERS; k++)
+    {
+        const reader_t *r = &readers[k];
+        printf("reader %d (%s): %lu passes, %lu kept, %lu dropped by validate (%lu torn), %lu bad", k,
+               k == 0 ? "tail" : "window", (unsigned long)r->passes, (unsigned long)r->kept, (unsigned long)r->dropped,
+               (unsigned long)r->torn, (unsigned long)r->bad);
+        if (k == 0)
+            printf(", %lu overrun", (unsigned long)r->gaps);
+        printf("\n");
+        bad += r->bad;
+        passes += r->passes;
+    }
+    if (s_bad_seq)
+        printf("vitals_add_hr returned the wrong sequence number %lu times\n", (unsigned long)s_bad_seq);
+
+    vitals_snap_t snap;
+    vitals_snapshot(&s_store.hr.ring, 0, &snap);
+    bool ok = bad == 0 && passes > 0 && snap.end == s_writes;
+    printf("vitals_stress: %s\n", ok ? "ok" : "FAIL");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
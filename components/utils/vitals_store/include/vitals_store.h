@@ -0,0 +1,92 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Recent history of every vital: one fixed ring per metric, stored as
+// columns (struct of arrays). Sample n of a metric has sequence number n and
+// sits in slot n & mask of each of its columns.
+//
+// Each metric has a single writer, the task that measures it. Readers take
+// no lock and copy nothing: vitals_snapshot() returns the range of sequence
+// numbers to read straight from the columns, and vitals_validate() afterwards
+// trims off whatever the writer overwrote in the meantime. Anything read
+// from a trimmed slot must be discarded. No ESP-IDF dependencies.
+
+#define VITALS_HR_CAP   512 // ~8 min of beats
+#define VITALS_SPO2_CAP 512
+#define VITALS_TEMP_CAP 256 // ~25 s of a 10 Hz scan
+#define VITALS_GPS_CAP  256 // ~4 min at the 1 Hz the GPS task records
+
+typedef struct {
+    _Atomic uint32_t head;    // samples published; sequence number of the next
+    _Atomic uint32_t claimed; // head + 1 while that sample is being written
+    uint32_t mask;            // capacity - 1, capacity a power of two
+} vitals_ring_t;
+
+// Timestamps are esp_timer milliseconds and wrap after 49 days; compare them
+// by difference
+typedef struct {
+    vitals_ring_t ring;
+    uint32_t ts_ms[VITALS_HR_CAP];
+    uint8_t bpm[VITALS_HR_CAP];
+    uint8_t sqi[VITALS_HR_CAP];
+} vitals_hr_t;
+
+typedef struct {
+    vitals_ring_t ring;
+    uint32_t ts_ms[VITALS_SPO2_CAP];
+    uint8_t percent[VITALS_SPO2_CAP];
+    uint8_t confidence[VITALS_SPO2_CAP];
+} vitals_spo2_t;
+
+typedef struct {
+    vitals_ring_t ring;
+    uint32_t ts_ms[VITALS_TEMP_CAP];
+    int16_t object_cc[VITALS_TEMP_CAP]; // centi-degrees C
+    int16_t ambient_cc[VITALS_TEMP_CAP];
+} vitals_temp_t;
+
+typedef struct {
+    vitals_ring_t ring;
+    uint32_t ts_ms[VITALS_GPS_CAP];
+    int32_t lat_e7[VITALS_GPS_CAP];
+    int32_t lon_e7[VITALS_GPS_CAP];
+} vitals_gps_t;
+
+typedef struct {
+    vitals_hr_t hr;
+    vitals_spo2_t spo2;
+    vitals_temp_t temp;
+    vitals_gps_t gps;
+} vitals_store_t;
+
+// Sequence numbers [first, end)
+typedef struct {
+    uint32_t first;
+    uint32_t end;
+} vitals_snap_t;
+
+// The device-wide store, ready to use without init
+vitals_store_t *vitals_store(void);
+
+// Empties s; only for stores other than vitals_store(), before any reader
+void vitals_store_init(vitals_store_t *s);
+
+// Each returns the sequence number of the sample it stored
+uint32_t vitals_add_hr(vitals_store_t *s, int64_t timestamp_us, uint8_t bpm, uint8_t sqi);
+uint32_t vitals_add_spo2(vitals_store_t *s, int64_t timestamp_us, uint8_t percent, uint8_t confidence);
+uint32_t vitals_add_temp(vitals_store_t *s, int64_t timestamp_us, float object_c, float ambient_c);
+uint32_t vitals_add_gps(vitals_store_t *s, int64_t timestamp_us, int32_t lat_e7, int32_t lon_e7);
+
+// Samples from sequence number from onwards that are still held
+void vitals_snapshot(const vitals_ring_t *r, uint32_t from, vitals_snap_t *snap);
+
+// Call after reading the columns; drops the overwritten front of snap and
+// returns how many samples are left
+uint32_t vitals_validate(const vitals_ring_t *r, vitals_snap_t *snap);
+
+static inline uint32_t vitals_slot(const vitals_ring_t *r, uint32_t seq)
+{
+    return seq & r->mask;
+}
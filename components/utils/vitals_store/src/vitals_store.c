@@ -0,0 +1,121 @@
+#include "vitals_store.h"
+#include <string.h>
+
+#define VITALS_RING(cap) {.mask = (cap) - 1}
+
+_Static_assert((VITALS_HR_CAP & (VITALS_HR_CAP - 1)) == 0, "VITALS_HR_CAP must be a power of two");
+_Static_assert((VITALS_SPO2_CAP & (VITALS_SPO2_CAP - 1)) == 0, "VITALS_SPO2_CAP must be a power of two");
+_Static_assert((VITALS_TEMP_CAP & (VITALS_TEMP_CAP - 1)) == 0, "VITALS_TEMP_CAP must be a power of two");
+_Static_assert((VITALS_GPS_CAP & (VITALS_GPS_CAP - 1)) == 0, "VITALS_GPS_CAP must be a power of two");
+
+static vitals_store_t s_store = {
+    .hr.ring = VITALS_RING(VITALS_HR_CAP),
+    .spo2.ring = VITALS_RING(VITALS_SPO2_CAP),
+    .temp.ring = VITALS_RING(VITALS_TEMP_CAP),
+    .gps.ring = VITALS_RING(VITALS_GPS_CAP),
+};
+
+vitals_store_t *vitals_store(void)
+{
+    return &s_store;
+}
+
+void vitals_store_init(vitals_store_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->hr.ring.mask = VITALS_HR_CAP - 1;
+    s->spo2.ring.mask = VITALS_SPO2_CAP - 1;
+    s->temp.ring.mask = VITALS_TEMP_CAP - 1;
+    s->gps.ring.mask = VITALS_GPS_CAP - 1;
+}
+
+// Claims the next slot and returns its sequence number. The claim is ordered
+// before the column stores, so a reader that sees any of them also sees the
+// claim when it validates.
+static uint32_t vitals_begin(vitals_ring_t *r)
+{
+    uint32_t seq = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->claimed, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return seq;
+}
+
+static void vitals_publish(vitals_ring_t *r)
+{
+    uint32_t seq = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, seq + 1, memory_order_release);
+}
+
+static int16_t vitals_cc(float c)
+{
+    float v = c * 100.0f;
+    if (v > INT16_MAX)
+        return INT16_MAX;
+    if (v < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+uint32_t vitals_add_hr(vitals_store_t *s, int64_t timestamp_us, uint8_t bpm, uint8_t sqi)
+{
+    uint32_t seq = vitals_begin(&s->hr.ring);
+    uint32_t i = vitals_slot(&s->hr.ring, seq);
+    s->hr.ts_ms[i] = (uint32_t)(timestamp_us / 1000);
+    s->hr.bpm[i] = bpm;
+    s->hr.sqi[i] = sqi;
+    vitals_publish(&s->hr.ring);
+    return seq;
+}
+
+uint32_t vitals_add_spo2(vitals_store_t *s, int64_t timestamp_us, uint8_t percent, uint8_t confidence)
+{
+    uint32_t seq = vitals_begin(&s->spo2.ring);
+    uint32_t i = vitals_slot(&s->spo2.ring, seq);
+    s->spo2.ts_ms[i] = (uint32_t)(timestamp_us / 1000);
+    s->spo2.percent[i] = percent;
+    s->spo2.confidence[i] = confidence;
+    vitals_publish(&s->spo2.ring);
+    return seq;
+}
+
+uint32_t vitals_add_temp(vitals_store_t *s, int64_t timestamp_us, float object_c, float ambient_c)
+{
+    uint32_t seq = vitals_begin(&s->temp.ring);
+    uint32_t i = vitals_slot(&s->temp.ring, seq);
+    s->temp.ts_ms[i] = (uint32_t)(timestamp_us / 1000);
+    s->temp.object_cc[i] = vitals_cc(object_c);
+    s->temp.ambient_cc[i] = vitals_cc(ambient_c);
+    vitals_publish(&s->temp.ring);
+    return seq;
+}
+
+uint32_t vitals_add_gps(vitals_store_t *s, int64_t timestamp_us, int32_t lat_e7, int32_t lon_e7)
+{
+    uint32_t seq = vitals_begin(&s->gps.ring);
+    uint32_t i = vitals_slot(&s->gps.ring, seq);
+    s->gps.ts_ms[i] = (uint32_t)(timestamp_us / 1000);
+    s->gps.lat_e7[i] = lat_e7;
+    s->gps.lon_e7[i] = lon_e7;
+    vitals_publish(&s->gps.ring);
+    return seq;
+}
+
+void vitals_snapshot(const vitals_ring_t *r, uint32_t from, vitals_snap_t *snap)
+{
+    uint32_t end = atomic_load_explicit(&r->head, memory_order_acquire);
+    // The oldest slot may already be under the writer
+    uint32_t oldest = end > r->mask ? end - r->mask : 0;
+    snap->end = end;
+    snap->first = from < oldest ? oldest : (from > end ? end : from);
+}
+
+uint32_t vitals_validate(const vitals_ring_t *r, vitals_snap_t *snap)
+{
+    atomic_thread_fence(memory_order_acquire);
+    // Writing sequence n overwrites n - capacity; claimed is n + 1
+    uint32_t claimed = atomic_load_explicit(&r->claimed, memory_order_relaxed);
+    uint32_t intact = claimed > r->mask ? claimed - r->mask - 1 : 0;
+    if (snap->first < intact)
+        snap->first = intact < snap->end ? intact : snap->end;
+    return snap->end - snap->first;
+}
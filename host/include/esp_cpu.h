@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// Host stand-in: counts nanoseconds, so "cycles" read as ns on the host
+uint32_t esp_cpu_get_cycle_count(void);
@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+
+// Host stand-in: CLOCK_MONOTONIC in microseconds
+int64_t esp_timer_get_time(void);
+
+// Host only: moves esp_timer time forward, so a harness can run
+// period-gated code without waiting out the periods
+void esp_host_skip_time(int64_t us);
@@ -0,0 +1,14 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+// Host stand-in, stubs/freertos_host.c: binary semaphores only, and a take
+// that would block fails instead
+typedef struct {
+    bool given;
+} StaticSemaphore_t;
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buf);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait);
+void vSemaphoreDelete(SemaphoreHandle_t s);
@@ -0,0 +1,16 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// stubs/freertos_host.c: a created task runs on the caller's stack when it
+// is notified, until it waits with nothing pending
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+
+// Host only: while held, notifications are counted but no task runs;
+// releasing runs every task that has one pending
+void esp_host_hold_tasks(bool hold);
@@ -0,0 +1,156 @@
+// Host stand-ins for the FreeRTOS calls i2c_common makes. There is one
+// thread: a created task runs on the notifier's stack when it is notified,
+// and leaves through longjmp() when it waits with nothing pending. That
+// suits tasks whose loop keeps no state across the wait, like the I2C bus
+// task. Anything that would block fails at once instead.
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_MAX_TASKS 4
+
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+    uint32_t pending;
+    bool running;
+    jmp_buf wait;
+} host_task_t;
+
+static host_task_t s_tasks[HOST_MAX_TASKS];
+static int s_task_count;
+static host_task_t *s_current; // NULL: the harness itself
+static bool s_hold;
+
+static void host_run(host_task_t *t)
+{
+    if (t->running || t->pending == 0 || s_hold)
+        return;
+    host_task_t *caller = s_current;
+    t->running = true;
+    s_current = t;
+    if (!setjmp(t->wait))
+        t->fn(t->arg);
+    s_current = caller;
+    t->running = false;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)prio;
+    if (s_task_count == HOST_MAX_TASKS)
+        return pdFALSE;
+    host_task_t *t = &s_tasks[s_task_count++];
+    t->fn = fn;
+    t->arg = arg;
+    if (out)
+        *out = t;
+    return pdPASS;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    host_task_t *t = task;
+    if (t == NULL)
+        return;
+    t->pending++;
+    host_run(t);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    (void)wait;
+    host_task_t *t = s_current;
+    if (t == NULL)
+        return 0;
+    if (t->pending == 0)
+        longjmp(t->wait, 1);
+    uint32_t n = t->pending;
+    t->pending = clear ? 0 : n - 1;
+    return n;
+}
+
+void esp_host_hold_tasks(bool hold)
+{
+    s_hold = hold;
+    for (int i = 0; !hold && i < s_task_count; i++)
+        host_run(&s_tasks[i]);
+}
+
+struct host_queue {
+    uint8_t *items;
+    UBaseType_t length, item_size;
+    UBaseType_t head, count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (q && !(q->items = malloc((size_t)length * item_size)))
+    {
+        free(q);
+        return NULL;
+    }
+    if (q)
+    {
+        q->length = length;
+        q->item_size = item_size;
+    }
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait)
+{
+    (void)wait;
+    if (q->count == q->length)
+        return pdFALSE;
+    memcpy(q->items + (size_t)((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+    q->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait)
+{
+    (void)wait;
+    if (q->count == 0)
+        return pdFALSE;
+    memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buf)
+{
+    buf->given = false;
+    return buf;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+    if (s->given)
+        return pdFALSE;
+    s->given = true;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait)
+{
+    (void)wait;
+    if (!s->given)
+        return pdFALSE;
+    s->given = false;
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+    (void)s;
+}
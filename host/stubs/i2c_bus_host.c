@@ -0,0 +1,141 @@
+// Host model of the legacy I2C master driver: a command link counts the
+// bit times of what it would put on the wire, and i2c_master_cmd_begin()
+// moves esp_timer on by that many SCL periods. Clock stretching, the
+// driver's own overhead and bus arbitration are not modelled.
+#include "driver/i2c.h"
+#include "esp_timer.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t bits;
+    uint8_t addr;  // of the first address byte written
+    bool have_addr;
+    bool expect_addr; // the next byte written follows a START
+} host_link_t;
+
+_Static_assert(sizeof(host_link_t) <= I2C_LINK_RECOMMENDED_SIZE(0), "I2C_LINK_RECOMMENDED_SIZE too small");
+
+static uint32_t s_clk_hz = 100000;
+static uint8_t s_nack_addr;
+static uint32_t s_nack_every, s_nack_count;
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *conf)
+{
+    (void)port;
+    if (conf->master.clk_speed == 0)
+        return ESP_ERR_INVALID_ARG;
+    s_clk_hz = conf->master.clk_speed;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len,
+                             int intr_alloc_flags)
+{
+    (void)port;
+    (void)mode;
+    (void)slv_rx_buf_len;
+    (void)slv_tx_buf_len;
+    (void)intr_alloc_flags;
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return calloc(1, sizeof(host_link_t));
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size)
+{
+    if (size < sizeof(host_link_t))
+        return NULL;
+    memset(buffer, 0, sizeof(host_link_t));
+    return buffer;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd)
+{
+    free(cmd);
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd)
+{
+    (void)cmd;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+{
+    host_link_t *l = cmd;
+    l->bits += 1;
+    l->expect_addr = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en)
+{
+    (void)ack_en;
+    host_link_t *l = cmd;
+    if (l->expect_addr && !l->have_addr)
+    {
+        l->addr = data >> 1;
+        l->have_addr = true;
+    }
+    l->expect_addr = false;
+    l->bits += 9;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t len, bool ack_en)
+{
+    (void)data;
+    (void)ack_en;
+    ((host_link_t *)cmd)->bits += 9 * (uint32_t)len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack)
+{
+    (void)ack;
+    *data = 0;
+    ((host_link_t *)cmd)->bits += 9;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, i2c_ack_type_t ack)
+{
+    (void)ack;
+    memset(data, 0, len);
+    ((host_link_t *)cmd)->bits += 9 * (uint32_t)len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+{
+    ((host_link_t *)cmd)->bits += 1;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks_to_wait)
+{
+    (void)port;
+    (void)ticks_to_wait;
+    const host_link_t *l = cmd;
+    uint32_t bits = l->bits;
+    esp_err_t ret = ESP_OK;
+
+    // A NACK ends the transfer after the address byte
+    if (s_nack_every && l->have_addr && l->addr == s_nack_addr && ++s_nack_count % s_nack_every == 0)
+    {
+        bits = 1 + 9 + 1;
+        ret = ESP_FAIL;
+    }
+    esp_host_skip_time(((int64_t)bits * 1000000 + s_clk_hz - 1) / s_clk_hz);
+    return ret;
+}
+
+void esp_host_i2c_nack_every(uint8_t addr, uint32_t n)
+{
+    s_nack_addr = addr;
+    s_nack_every = n;
+    s_nack_count = 0;
+}
@@ -0,0 +1,64 @@
+// Host stand-ins for the sensor drivers. Only the replay backend of
+// sensor_hal runs on the host; the hardware table still has to link.
+#include "max30100.h"
+#include "mlx90614.h"
+
+uint32_t max30100_sample_rate_hz(max30100_sampling_rate_t rate)
+{
+    static const uint16_t rates[] = {50, 100, 167, 200, 400, 600, 800, 1000};
+    return rate <= MAX30100_SAMPLING_RATE_1000HZ ? rates[rate] : 100;
+}
+
+uint32_t max30100_adc_full_scale(max30100_pulse_width_t pw)
+{
+    return (1u << (13 + (pw & 0x03))) - 1;
+}
+
+esp_err_t max30100_init(const max30100_config_t *cfg)
+{
+    (void)cfg;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t max30100_start_acquisition(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+size_t max30100_read_samples(max30100_sample_t *out, size_t max)
+{
+    (void)out;
+    (void)max;
+    return 0;
+}
+
+esp_err_t max30100_set_led_current(max30100_current_t red, max30100_current_t ir)
+{
+    (void)red;
+    (void)ir;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t max30100_set_sampling(max30100_sampling_rate_t rate, max30100_pulse_width_t pw)
+{
+    (void)rate;
+    (void)pw;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t max30100_set_power(bool on)
+{
+    (void)on;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mlx90614_init(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t mlx90614_read(mlx90614_reading_t *out)
+{
+    (void)out;
+    return ESP_ERR_NOT_SUPPORTED;
+}
@@ -104,9 +104,8 @@ typedef struct
     lv_obj_t *chart_hr;
     lv_chart_series_t *ser_hr;
     lv_chart_series_t *ser_spo2;
-    int hr_data_points[20]; 
-    int spo2_data_points[20]; 
-    int data_index;
+    uint32_t hr_chart_end;   // vitals store sequence the charts were drawn up to
+    uint32_t spo2_chart_end;
 
     /* Status for wifi and bluetooth*/
     lv_obj_t *lbl_wifi_status;
@@ -175,4 +174,5 @@ void ui_create_status_bar(lv_obj_t *screen, lv_obj_t **time_label, lv_obj_t **ba
 
 void ui_update_all_status_bars(ui_manager_t *ui, const char *time_str, int battery_percent);
 
-void ui_add_hr_data_point(ui_manager_t *ui, int hr);
+// Redraws the HR and SpO2 charts from the vitals store when it has new samples
+void ui_update_vitals_charts(ui_manager_t *ui);
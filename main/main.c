@@ -10,16 +10,19 @@
 #include "gps_tracker.h"
 #include "esp_log.h"
 #include "string.h"
+#include <stdlib.h>
 #include "wifi.h"
 #include "nvs_flash.h"
 #include "http_client.h"
 #include "mqtt.h"
 #include "mqtt_task.h"
 #include "bluetooth.h"
+#include "sensor_sched.h"
+#include "vitals_logger.h"
+#include "sensor_hal.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 
-SemaphoreHandle_t i2c_mutex = NULL;
 SemaphoreHandle_t http_semaphore = NULL;
 QueueHandle_t http_queue = NULL;
 
@@ -34,53 +37,121 @@ static ui_manager_t ui;
 
 float raw_hr, raw_sp;
 
-float temperature_get_data_protected()
+#define SENSOR_CONSUMER_UI   0
+#define SENSOR_CONSUMER_BLE  1
+#define TEMP_JOB_PERIOD_US   100000
+#define TEMP_JOB_DEADLINE_US 50000
+#define HEALTH_JOB_PERIOD_US 100000
+
+static sensor_id_t temp_sensor = -1;
+static sensor_id_t health_sensor = -1;
+
+static void temp_job(void *arg)
 {
-    float temp = 0.0;
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
-    {
-        temp = temperature_get_data();
-        xSemaphoreGive(i2c_mutex);
-        // ESP_LOGI("TEMP", "Protected read: %.2f°C", temp);
-    }
-    else
-    {
-        ESP_LOGW("TEMP", "Failed to acquire I2C mutex for temperature");
-    }
-    return temp;
+    temperature_tick();
 }
 
-bool health_get_data_protected(health_data_t *health_data)
+#ifdef CONFIG_SENSOR_REPLAY_TRACE
+extern const char ppg_sample_csv_start[] asm("_binary_ppg_sample_csv_start");
+extern const char temp_sample_csv_start[] asm("_binary_temp_sample_csv_start");
+
+// PPG trace recorded with the continuous profile's settings
+static void replay_start(void)
 {
-    bool success = false;
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(1000)) == pdTRUE)
-    {
-        health_update();
-        health_get_data(health_data);
-        success = true;
-        xSemaphoreGive(i2c_mutex);
-        // ESP_LOGI("HEALTH", "Protected read: HR=%d, SpO2=%d",
-        //          health_data->heart_rate, health_data->spo2);
-    }
-    else
-    {
-        ESP_LOGW("HEALTH", "Failed to acquire I2C mutex for health");
-    }
-    return success;
+    const sensor_replay_ppg_meta_t meta = {
+        .rate = MAX30100_SAMPLING_RATE_100HZ,
+        .pulse_width = MAX30100_PULSE_WIDTH_1600US_ADC_16,
+        .ir_current = MAX30100_LED_CURRENT_11MA,
+        .red_current = MAX30100_LED_CURRENT_7_6MA,
+    };
+    sensor_replay_set_ppg_csv(ppg_sample_csv_start, &meta);
+    sensor_replay_set_temp_csv(temp_sample_csv_start);
+#ifdef CONFIG_SENSOR_REPLAY_PACE_ASAP
+    sensor_hal_use_replay(SENSOR_REPLAY_ASAP);
+#else
+    sensor_hal_use_replay(SENSOR_REPLAY_REALTIME);
+#endif
+}
+
+static void replay_report(void)
+{
+    static bool reported = false;
+    sensor_replay_stats_t st;
+    sensor_replay_get_stats(&st);
+    if (reported || !st.done || !st.temp_done)
+        return;
+
+    // Both trackers hash into one digest, in task order; the host targets
+    // replay each trace on its own for a reproducible one
+    health_dsp_stats_t dsp;
+    health_get_dsp_stats(&dsp);
+    ESP_LOGI("MAIN", "Replay done: %lu samples, %lu samples/s, %lu cycles/sample, latency %lu/%lu us, "
+             "%lu temperature readings, %lu outputs, digest %08lx",
+             (unsigned long)st.ppg_samples, (unsigned long)st.samples_per_s,
+             (unsigned long)dsp.cycles_per_sample_avg, (unsigned long)st.latency_avg_us,
+             (unsigned long)st.latency_max_us, (unsigned long)st.temp_readings, (unsigned long)st.outputs,
+             (unsigned long)st.output_digest);
+    reported = true;
 }
+#endif
 
+static void health_job(void *arg)
+{
+    health_update();
+#ifdef CONFIG_SENSOR_REPLAY_TRACE
+    replay_report();
+#endif
+}
 
-void temperature_update_protected()
+static void health_power(sensor_power_t state, void *arg)
 {
-    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(500)) == pdTRUE)
-    {
-        temperature_update();
-        xSemaphoreGive(i2c_mutex);
-    }
+    health_set_active(state == SENSOR_POWER_ACTIVE);
+}
+
+static void sensors_register(void)
+{
+    const sensor_sched_desc_t temp_desc = {
+        .name = "temperature",
+        .period_us = TEMP_JOB_PERIOD_US,
+        .deadline_us = TEMP_JOB_DEADLINE_US,
+        .idle_power = SENSOR_POWER_IDLE,
+        .job = temp_job,
+    };
+    const sensor_sched_desc_t health_desc = {
+        .name = "health",
+        .period_us = HEALTH_JOB_PERIOD_US,
+        .idle_power = SENSOR_POWER_IDLE,
+        .job = health_job,
+        .set_power = health_power,
+    };
+
+    esp_err_t err = sensor_sched_init();
+    if (err == ESP_OK)
+        err = sensor_sched_register(&temp_desc, &temp_sensor);
+    if (err == ESP_OK)
+        err = sensor_sched_register(&health_desc, &health_sensor);
+    if (err != ESP_OK)
+        ESP_LOGE("MAIN", "Sensor scheduler init failed: %s", esp_err_to_name(err));
+}
+
+// Screens subscribe to the data they show; the scheduler only runs
+// sensors that have a subscriber
+static void sensors_subscribe_for_state(ui_state_t state)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    if (state == UI_STATE_TEMP_SCANNING)
+        sensor_sched_subscribe(temp_sensor, SENSOR_CONSUMER_UI, self);
     else
-    {
-        ESP_LOGW("TEMP", "Failed to acquire I2C mutex for temperature update");
-    }
+        sensor_sched_unsubscribe(temp_sensor, SENSOR_CONSUMER_UI);
+
+    if (state == UI_STATE_HR)
+        sensor_sched_subscribe(health_sensor, SENSOR_CONSUMER_UI, self);
+    else
+        sensor_sched_unsubscribe(health_sensor, SENSOR_CONSUMER_UI);
+
+    // On-demand checks lock fast; background monitoring saves LED power
+    health_set_profile(state == UI_STATE_HR ? HEALTH_PROFILE_SPOT : HEALTH_PROFILE_CONTINUOUS);
 }
 
 void update_interaction_time()
@@ -140,10 +211,43 @@ static void gui_task(void *pv)
         vTaskDelay(pdMS_TO_TICKS(10));
     }
 }
+
+// One line per I2C device: traffic, errors by kind and latency. A device
+// whose error counts moved since the last call is logged as a warning, so a
+// sensor fault (NACKs, PEC failures) stands apart from bus contention,
+// which shows as queue wait instead.
+static void i2c_log_device(const char *name, uint8_t addr, uint32_t *last_errors)
+{
+    i2c_device_stats_t st;
+    if (i2c_common_get_device_stats(addr, &st) != ESP_OK || st.transfers == 0)
+        return;
+
+    uint32_t errors = st.nacks + st.timeouts + st.pec_errors + st.other_errors + st.queue_full;
+    ESP_LOG_LEVEL(errors != *last_errors ? ESP_LOG_WARN : ESP_LOG_INFO, "SENSOR",
+                  "I2C %s: %lu transfers, %lu NACK, %lu timeout, %lu PEC, %lu other, %lu queue full; "
+                  "wait p50 <%lu us p99 <%lu us, transfer p99 <%lu us, worst recent %lu us",
+                  name, (unsigned long)st.transfers, (unsigned long)st.nacks, (unsigned long)st.timeouts,
+                  (unsigned long)st.pec_errors, (unsigned long)st.other_errors, (unsigned long)st.queue_full,
+                  (unsigned long)i2c_common_hist_quantile_us(st.wait_hist, 500),
+                  (unsigned long)i2c_common_hist_quantile_us(st.wait_hist, 990),
+                  (unsigned long)i2c_common_hist_quantile_us(st.xfer_hist, 990), (unsigned long)st.worst_recent_us);
+    *last_errors = errors;
+}
+
 void sensor_manager_task(void *pv)
 {
     bool loggedResult = false;
     static uint32_t last_http_send = 0;
+    static uint32_t last_ble_send = 0;
+    static uint32_t last_hrv_send = 0;
+    const uint32_t HRV_SEND_INTERVAL = 30000;
+    ui_state_t subscribed_state = -1;
+    bool ble_subscribed = false;
+    bool rhythm_flagged = false;
+    uint32_t i2c_heap_links = 0;
+    static uint32_t last_i2c_diag = 0;
+    static uint32_t i2c_errors[3] = {0};
+    const uint32_t I2C_DIAG_INTERVAL = 60000;
     const uint32_t HTTP_SEND_INTERVAL = 3000;
 
     ESP_LOGI("SENSOR_MANAGER", "Task started with queue-based HTTP system");
@@ -152,17 +256,166 @@ void sensor_manager_task(void *pv)
     {
         uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
 
+        // Every I2C command link should come from the static buffer; one from
+        // the heap means a client chained more than I2C_BUS_MAX_CHAIN
+        uint32_t heap_links = i2c_common_heap_link_count();
+        if (heap_links != i2c_heap_links)
+        {
+            ESP_LOGW("SENSOR", "I2C allocated %lu command links on the heap since boot (chain over %d)",
+                     (unsigned long)heap_links, I2C_BUS_MAX_CHAIN);
+            i2c_heap_links = heap_links;
+        }
+
+        // I2C bus occupancy over its last load window and per-device
+        // telemetry, for field diagnostics
+        if (current_time - last_i2c_diag >= I2C_DIAG_INTERVAL)
+        {
+            i2c_bus_load_t load;
+            i2c_common_get_bus_load(&load);
+            if (load.window_us > 0)
+            {
+                uint32_t permille = (uint32_t)((uint64_t)load.busy_us * 1000 / load.window_us);
+                ESP_LOGI("SENSOR", "I2C bus busy %lu of %lu us (%lu.%lu%%), %lu transfers, %lu clock switches",
+                         (unsigned long)load.busy_us, (unsigned long)load.window_us, (unsigned long)(permille / 10),
+                         (unsigned long)(permille % 10), (unsigned long)load.transfers,
+                         (unsigned long)load.clock_switches);
+            }
+            i2c_log_device("MAX30100", MAX30100_ADDR, &i2c_errors[0]);
+            i2c_log_device("MLX90614", MLX90614_ADDR, &i2c_errors[1]);
+            i2c_log_device("other", I2C_ADDR_UNREGISTERED, &i2c_errors[2]);
+            last_i2c_diag = current_time;
+        }
+
+        if (ui.current_state != subscribed_state)
+        {
+            sensors_subscribe_for_state(ui.current_state);
+            subscribed_state = ui.current_state;
+        }
+
+        // A connected phone keeps HR running behind any screen
+        bool ble = bluetooth_is_connected();
+        if (ble != ble_subscribed)
+        {
+            if (ble)
+                sensor_sched_subscribe(health_sensor, SENSOR_CONSUMER_BLE, NULL);
+            else
+                sensor_sched_unsubscribe(health_sensor, SENSOR_CONSUMER_BLE);
+            ble_subscribed = ble;
+        }
+
+        // Irregular-rhythm events go out once per state change
+        rhythm_result_t rhythm;
+        health_get_rhythm(&rhythm);
+        if (rhythm.flagged != rhythm_flagged)
+        {
+            rhythm_flagged = rhythm.flagged;
+            ESP_LOGW("SENSOR", "Irregular rhythm %s (score %d)", rhythm_flagged ? "detected" : "cleared", rhythm.score);
+
+            if (is_wifi_connected())
+            {
+                http_message_t msg = {
+                    .data_type = 4,
+                    .data.rhythm = {rhythm_flagged, rhythm.score}};
+                if (xQueueSend(http_queue, &msg, 0) != pdTRUE)
+                {
+                    ESP_LOGW("SENSOR", "HTTP queue full, skipping rhythm event");
+                }
+            }
+
+            if (bluetooth_is_connected() && rhythm_flagged)
+            {
+                bluetooth_send_notification("Irregular rhythm",
+                                            "Irregular heart rhythm detected. Consider a medical check.");
+            }
+        }
+
+        if (ble_subscribed && ui.current_state != UI_STATE_HR)
+        {
+            health_data_t hd = {0};
+            health_get_data(&hd);
+            if (hd.valid && hd.heart_rate != raw_hr &&
+                hd.spo2_confidence >= HEALTH_SPO2_MIN_CONFIDENCE && hd.sqi >= HEALTH_SQI_MIN &&
+                (current_time - last_ble_send >= HTTP_SEND_INTERVAL))
+            {
+                bluetooth_notify_heart_rate(hd.heart_rate, hd.spo2, hd.resp_rate);
+                raw_hr = hd.heart_rate;
+                raw_sp = hd.spo2;
+                last_ble_send = current_time;
+            }
+        }
+
+        // Zone transitions: "left safe zone" is what the carer needs to see.
+        // An event stays queued until at least one link has taken it.
+        geofence_event_t fence;
+        uint32_t fence_id;
+        while (gps_peek_geofence_event(&fence, &fence_id))
+        {
+            bool delivered = false;
+            if (bluetooth_is_connected())
+            {
+                char text[48];
+                snprintf(text, sizeof(text), "%s zone %u", fence.inside ? "Entered" : "Left", fence.zone_id);
+                delivered = bluetooth_send_notification("Geofence", text) == ESP_OK;
+            }
+
+            if (is_wifi_connected())
+            {
+                http_message_t msg = {
+                    .data_type = 5,
+                    .data.geofence = {fence.zone_id, fence.inside}};
+                if (xQueueSend(http_queue, &msg, 0) == pdTRUE)
+                    delivered = true;
+                else
+                    ESP_LOGW("SENSOR", "HTTP queue full, geofence event kept for retry");
+            }
+
+            if (!delivered)
+                break;
+            gps_ack_geofence_event(fence_id);
+        }
+
+        // The GPS track leaves in batches of simplified points
+        if (is_wifi_connected() && uxQueueSpacesAvailable(http_queue) > 0 && gps_track_ready())
+        {
+            http_message_t msg = {.data_type = 2};
+            uint8_t *track = malloc(TRACK_BATCH_BYTES);
+            size_t len = track ? gps_take_track(track, TRACK_BATCH_BYTES, &msg.data.gps.points) : 0;
+            if (len > 0)
+            {
+                gps_data_t fix;
+                gps_get_data(&fix);
+                msg.data.gps.lat = fix.latitude;
+                msg.data.gps.lon = fix.longitude;
+                msg.data.gps.track = track;
+                msg.data.gps.track_len = (uint16_t)len;
+                if (xQueueSend(http_queue, &msg, 0) != pdTRUE)
+                {
+                    ESP_LOGW("SENSOR", "HTTP queue full, GPS track batch lost");
+                    free(track);
+                }
+            }
+            else
+            {
+                free(track);
+            }
+        }
+
         switch (ui.current_state)
         {
         case UI_STATE_TEMP_SCANNING:
         {
             loggedResult = false;
-            temperature_update_protected();
             ui_update_temp(&ui, 0);
 
+            // Stop as soon as the predicted final value settles
+            temperature_scan_t scan;
+            temperature_get_scan(&scan);
             uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-            if (!ui.scan_done && now - ui.scan_start_time_ms >= 10000)
+            if (!ui.scan_done && (scan.converged || now - ui.scan_start_time_ms >= TEMP_SCAN_MAX_MS))
             {
+                ESP_LOGI("SENSOR", "Scan done in %lu ms: %.2f C, confidence %d%%, %lu rejected",
+                         (unsigned long)(now - ui.scan_start_time_ms), scan.value_c, scan.confidence,
+                         (unsigned long)scan.rejected);
                 ui.scan_done = true;
                 ui.current_state = UI_STATE_TEMP_RESULT;
             }
@@ -173,13 +426,17 @@ void sensor_manager_task(void *pv)
         {
             if (!loggedResult && (current_time - last_http_send >= HTTP_SEND_INTERVAL))
             {
-                float t = temperature_get_data_protected();
+                temperature_scan_t scan;
+                temperature_get_scan(&scan);
+                float t = scan.value_c;
                 ui_update_temp(&ui, t);
 
                 if (is_wifi_connected())
                 {
                     http_message_t msg = {
                         .data_type = 0,
+                        .seq = scan.seq,
+                        .timestamp_ms = scan.timestamp_ms,
                         .data.temperature = t};
 
                     if (xQueueSend(http_queue, &msg, 0) == pdTRUE)
@@ -208,44 +465,66 @@ void sensor_manager_task(void *pv)
         case UI_STATE_HR:
         {
             health_data_t hd = {0};
-            if (health_get_data_protected(&hd)) 
+            health_get_data(&hd);
+
+            if ((hd.heart_rate != raw_hr || hd.spo2 != raw_sp) &&
+                hd.spo2_confidence >= HEALTH_SPO2_MIN_CONFIDENCE && hd.sqi >= HEALTH_SQI_MIN &&
+                (current_time - last_http_send >= HTTP_SEND_INTERVAL))
             {
-                if ((hd.heart_rate != raw_hr || hd.spo2 != raw_sp) &&
-                    (current_time - last_http_send >= HTTP_SEND_INTERVAL))
+                printf("%d,%d\n", hd.heart_rate, hd.spo2);
+                raw_hr = hd.heart_rate;
+                raw_sp = hd.spo2;
+
+                // Queue HTTP request
+                if (is_wifi_connected())
                 {
-                    printf("%d,%d\n", hd.heart_rate, hd.spo2);
-                    raw_hr = hd.heart_rate;
-                    raw_sp = hd.spo2;
+                    http_message_t msg = {
+                        .data_type = 1,
+                        .seq = hd.seq,
+                        .timestamp_ms = hd.timestamp_ms,
+                        .data.health = {hd.heart_rate, hd.spo2, hd.resp_rate}};
 
-                    // Queue HTTP request
-                    if (is_wifi_connected())
+                    if (xQueueSend(http_queue, &msg, 0) == pdTRUE)
                     {
-                        http_message_t msg = {
-                            .data_type = 1,
-                            .data.health = {hd.heart_rate, hd.spo2}};
-
-                        if (xQueueSend(http_queue, &msg, 0) == pdTRUE)
-                        {
-                            ESP_LOGI("SENSOR", "Health data queued: HR=%d, SpO2=%d",
-                                     hd.heart_rate, hd.spo2);
-                            last_http_send = current_time;
-                        }
-                        else
-                        {
-                            ESP_LOGW("SENSOR", "HTTP queue full, skipping health send");
-                        }
+                        ESP_LOGI("SENSOR", "Health data queued: HR=%d, SpO2=%d, RR=%d",
+                                 hd.heart_rate, hd.spo2, hd.resp_rate);
+                        last_http_send = current_time;
                     }
-
-                    // Send via Bluetooth
-                    if (bluetooth_is_connected())
+                    else
                     {
-                        bluetooth_notify_heart_rate(hd.heart_rate, hd.spo2);
-                        ESP_LOGI("SENSOR", "Health data sent via BLE: HR=%d, SpO2=%d", hd.heart_rate, hd.spo2);
+                        ESP_LOGW("SENSOR", "HTTP queue full, skipping health send");
                     }
                 }
 
-                ui_update_hr(&ui, hd.heart_rate, hd.spo2);
+                // Send via Bluetooth
+                if (bluetooth_is_connected())
+                {
+                    bluetooth_notify_heart_rate(hd.heart_rate, hd.spo2, hd.resp_rate);
+                    ESP_LOGI("SENSOR", "Health data sent via BLE: HR=%d, SpO2=%d", hd.heart_rate, hd.spo2);
+                }
             }
+
+            // HRV leaves the device as three numbers, never as a waveform
+            hrv_metrics_t hrv;
+            health_get_hrv(&hrv);
+            if (hrv.beats >= HRV_WINDOW_BEATS / 2 && hd.sqi >= HEALTH_SQI_MIN && is_wifi_connected() &&
+                (current_time - last_hrv_send >= HRV_SEND_INTERVAL))
+            {
+                http_message_t msg = {
+                    .data_type = 3,
+                    .data.hrv = {hrv.rmssd_ms, hrv.sdnn_ms, hrv.pnn50_pct}};
+
+                if (xQueueSend(http_queue, &msg, 0) == pdTRUE)
+                {
+                    last_hrv_send = current_time;
+                }
+            }
+
+            // Poor contact or motion: keep garbage off the chart
+            if (hd.valid && hd.sqi >= HEALTH_SQI_MIN)
+                ui_update_hr(&ui, hd.heart_rate, hd.spo2);
+            else
+                ui_update_hr(&ui, 0, 0);
             break;
         }
 
@@ -265,11 +544,31 @@ void sensor_manager_task(void *pv)
             break;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+        // Woken by fresh sensor data; the timeout picks up screen changes
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
     }
 }
 
 
+// Safe zones are provisioned into NVS ("geofence" namespace, "zones"
+// string, format in geofence.h); without them no zone events are raised
+static void load_geofences(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open("geofence", NVS_READONLY, &nvs) != ESP_OK)
+        return;
+
+    size_t len = 0;
+    if (nvs_get_str(nvs, "zones", NULL, &len) == ESP_OK && len > 0)
+    {
+        char *text = malloc(len);
+        if (text && nvs_get_str(nvs, "zones", text, &len) == ESP_OK)
+            gps_set_geofences(text);
+        free(text);
+    }
+    nvs_close(nvs);
+}
+
 void app_main(void)
 {
     esp_err_t err = i2c_master_init();
@@ -290,6 +589,13 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    // History keeps going to flash while offline
+    err = vitals_logger_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE("MAIN", "Vitals log unavailable: %s", esp_err_to_name(err));
+    }
+
     const char *ssid = "Cafe nui 2.4G";
     const char *pass = "nguyenchat";
     // const char *ssid = "Samsung Galaxy S8";
@@ -306,8 +612,14 @@ void app_main(void)
     }
 
     vTaskDelay(pdMS_TO_TICKS(1000));
+#ifdef CONFIG_SENSOR_REPLAY_TRACE
+    replay_start();
+#endif
     temperature_init();
     health_init();
+    gps_init();
+    load_geofences();
+    sensors_register();
     http_client_init();
 
     // Initialize Bluetooth
@@ -336,11 +648,10 @@ void app_main(void)
 
     // Create synchronization objects
     ESP_LOGI("MAIN", "Creating synchronization objects...");
-    i2c_mutex = xSemaphoreCreateMutex();
     http_semaphore = xSemaphoreCreateBinary();
     http_queue = xQueueCreate(10, sizeof(http_message_t));
 
-    if (i2c_mutex == NULL || http_semaphore == NULL || http_queue == NULL)
+    if (http_semaphore == NULL || http_queue == NULL)
     {
         ESP_LOGE("MAIN", "Failed to create synchronization objects");
         while (1)
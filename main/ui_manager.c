@@ -4,6 +4,7 @@
 #include "esp_log.h"
 #include "button.h"
 #include "health_tracker.h"
+#include "vitals_store.h"
 #include <math.h>
 #include "temperature_task.h"
 #include "freertos/FreeRTOS.h"
@@ -26,6 +27,8 @@ static const char *labels[] = {"Notifications", "Body Temp", "Heart Rate", "Dash
 
 static const char *settings_labels[] = {"WiFi", "Bluetooth"};
 
+#define UI_CHART_POINTS 20
+
 void ui_menu_update_selection(ui_manager_t *ui, lv_obj_t *list, int selected_index)
 {
     if (!list)
@@ -562,7 +565,7 @@ lv_obj_add_style(ui->bar_spo2, &bar_indic_spo2, LV_PART_INDICATOR);
     lv_obj_set_size(ui->chart_hr, 112, 35);
     lv_obj_align(ui->chart_hr, LV_ALIGN_TOP_MID, 0, 55);
     lv_chart_set_type(ui->chart_hr, LV_CHART_TYPE_LINE);
-    lv_chart_set_point_count(ui->chart_hr, 20);
+    lv_chart_set_point_count(ui->chart_hr, UI_CHART_POINTS);
     lv_chart_set_range(ui->chart_hr, LV_CHART_AXIS_PRIMARY_Y, 40, 160);
 
     // Style for HR chart
@@ -592,7 +595,7 @@ lv_obj_add_style(ui->bar_spo2, &bar_indic_spo2, LV_PART_INDICATOR);
     lv_obj_set_size(ui->chart_spo2, 112, 35);
     lv_obj_align(ui->chart_spo2, LV_ALIGN_TOP_MID, 0, 110);
     lv_chart_set_type(ui->chart_spo2, LV_CHART_TYPE_LINE);
-    lv_chart_set_point_count(ui->chart_spo2, 20);
+    lv_chart_set_point_count(ui->chart_spo2, UI_CHART_POINTS);
     lv_chart_set_range(ui->chart_spo2, LV_CHART_AXIS_PRIMARY_Y, 85, 100);
 
     // Style for SpO2 chart
@@ -610,13 +613,8 @@ lv_obj_add_style(ui->bar_spo2, &bar_indic_spo2, LV_PART_INDICATOR);
     lv_obj_set_style_line_width(ui->chart_spo2, 1, LV_PART_ITEMS);
 
 
-    // Initialize data arrays
-    ui->data_index = 0;
-    for (int i = 0; i < 20; i++)
-    {
-        ui->hr_data_points[i] = 0;
-        ui->spo2_data_points[i] = 95;
-    }
+    ui->hr_chart_end = 0;
+    ui->spo2_chart_end = 0;
     /* -------- WIFI--------- */
     ui->scr_wifi = lv_obj_create(NULL);
     lv_obj_set_style_bg_color(ui->scr_wifi, lv_color_black(), LV_PART_MAIN);
@@ -851,7 +849,7 @@ void ui_manager_handle_button(ui_manager_t *ui, button_id_t btn)
     case UI_STATE_TEMP_RESULT:
         if (btn == BUTTON_SELECT)
         {
-            temperature_init();
+            temperature_start_scan();
             ui->scan_start_time_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
             ui->scan_done = false;
             ui_switch(ui, UI_STATE_TEMP_SCANNING);
@@ -989,40 +987,52 @@ void ui_set_battery(ui_manager_t *ui, int p)
     lv_label_set_text_fmt(ui->lbl_battery, LV_SYMBOL_BATTERY_FULL " %d%%", p);
 }
 
-void ui_add_hr_data_point(ui_manager_t *ui, int hr)
+// Plots the last UI_CHART_POINTS samples of a vitals column whose quality
+// column reaches min_quality; older slots are left at 0
+static void ui_chart_from_vitals(lv_obj_t *chart, lv_chart_series_t *ser, const vitals_ring_t *r,
+                                 const uint8_t *values, const uint8_t *quality, uint8_t min_quality, uint32_t *drawn_end)
 {
-    if (!ui || ui->current_state != UI_STATE_HR)
+    vitals_snap_t snap;
+    vitals_snapshot(r, 0, &snap);
+    if (snap.end == *drawn_end)
         return;
 
-    // Store HR data point
-    ui->hr_data_points[ui->data_index] = hr;
-
-    // Update HR chart with all data points
-    lv_chart_set_all_value(ui->chart_hr, ui->ser_hr, 0);
-    for (int i = 0; i < 20; i++)
+    // Read straight from the store, newest first, then check nothing was overwritten
+    lv_coord_t pts[UI_CHART_POINTS];
+    uint32_t seqs[UI_CHART_POINTS];
+    int n = 0;
+    for (uint32_t seq = snap.end; seq != snap.first && n < UI_CHART_POINTS; seq--)
     {
-        int idx = (ui->data_index + i + 1) % 20;
-        lv_chart_set_next_value(ui->chart_hr, ui->ser_hr, ui->hr_data_points[idx]);
+        uint32_t i = vitals_slot(r, seq - 1);
+        if (quality[i] < min_quality)
+            continue;
+        pts[n] = values[i];
+        seqs[n++] = seq - 1;
     }
-    lv_chart_refresh(ui->chart_hr);
+    vitals_validate(r, &snap);
+    while (n > 0 && seqs[n - 1] < snap.first)
+        n--;
+
+    lv_chart_set_all_value(chart, ser, 0);
+    for (int i = 0; i < UI_CHART_POINTS - n; i++)
+        lv_chart_set_next_value(chart, ser, 0);
+    for (int i = n - 1; i >= 0; i--)
+        lv_chart_set_next_value(chart, ser, pts[i]);
+    lv_chart_refresh(chart);
+    *drawn_end = snap.end;
 }
 
-void ui_add_spo2_data_point(ui_manager_t *ui, int spo2)
+void ui_update_vitals_charts(ui_manager_t *ui)
 {
     if (!ui || ui->current_state != UI_STATE_HR)
         return;
 
-    // Store SpO2 data point
-    ui->spo2_data_points[ui->data_index] = spo2;
-
-    // Update SpO2 chart with all data points
-    lv_chart_set_all_value(ui->chart_spo2, ui->ser_spo2, 0);
-    for (int i = 0; i < 20; i++)
-    {
-        int idx = (ui->data_index + i + 1) % 20;
-        lv_chart_set_next_value(ui->chart_spo2, ui->ser_spo2, ui->spo2_data_points[idx]);
-    }
-    lv_chart_refresh(ui->chart_spo2);
+    // Poor contact or motion: keep garbage off the chart
+    const vitals_store_t *v = vitals_store();
+    ui_chart_from_vitals(ui->chart_hr, ui->ser_hr, &v->hr.ring, v->hr.bpm, v->hr.sqi, HEALTH_SQI_MIN,
+                         &ui->hr_chart_end);
+    ui_chart_from_vitals(ui->chart_spo2, ui->ser_spo2, &v->spo2.ring, v->spo2.percent, v->spo2.confidence,
+                         HEALTH_SPO2_MIN_CONFIDENCE, &ui->spo2_chart_end);
 }
 
 void ui_update_temp(ui_manager_t *ui, float t)
@@ -1102,12 +1112,8 @@ void ui_update_hr(ui_manager_t *ui, int hr, int spo2)
         lv_label_set_text_fmt(ui->lbl_hr, "Heart Rate: %d bpm", hr);
         lv_label_set_text_fmt(ui->lbl_spo2, "Blood Oxygen: %d%%", spo2);
 
-        // Add data points to both graphs
-        ui_add_hr_data_point(ui, hr);
-        ui_add_spo2_data_point(ui, spo2);
-
-        // Update data index for next reading
-        ui->data_index = (ui->data_index + 1) % 20;
+        // Both graphs show the stored history
+        ui_update_vitals_charts(ui);
 
         // Color coding for HR
         if (hr > 100)
@@ -1140,6 +1146,14 @@ void ui_update_hr(ui_manager_t *ui, int hr, int spo2)
             lv_obj_set_style_text_color(ui->lbl_spo2, lv_color_hex(0xFFEB3B), LV_PART_MAIN);
         }
     }
+    else
+    {
+        // No trustworthy reading (signal quality gate); nothing is charted
+        lv_label_set_text(ui->lbl_hr, "HR: Scanning...");
+        lv_label_set_text(ui->lbl_spo2, "SpO2: Please wait");
+        lv_obj_set_style_text_color(ui->lbl_hr, lv_color_hex(0xFFEB3B), LV_PART_MAIN);
+        lv_obj_set_style_text_color(ui->lbl_spo2, lv_color_hex(0xFFEB3B), LV_PART_MAIN);
+    }
 }
 
 void ui_update_dashboard(ui_manager_t *ui)
@@ -0,0 +1,172 @@
+// Host check of the geofence grid index against plain ray casting, plus
+// the cost per fix.
+//
+//     geofence_check [POLYGONS [POINTS_PER_POLYGON]]    (default 300 x 20000)
+//
+// Polygons are random star shapes of 3..GEOFENCE_MAX_VERTICES vertices. A
+// third of them are degenerate: vertices snapped to a lattice on the index
+// grid lines, so edges run along cell borders, vertices repeat coordinates
+// and consecutive edges are collinear. Half of the test points are uniform
+// over the padded bounding box; the rest share a coordinate with a vertex
+// or lie on a grid line, where the half-open rules matter. A point exactly
+// on an edge has no defined answer and is only counted. Any other
+// difference from ray casting fails the run.
+#include "geofence.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static uint32_t s_rng = 11;
+
+static uint32_t rnd(uint32_t n)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (uint32_t)(((uint64_t)(s_rng >> 4) * n) >> 28);
+}
+
+static int64_t orient(int64_t ax, int64_t ay, int64_t bx, int64_t by, int64_t px, int64_t py)
+{
+    return (bx - ax) * (py - ay) - (px - ax) * (by - ay);
+}
+
+// Reference: every edge, half-open in latitude, absolute coordinates
+static bool ray_cast(const geofence_point_t *v, int n, int64_t lat, int64_t lon)
+{
+    bool in = false;
+    for (int i = 0, j = n - 1; i < n; j = i++)
+    {
+        int64_t ay = v[j].lat_e7, by = v[i].lat_e7;
+        if ((ay > lat) == (by > lat))
+            continue;
+        int64_t o = orient(v[j].lon_e7, ay, v[i].lon_e7, by, lon, lat);
+        if ((by > ay) ? o > 0 : o < 0)
+            in = !in;
+    }
+    return in;
+}
+
+static bool on_edge(const geofence_point_t *v, int n, int64_t lat, int64_t lon)
+{
+    for (int i = 0, j = n - 1; i < n; j = i++)
+    {
+        int64_t ax = v[j].lon_e7, ay = v[j].lat_e7, bx = v[i].lon_e7, by = v[i].lat_e7;
+        if (orient(ax, ay, bx, by, lon, lat) != 0)
+            continue;
+        if (lon >= (ax < bx ? ax : bx) && lon <= (ax > bx ? ax : bx) && lat >= (ay < by ? ay : by) &&
+            lat <= (ay > by ? ay : by))
+            return true;
+    }
+    return false;
+}
+
+static int make_polygon(geofence_point_t *v, bool degenerate)
+{
+    int n = 3 + (int)rnd(GEOFENCE_MAX_VERTICES - 2);
+    int32_t clat = 481000000 + (int32_t)rnd(2000000) - 1000000;
+    int32_t clon = 115000000 + (int32_t)rnd(2000000) - 1000000;
+    int32_t radius = 20000 + (int32_t)rnd(2000000); // about 200 m to 20 km
+    int32_t step = radius / (GEOFENCE_GRID / 2);
+    if (rnd(2))
+        clon = -clon; // west of Greenwich too
+
+    double a0 = rnd(1000) / 1000.0 * 2.0 * M_PI;
+    for (int i = 0; i < n; i++)
+    {
+        double a = a0 + 2.0 * M_PI * (i + 0.8 * rnd(1000) / 1000.0) / n;
+        double r = radius * (0.3 + 0.7 * rnd(1000) / 1000.0);
+        int32_t dlat = (int32_t)lround(r * sin(a)), dlon = (int32_t)lround(r * cos(a));
+        if (degenerate)
+        {
+            // Lattice of grid-cell size anchored at the centre
+            dlat = (int32_t)lround((double)dlat / step) * step;
+            dlon = (int32_t)lround((double)dlon / step) * step;
+        }
+        v[i].lat_e7 = clat + dlat;
+        v[i].lon_e7 = clon + dlon;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    int polygons = argc > 1 ? atoi(argv[1]) : 300;
+    int points = argc > 2 ? atoi(argv[2]) : 20000;
+    uint64_t checked = 0, on_boundary = 0, mismatches = 0, inside = 0, rejected = 0;
+    uint64_t fast_hits = 0, edge_tests = 0;
+    double grid_ns = 0.0;
+
+    static geofence_t g;
+    int32_t *lat = malloc(sizeof(int32_t) * points);
+    int32_t *lon = malloc(sizeof(int32_t) * points);
+    bool *got = malloc(sizeof(bool) * points);
+    if (!lat || !lon || !got)
+        return EXIT_FAILURE;
+
+    for (int k = 0; k < polygons; k++)
+    {
+        geofence_point_t v[GEOFENCE_MAX_VERTICES];
+        int n = make_polygon(v, k % 3 == 0);
+        geofence_init(&g);
+        if (!geofence_add(&g, 1, v, n))
+        {
+            rejected++;
+            continue;
+        }
+        const geofence_zone_t *z = &g.zones[0];
+
+        for (int p = 0; p < points; p++)
+        {
+            int64_t y = z->min_lat - z->span_lat / 10 + rnd((uint32_t)(z->span_lat * 12 / 10));
+            int64_t x = z->min_lon - z->span_lon / 10 + rnd((uint32_t)(z->span_lon * 12 / 10));
+            switch (p % 6)
+            {
+            case 3: // on a vertex latitude or longitude
+                y = v[rnd((uint32_t)n)].lat_e7;
+                break;
+            case 4:
+                x = v[rnd((uint32_t)n)].lon_e7;
+                break;
+            case 5: // on an index grid line
+                y = z->min_lat + (int64_t)rnd(GEOFENCE_GRID + 1) * z->span_lat / GEOFENCE_GRID;
+                x = z->min_lon + (int64_t)rnd(GEOFENCE_GRID + 1) * z->span_lon / GEOFENCE_GRID;
+                break;
+            }
+            lat[p] = (int32_t)y;
+            lon[p] = (int32_t)x;
+        }
+
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int p = 0; p < points; p++)
+            got[p] = geofence_contains(&g, z, lat[p], lon[p]);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        grid_ns += (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+        fast_hits += g.fast_hits;
+        edge_tests += g.edge_tests;
+
+        for (int p = 0; p < points; p++)
+        {
+            checked++;
+            if (on_edge(v, n, lat[p], lon[p]))
+            {
+                on_boundary++;
+                continue;
+            }
+            bool want = ray_cast(v, n, lat[p], lon[p]);
+            inside += want;
+            if (got[p] != want && mismatches++ < 5)
+                printf("polygon %d (%d vertices%s): %ld,%ld grid says %s\n", k, n, k % 3 == 0 ? ", degenerate" : "",
+                       (long)lat[p], (long)lon[p], got[p] ? "inside" : "outside");
+        }
+    }
+
+    printf("%d polygons (%lu rejected), %lu points, %lu inside, %lu on an edge (not compared)\n", polygons,
+           (unsigned long)rejected, (unsigned long)checked, (unsigned long)inside, (unsigned long)on_boundary);
+    printf("grid index: %.1f %% resolved by lookup, %.1f ns/fix; %lu mismatches against ray casting\n",
+           100.0 * fast_hits / (fast_hits + edge_tests), grid_ns / checked, (unsigned long)mismatches);
+    free(lat);
+    free(lon);
+    free(got);
+    return mismatches || rejected ? EXIT_FAILURE : EXIT_SUCCESS;
+}
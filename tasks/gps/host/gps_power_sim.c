@@ -0,0 +1,361 @@
+// Host simulation of the GPS power policy driven by NMEA replay.
+//
+//     gps_power_sim [--write FILE]   synthetic 2 h walk/still/indoor day
+//     gps_power_sim FILE             recorded log
+//
+// The input is what an always-on receiver would have sent. It is replayed
+// on the UTC time of its sentences, and a receiver that follows the policy
+// is emulated on top of it:
+// - while the policy has it off, nothing is delivered
+// - after power-on it reports "no fix" RMC sentences until its time to
+//   first fix has passed
+// - once it has a fix it delivers one epoch per gps_power_rate_ms()
+// Delivered bytes go through nmea_feed(), and completed sentences reach
+// gps_power_on_fix() the way gps_publish() passes them on the watch.
+// --write saves the synthetic log so it can be replayed like a recording.
+// Every input is run twice, without and with geofences loaded. On the
+// synthetic day the receiver must stay off most of the time, and every
+// walk must reach fast tracking within SIM_MAX_DETECT_MS of its start
+// (SIM_MAX_DETECT_FENCED_MS with geofences); the exit code says whether
+// it did.
+#include "gps_power.h"
+#include "nmea_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_TTFF_COLD_MS  30000
+#define SIM_TTFF_HOT_MS   2000
+#define SIM_EPOCH_MS      100
+#define SIM_MAX_ON_PCT    50
+#define SIM_MAX_WALKS     8
+#define SIM_MAX_DETECT_MS        300000 // walk start to fast tracking
+#define SIM_MAX_DETECT_FENCED_MS 90000
+
+typedef struct {
+    int minutes;
+    enum { SEG_WALK, SEG_STILL, SEG_INDOOR } kind;
+} sim_segment_t;
+
+static const sim_segment_t s_day[] = {
+    {10, SEG_WALK}, {40, SEG_STILL}, {15, SEG_WALK}, {15, SEG_INDOOR}, {20, SEG_STILL}, {20, SEG_WALK},
+};
+
+typedef struct {
+    gps_power_t pw;
+    bool fenced;
+    nmea_parser_t clock;     // sees the whole log, gives its timeline
+    nmea_parser_t dev;       // sees what the emulated receiver delivers
+    bool on;
+    int64_t on_since_ms;
+    int64_t last_epoch_ms;   // last epoch delivered
+    uint32_t last_utc;
+    int64_t day_ms;          // added to utc_ms after midnight wraps
+    int64_t t0_ms;
+    bool started;
+    uint64_t bytes_in, bytes_out;
+    uint32_t walk_epochs, walk_fast;
+    bool in_walk;
+    int walks;
+    int64_t walk_start_ms[SIM_MAX_WALKS];
+    int64_t walk_detect_ms[SIM_MAX_WALKS]; // -1 until tracked at the fast rate
+    uint32_t transitions;
+} sim_t;
+
+static size_t sentence(char *out, const char *body)
+{
+    unsigned sum = 0;
+    for (const char *q = body; *q; q++)
+        sum ^= (unsigned char)*q;
+    return (size_t)sprintf(out, "$%s*%02X\r\n", body, sum);
+}
+
+static uint32_t s_rng = 9;
+
+// Uniform in [-1, 1)
+static double noise(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (double)(s_rng >> 8) / (double)(1u << 23) - 1.0;
+}
+
+static void format_angle(char *out, double deg, int deg_digits)
+{
+    double a = deg < 0 ? -deg : deg;
+    int d = (int)a;
+    sprintf(out, "%0*d%08.5f", deg_digits, d, (a - d) * 60.0);
+}
+
+// Always-on 10 Hz receiver over s_day: GGA + RMC every epoch. The walk
+// label travels in the GGA "station id" field so the replay can score it.
+static char *synth_log(size_t *len)
+{
+    size_t cap = 0;
+    for (size_t i = 0; i < sizeof(s_day) / sizeof(s_day[0]); i++)
+        cap += (size_t)s_day[i].minutes * 60 * 1000 / SIM_EPOCH_MS * 2 * NMEA_MAX_SENTENCE;
+    char *log = malloc(cap + 1);
+    if (!log)
+        return NULL;
+
+    double lat = 48.137, lon = 11.575;
+    int64_t t = 8 * 3600000LL; // 08:00 UTC
+    size_t n = 0;
+    for (size_t i = 0; i < sizeof(s_day) / sizeof(s_day[0]); i++)
+    {
+        for (int64_t k = 0; k < (int64_t)s_day[i].minutes * 60000 / SIM_EPOCH_MS; k++, t += SIM_EPOCH_MS)
+        {
+            bool walk = s_day[i].kind == SEG_WALK;
+            bool fix = s_day[i].kind != SEG_INDOOR;
+            if (walk)
+                lat += 1.4 * SIM_EPOCH_MS / 1000.0 / 111320.0;
+            double nlat = lat + 3.0 / 111320.0 * noise();
+            double nlon = lon + 3.0 / 74000.0 * noise();
+            double speed_kn = walk ? 2.72 + 0.2 * noise() : 0.15 * (noise() + 1.0);
+
+            char la[16], lo[16], body[96];
+            int hh = (int)(t / 3600000 % 24), mm = (int)(t / 60000 % 60), ss = (int)(t / 1000 % 60);
+            int cs = (int)(t % 1000 / 10);
+            format_angle(la, nlat, 2);
+            format_angle(lo, nlon, 3);
+            if (fix)
+                sprintf(body, "GPGGA,%02d%02d%02d.%02d,%s,N,%s,E,1,09,0.9,520.0,M,46.9,M,,%s", hh, mm, ss, cs, la, lo,
+                        walk ? "0001" : "");
+            else
+                sprintf(body, "GPGGA,%02d%02d%02d.%02d,,,,,0,00,99.9,,M,,M,,", hh, mm, ss, cs);
+            n += sentence(log + n, body);
+            if (fix)
+                sprintf(body, "GPRMC,%02d%02d%02d.%02d,A,%s,N,%s,E,%.2f,0.0,171026,,,A", hh, mm, ss, cs, la, lo,
+                        speed_kn);
+            else
+                sprintf(body, "GPRMC,%02d%02d%02d.%02d,V,,,,,,,171026,,,N", hh, mm, ss, cs);
+            n += sentence(log + n, body);
+        }
+    }
+    log[n] = '\0';
+    *len = n;
+    return log;
+}
+
+static void deliver(sim_t *s, int64_t t, const char *line, size_t len)
+{
+    s->bytes_out += len;
+    uint32_t done = nmea_feed(&s->dev, (const uint8_t *)line, len);
+    if (!(done & NMEA_RMC))
+        return;
+    const nmea_fix_t *f = &s->dev.fix;
+    bool valid = f->has_position && f->rmc_valid;
+    gps_power_on_fix(&s->pw, t, valid, f->lat_e7, f->lon_e7, f->speed_mm_s);
+}
+
+// One sentence of the log as the emulated receiver would send it, if at all
+static void receive(sim_t *s, int64_t t, uint32_t done, const char *line, size_t len)
+{
+    if (done & NMEA_GGA)
+    {
+        // One epoch per configured rate; its RMC follows the GGA
+        if (t - s->last_epoch_ms < gps_power_rate_ms(&s->pw) - SIM_EPOCH_MS / 2)
+            return;
+        s->last_epoch_ms = t;
+    }
+    else if (s->last_epoch_ms != t)
+    {
+        return;
+    }
+
+    int64_t ttff = s->pw.stats.fixes_acquired ? SIM_TTFF_HOT_MS : SIM_TTFF_COLD_MS;
+    if (t - s->on_since_ms < ttff)
+    {
+        if (done & NMEA_RMC)
+        {
+            char nofix[96], body[64];
+            uint32_t u = s->last_utc;
+            sprintf(body, "GPRMC,%02lu%02lu%02lu.%02lu,V,,,,,,,,,,N", (unsigned long)(u / 3600000 % 24),
+                    (unsigned long)(u / 60000 % 60), (unsigned long)(u / 1000 % 60), (unsigned long)(u % 1000 / 10));
+            deliver(s, t, nofix, sentence(nofix, body));
+        }
+        return;
+    }
+    deliver(s, t, line, len);
+}
+
+static void replay_line(sim_t *s, const char *line, size_t len)
+{
+    s->bytes_in += len;
+    uint32_t done = nmea_feed(&s->clock, (const uint8_t *)line, len);
+    if (done & (NMEA_GGA | NMEA_RMC))
+    {
+        uint32_t utc = s->clock.fix.utc_ms;
+        if (s->started && utc + 43200000u < s->last_utc)
+            s->day_ms += 86400000;
+        if (!s->started)
+        {
+            s->t0_ms = utc;
+            s->started = true;
+            gps_power_init(&s->pw, 0);
+            gps_power_set_fenced(&s->pw, s->fenced);
+        }
+        s->last_utc = utc;
+    }
+    if (!s->started)
+        return;
+
+    int64_t t = s->day_ms + s->last_utc - s->t0_ms;
+    gps_power_state_t before = s->pw.state;
+    gps_power_tick(&s->pw, t);
+
+    bool on = gps_power_on(&s->pw);
+    if (on && !s->on)
+    {
+        s->on_since_ms = t;
+        s->last_epoch_ms = -1000000;
+        nmea_init(&s->dev);
+    }
+    s->on = on;
+
+    // Only GGA carries the walk label; score once per epoch
+    bool walk_epoch = (done & NMEA_GGA) && len > 8 && memcmp(line + len - 9, "0001*", 5) == 0;
+    if (walk_epoch)
+    {
+        bool fast = on && s->pw.state == GPS_PWR_FAST;
+        if (!s->in_walk && s->walks < SIM_MAX_WALKS)
+        {
+            s->walk_start_ms[s->walks] = t;
+            s->walk_detect_ms[s->walks] = -1;
+            s->walks++;
+        }
+        if (fast && s->walks && s->walk_detect_ms[s->walks - 1] < 0)
+            s->walk_detect_ms[s->walks - 1] = t - s->walk_start_ms[s->walks - 1];
+        s->walk_epochs++;
+        s->walk_fast += fast;
+    }
+    if (done & NMEA_GGA)
+        s->in_walk = walk_epoch;
+
+    if (on && (done & (NMEA_GGA | NMEA_RMC)))
+        receive(s, t, done, line, len);
+    if (s->pw.state != before)
+        s->transitions++;
+}
+
+static void replay(sim_t *s, const char *log, size_t len)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (log[i] != '\n')
+            continue;
+        replay_line(s, log + start, i + 1 - start);
+        start = i + 1;
+    }
+}
+
+static char *load(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *text = malloc(*len + 1);
+    if (text && fread(text, 1, *len, f) != *len)
+    {
+        free(text);
+        text = NULL;
+    }
+    fclose(f);
+    return text;
+}
+
+// Replays the log once; true when a scored run met its bounds
+static bool run(const char *name, const char *log, size_t len, bool fenced, bool scored)
+{
+    static sim_t s;
+    memset(&s, 0, sizeof(s));
+    s.fenced = fenced;
+    nmea_init(&s.clock);
+    replay(&s, log, len);
+    if (!s.started)
+    {
+        printf("no timed sentences in the input\n");
+        return false;
+    }
+
+    int64_t end = s.day_ms + s.last_utc - s.t0_ms;
+    gps_power_stats_t st;
+    gps_power_get_stats(&s.pw, end, &st);
+    static const char *const names[] = {"acquire", "fast", "slow", "check", "sleep"};
+    unsigned on_pct = (unsigned)(st.on_ms * 100 / (st.on_ms + st.off_ms));
+
+    printf("%s, %s: %.1f min, %lu state changes\n", name, fenced ? "geofences loaded" : "no geofences",
+           end / 60000.0, (unsigned long)s.transitions);
+    printf("receiver on %u %% of the time, UART bytes %llu of %llu\n", on_pct, (unsigned long long)s.bytes_out,
+           (unsigned long long)s.bytes_in);
+    printf("time to fix: last %lu ms, avg %lu ms, max %lu ms; %lu fixes acquired, %lu timeouts, %lu wake-ups\n",
+           (unsigned long)st.ttf_last_ms, (unsigned long)st.ttf_avg_ms, (unsigned long)st.ttf_max_ms,
+           (unsigned long)st.fixes_acquired, (unsigned long)st.acquire_timeouts, (unsigned long)st.wakeups);
+    for (int i = 0; i <= GPS_PWR_SLEEP; i++)
+        printf("  %-8s %6.1f min\n", names[i], st.state_ms[i] / 60000.0);
+
+    int64_t max_detect = fenced ? SIM_MAX_DETECT_FENCED_MS : SIM_MAX_DETECT_MS;
+    int64_t worst = 0;
+    bool detected = true;
+    for (int i = 0; i < s.walks; i++)
+    {
+        if (s.walk_detect_ms[i] < 0)
+            printf("walk %d at %.1f min: never tracked\n", i + 1, s.walk_start_ms[i] / 60000.0);
+        else
+            printf("walk %d at %.1f min: fast tracking after %.1f s\n", i + 1, s.walk_start_ms[i] / 60000.0,
+                   s.walk_detect_ms[i] / 1000.0);
+        if (s.walk_detect_ms[i] > worst)
+            worst = s.walk_detect_ms[i];
+        detected &= s.walk_detect_ms[i] >= 0;
+    }
+    if (s.walk_epochs)
+        printf("walking epochs at the fast rate: %lu of %lu (%lu %%); slowest walk start to fast tracking %.1f s "
+               "(limit %.0f s)\n",
+               (unsigned long)s.walk_fast, (unsigned long)s.walk_epochs,
+               (unsigned long)(s.walk_fast * 100 / s.walk_epochs), worst / 1000.0, max_detect / 1000.0);
+
+    if (!scored)
+        return true;
+    bool ok = on_pct <= SIM_MAX_ON_PCT && s.walks == 3 && detected && worst <= max_detect;
+    printf("%s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = NULL, *write = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--write") && i + 1 < argc)
+            write = argv[++i];
+        else
+            path = argv[i];
+    }
+
+    size_t len = 0;
+    char *log = path ? load(path, &len) : synth_log(&len);
+    if (!log)
+        return EXIT_FAILURE;
+    if (write)
+    {
+        FILE *f = fopen(write, "wb");
+        if (!f || fwrite(log, 1, len, f) != len)
+        {
+            perror(write);
+            return EXIT_FAILURE;
+        }
+        fclose(f);
+    }
+
+    const char *name = path ? path : "synthetic day";
+    bool ok = run(name, log, len, false, !path);
+    ok &= run(name, log, len, true, !path);
+    free(log);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,244 @@
+// Host harness for the NMEA parser: decodes a fixed set of sentences,
+// measures throughput on a synthetic receiver log and fuzzes the parser.
+//
+//     nmea_fuzz [--bench] [--fuzz ITERATIONS]    (no option: all three)
+//
+// The fuzzer mutates slices of the log two ways: raw byte damage, which
+// mostly breaks the checksum and exercises the framing, and field damage
+// with the checksum recomputed, which reaches the field decoders and the
+// merge. After every feed the fix must stay physically plausible and the
+// byte counter must match what was fed. Build it with ASan/UBSan (the
+// host CMake target does) so memory errors abort the run. Defining
+// NMEA_LIBFUZZER builds a libFuzzer entry point instead of main().
+#include "nmea_parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_BYTES   (1 << 22)
+#define BENCH_PASSES 20
+#define SLICE       300
+
+static char s_log[LOG_BYTES];
+static size_t s_log_len;
+
+static size_t sentence(char *out, const char *body)
+{
+    unsigned sum = 0;
+    for (const char *q = body; *q; q++)
+        sum ^= (unsigned char)*q;
+    return (size_t)sprintf(out, "$%s*%02X\r\n", body, sum);
+}
+
+// 10 Hz GGA + RMC + GSA with moving time and position, like a receiver log
+static void build_log(void)
+{
+    char body[96];
+    for (int n = 0; s_log_len < LOG_BYTES - 3 * NMEA_MAX_SENTENCE; n++)
+    {
+        int hh = n / 36000 % 24, mm = n / 600 % 60, ss = n / 10 % 60, cs = n % 10 * 10;
+        sprintf(body, "GNGGA,%02d%02d%02d.%02d,4807.%05d,N,01131.%05d,E,1,12,0.8,%d.3,M,46.9,M,,", hh, mm, ss, cs,
+                n % 99999, n * 7 % 99999, 500 + n % 50);
+        s_log_len += sentence(s_log + s_log_len, body);
+        sprintf(body, "GNRMC,%02d%02d%02d.%02d,A,4807.038,N,01131.000,E,0.4,%d.1,171026,,,A", hh, mm, ss, cs,
+                n % 360);
+        s_log_len += sentence(s_log + s_log_len, body);
+        if (n % 10 == 0)
+            s_log_len += sentence(s_log + s_log_len, "GNGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1");
+    }
+}
+
+static bool fix_plausible(const nmea_fix_t *f)
+{
+    if (f->has_position && (f->lat_e7 > 900000000 || f->lat_e7 < -900000000 || f->lon_e7 > 1800000000 ||
+                            f->lon_e7 < -1800000000))
+        return false;
+    return f->utc_ms < 86401000 && f->course_cdeg < 36000 && f->fix_type <= 3 && f->satellites <= 99;
+}
+
+static int check_decode(void)
+{
+    static const char *const bodies[] = {
+        "GPGGA,123519.50,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,",
+        "GNRMC,123520.00,A,4807.038,S,01131.000,W,022.4,084.4,230394,003.1,W",
+        "GPVTG,054.7,T,034.4,M,005.5,N,010.2,K",
+        "GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1",
+        "GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45",
+    };
+    nmea_parser_t p;
+    nmea_init(&p);
+    char s[128];
+    uint32_t got = 0;
+    for (size_t i = 0; i < sizeof(bodies) / sizeof(bodies[0]); i++)
+        got |= nmea_feed(&p, (const uint8_t *)s, sentence(s, bodies[i]));
+
+    const nmea_fix_t *f = &p.fix;
+    int errors = 0;
+#define EXPECT(cond)                               \
+    do                                             \
+    {                                              \
+        if (!(cond))                               \
+        {                                          \
+            printf("decode: %s failed\n", #cond);  \
+            errors++;                              \
+        }                                          \
+    } while (0)
+    EXPECT(got == (NMEA_GGA | NMEA_RMC | NMEA_VTG | NMEA_GSA));
+    EXPECT(f->lat_e7 == -481173000 && f->lon_e7 == -115166667);
+    EXPECT(f->alt_cm == 54540 && f->satellites == 8 && f->quality == 1);
+    EXPECT(f->utc_ms == 45320000 && f->date == 230394 && f->rmc_valid);
+    EXPECT(f->speed_mm_s == 2833 && f->course_cdeg == 5470);
+    EXPECT(f->hdop_c == 130 && f->pdop_c == 250 && f->vdop_c == 210 && f->fix_type == 3);
+    EXPECT(p.stats.sentences == 4 && p.stats.ignored == 1);
+
+    // One changed character must fail the checksum and leave the fix alone
+    size_t n = sentence(s, "GPGGA,000000.00,0000.000,N,00000.000,E,1,08,0.9,1.0,M,,M,,");
+    s[8] = '1';
+    nmea_feed(&p, (const uint8_t *)s, n);
+    EXPECT(p.stats.bad_checksum == 1 && f->lat_e7 == -481173000);
+
+    // A sentence with a checksum but impossible fields is dropped whole
+    n = sentence(s, "GPGGA,123521.00,9107.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+    nmea_feed(&p, (const uint8_t *)s, n);
+    n = sentence(s, "GPVTG,400.0,T,034.4,M,005.5,N,010.2,K");
+    nmea_feed(&p, (const uint8_t *)s, n);
+    EXPECT(p.stats.malformed == 2 && f->lat_e7 == -481173000 && f->utc_ms == 45320000 && f->course_cdeg == 5470);
+#undef EXPECT
+
+    printf("decode: %s\n", errors ? "FAIL" : "ok");
+    return errors;
+}
+
+static void bench(void)
+{
+    nmea_parser_t p;
+    nmea_init(&p);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int r = 0; r < BENCH_PASSES; r++)
+        nmea_feed(&p, (const uint8_t *)s_log, s_log_len);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    double rate = BENCH_PASSES * s_log_len / s;
+    printf("throughput: %.1f MB/s, %.1f ns/byte (%lu sentences, %lu bad); 115200 baud is %.4f %% of a host core\n",
+           rate / 1e6, 1e9 / rate, (unsigned long)p.stats.sentences, (unsigned long)(p.stats.bad_checksum + p.stats.malformed),
+           11520.0 / rate * 100.0);
+}
+
+static uint32_t s_rng = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng % n;
+}
+
+// Damages fields of every complete sentence in buf and fixes up the
+// checksums, so the damage gets past framing into the decoders
+static void damage_fields(uint8_t *buf, size_t len)
+{
+    static const char alphabet[] = "0123456789.,-NSEWAV9999999999";
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (buf[i] == '$')
+            start = i;
+        if (buf[i] != '*' || i + 2 >= len || buf[start] != '$')
+            continue;
+        for (int k = rnd(4); k > 0 && i > start + 7; k--)
+            buf[start + 7 + rnd((uint32_t)(i - start - 7))] = (uint8_t)alphabet[rnd(sizeof(alphabet) - 1)];
+        unsigned sum = 0;
+        for (size_t q = start + 1; q < i; q++)
+            sum ^= buf[q];
+        static const char hex[] = "0123456789ABCDEF";
+        buf[i + 1] = (uint8_t)hex[sum >> 4];
+        buf[i + 2] = (uint8_t)hex[sum & 15];
+    }
+}
+
+static int fuzz(uint32_t iterations)
+{
+    nmea_parser_t p;
+    nmea_init(&p);
+    uint64_t fed = 0;
+    uint32_t implausible = 0;
+
+    for (uint32_t it = 0; it < iterations; it++)
+    {
+        uint8_t buf[SLICE];
+        size_t len = 1 + rnd(SLICE);
+        memcpy(buf, s_log + rnd((uint32_t)(s_log_len - SLICE)), SLICE);
+
+        if (it & 1)
+        {
+            damage_fields(buf, len);
+        }
+        else
+        {
+            for (int k = rnd(6); k > 0; k--)
+                buf[rnd((uint32_t)len)] = (uint8_t)rnd(256);
+            if (rnd(4) == 0)
+            {
+                size_t at = rnd((uint32_t)len);
+                memset(buf + at, '9', rnd((uint32_t)(len - at)));
+            }
+        }
+
+        nmea_feed(&p, buf, len);
+        fed += len;
+        if (!fix_plausible(&p.fix))
+        {
+            if (implausible++ == 0)
+                printf("fuzz: implausible fix at iteration %lu: lat %ld lon %ld utc %lu course %u type %u\n",
+                       (unsigned long)it, (long)p.fix.lat_e7, (long)p.fix.lon_e7, (unsigned long)p.fix.utc_ms,
+                       p.fix.course_cdeg, p.fix.fix_type);
+            nmea_init(&p);
+            fed = 0;
+        }
+        else if (p.stats.bytes != (uint32_t)fed)
+        {
+            printf("fuzz: byte count %lu, fed %lu\n", (unsigned long)p.stats.bytes, (unsigned long)fed);
+            return 1;
+        }
+    }
+    printf("fuzz: %lu iterations, %lu implausible fixes; last run %lu ok, %lu bad checksum, %lu malformed, %lu ignored\n",
+           (unsigned long)iterations, (unsigned long)implausible, (unsigned long)p.stats.sentences,
+           (unsigned long)p.stats.bad_checksum, (unsigned long)p.stats.malformed, (unsigned long)p.stats.ignored);
+    return implausible ? 1 : 0;
+}
+
+#ifdef NMEA_LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static nmea_parser_t p;
+    nmea_feed(&p, data, size);
+    if (!fix_plausible(&p.fix))
+        abort();
+    return 0;
+}
+#else
+int main(int argc, char **argv)
+{
+    bool all = argc == 1, do_bench = all;
+    uint32_t iterations = all ? 200000 : 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--bench"))
+            do_bench = true;
+        else if (!strcmp(argv[i], "--fuzz") && i + 1 < argc)
+            iterations = (uint32_t)strtoul(argv[++i], NULL, 0);
+    }
+
+    build_log();
+    int errors = check_decode();
+    if (do_bench)
+        bench();
+    if (iterations)
+        errors += fuzz(iterations);
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+#endif
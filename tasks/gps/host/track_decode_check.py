@@ -0,0 +1,52 @@
+"""Decodes the batches of track_walk_sim --dump with decode_track() from
+web_server/app.py and checks that it gets the points the simulation did.
+
+    track_decode_check.py TRACK_WALK_SIM APP_PY
+
+Only decode_track() is taken from app.py, so Flask and paho-mqtt need not
+be installed.
+"""
+import ast
+import base64
+import subprocess
+import sys
+
+
+def load_decode_track(path):
+    with open(path) as f:
+        tree = ast.parse(f.read(), path)
+    fn = [n for n in tree.body if isinstance(n, ast.FunctionDef) and n.name == "decode_track"]
+    scope = {"base64": base64}
+    exec(compile(ast.Module(body=fn, type_ignores=[]), path, "exec"), scope)
+    return scope["decode_track"]
+
+
+def main():
+    sim, app = sys.argv[1], sys.argv[2]
+    decode_track = load_decode_track(app)
+    out = subprocess.run([sim, "--dump"], capture_output=True, text=True).stdout
+
+    batches, points, mismatches = [], 0, 0
+    for line in out.splitlines():
+        kind, _, rest = line.partition(" ")
+        if kind == "batch":
+            batches.append((decode_track(rest), []))
+        elif kind == "point":
+            lat, lon, t = (int(v) for v in rest.split())
+            batches[-1][1].append([lat / 1e6, lon / 1e6, t / 10])
+
+    for got, want in batches:
+        points += len(want)
+        if got != want:
+            mismatches += 1
+            if mismatches <= 5:
+                print("batch of %d points decoded as %d, first %s, expected %s"
+                      % (len(want), len(got), got[:1], want[:1]))
+
+    print("decode_track: %d batches, %d points, %d batches differ"
+          % (len(batches), points, mismatches))
+    return 1 if mismatches or not points else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,303 @@
+// Host simulation of track_recorder on an hour-long walk, with the batches
+// decoded the way the web server does.
+//
+//     track_walk_sim [--min-ratio R]
+//     track_walk_sim --dump          batches and decoded points, for
+//                                    track_decode_check.py
+//
+// The walk is synthetic, one fix a second: straight streets on a grid with
+// corners, stops at crossings, a winding park path and a 90 s outage, with
+// the slowly wandering error of a real receiver on top. It is run once in
+// Munich and once as far south and west of the equator and Greenwich, so the
+// absolute coordinates of a batch are negative too. Batches are taken as
+// gps_take_track() does, when track_batch_ready() says so.
+//
+// Each batch is decoded by decode_batch(), which follows decode_track() in
+// web_server/app.py step for step. The run fails unless:
+// - every decoded point is one of the fixes, at 1e-6 degree, in order,
+//   starting with the first fix and ending with the last
+// - the decoded count is what the recorder says it kept, none dropped
+// - every fix lies within TRACK_TOLERANCE_M (plus rounding) of the decoded
+//   path, and kept points are at most TRACK_MAX_GAP_MS apart unless no fix
+//   came in between
+// - fixes per kept point are at least --min-ratio (default 8)
+// --dump prints each batch in base64 and the points decode_batch() got from
+// it, so that decode_track() itself can be checked against them.
+#include "track_recorder.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_SECONDS    3600
+#define SIM_START_MS   1760000000000LL
+#define SIM_OUTAGE_AT  1500 // s into the walk
+#define SIM_OUTAGE_S   90
+#define SIM_M_PER_E7   0.011131949 // metres per 1e-7 degree of latitude
+#define SIM_ROUND_M    0.25        // 1e-6 degree rounding of both ends, and float
+#define SIM_MAX_POINTS 4096
+#define SIM_MAX_VALUE  (1ULL << 40) // largest varint magnitude decode_batch() takes
+
+typedef struct {
+    int32_t lat_e6, lon_e6;
+    int64_t time_ds;
+} decoded_t;
+
+static uint32_t s_rng = 21;
+static bool s_dump;
+
+// Uniform in [-1, 1)
+static double noise(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (double)(s_rng >> 8) / (double)(1u << 23) - 1.0;
+}
+
+static int32_t to_e6(int32_t e7)
+{
+    return (e7 + (e7 >= 0 ? 5 : -5)) / 10;
+}
+
+// Fixes of the walk, in metres east and north of the start
+static int make_walk(double *x, double *y, bool *have)
+{
+    double px = 0.0, py = 0.0, ex = 0.0, ey = 0.0;
+    double grid = 0.35, heading = grid; // radians from east
+    double leg = 0.0, speed = 1.4;
+    int stop = 0, park = 0, n = 0;
+
+    for (int s = 0; s < SIM_SECONDS; s++)
+    {
+        if (stop > 0)
+            stop--;
+        else if (park > 0)
+        {
+            park--;
+            heading += 0.03 * sin(s / 40.0) + 0.01 * noise();
+            px += speed * cos(heading);
+            py += speed * sin(heading);
+        }
+        else
+        {
+            px += speed * cos(heading);
+            py += speed * sin(heading);
+            leg -= speed;
+            if (leg <= 0.0)
+            {
+                // At a crossing: wait sometimes, then carry on or turn
+                double r = (noise() + 1.0) / 2.0;
+                if (r < 0.2)
+                    stop = 15 + (int)(30 * (noise() + 1.0));
+                else if (r < 0.25 && s > 600)
+                    park = 300;
+                r = (noise() + 1.0) / 2.0;
+                if (r < 0.3)
+                    heading += M_PI / 2;
+                else if (r < 0.6)
+                    heading -= M_PI / 2;
+                if (park)
+                    heading = grid + M_PI / 4;
+                else
+                    heading = grid + M_PI / 2 * round((heading - grid) / (M_PI / 2));
+                leg = 80.0 + 70.0 * (noise() + 1.0);
+                speed = 1.4 + 0.2 * noise();
+            }
+        }
+
+        // Receiver error wanders, about 1.5 m rms
+        ex = 0.95 * ex + 0.8 * noise();
+        ey = 0.95 * ey + 0.8 * noise();
+
+        have[s] = !(s >= SIM_OUTAGE_AT && s < SIM_OUTAGE_AT + SIM_OUTAGE_S) && noise() > -0.95;
+        x[s] = px + ex;
+        y[s] = py + ey;
+        n += have[s];
+    }
+    return n;
+}
+
+static const char s_b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void print_base64(const uint8_t *b, size_t len)
+{
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t v = (uint32_t)b[i] << 16;
+        if (i + 1 < len)
+            v |= (uint32_t)b[i + 1] << 8;
+        if (i + 2 < len)
+            v |= b[i + 2];
+        putchar(s_b64[v >> 18 & 63]);
+        putchar(s_b64[v >> 12 & 63]);
+        putchar(i + 1 < len ? s_b64[v >> 6 & 63] : '=');
+        putchar(i + 2 < len ? s_b64[v & 63] : '=');
+    }
+}
+
+// decode_track() of web_server/app.py, without the base64 step and the
+// scaling to degrees and seconds. Python integers do not wrap, so a value
+// beyond SIM_MAX_VALUE, which no coordinate or time comes near, fails the
+// batch instead of wrapping back to the right answer here.
+static int decode_batch(const uint8_t *buf, size_t len, decoded_t *out, int max)
+{
+    if (len == 0 || buf[0] != 1)
+        return 0;
+    int64_t vals[3 * (TRACK_BATCH_BYTES + 1)];
+    int n_vals = 0;
+    uint64_t u = 0;
+    int shift = 0;
+    for (size_t i = 1; i < len; i++)
+    {
+        u |= (uint64_t)(buf[i] & 0x7F) << shift;
+        shift += 7;
+        if (shift > 63)
+            return -1;
+        if (!(buf[i] & 0x80))
+        {
+            if (u >> 1 > SIM_MAX_VALUE)
+                return -1;
+            vals[n_vals++] = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+            u = 0;
+            shift = 0;
+        }
+    }
+    int n = 0;
+    int64_t lat = 0, lon = 0, t = 0;
+    for (int i = 0; i < n_vals - 2 && n < max; i += 3)
+    {
+        lat += vals[i];
+        lon += vals[i + 1];
+        t += vals[i + 2];
+        out[n++] = (decoded_t){(int32_t)lat, (int32_t)lon, t};
+    }
+    return n;
+}
+
+static decoded_t s_decoded[SIM_MAX_POINTS];
+
+static bool run(const char *name, int32_t lat0_e7, int32_t lon0_e7, double min_ratio)
+{
+    static double x[SIM_SECONDS], y[SIM_SECONDS];
+    static bool have[SIM_SECONDS];
+    static track_recorder_t t;
+    int fixes = make_walk(x, y, have);
+    double k_lon = SIM_M_PER_E7 * cos(lat0_e7 * M_PI / 180.0 / 1e7);
+    track_point_t p[SIM_SECONDS];
+
+    track_init(&t);
+    int n_dec = 0, batches = 0, bad_batches = 0, last = -1;
+    size_t bytes = 0;
+    for (int s = 0; s <= SIM_SECONDS; s++)
+    {
+        if (s < SIM_SECONDS && have[s])
+        {
+            p[s] = (track_point_t){lat0_e7 + (int32_t)lround(y[s] / SIM_M_PER_E7),
+                                   lon0_e7 + (int32_t)lround(x[s] / k_lon), SIM_START_MS + s * 1000LL};
+            track_add(&t, &p[s]);
+            last = s;
+        }
+        if (s == SIM_SECONDS)
+            track_flush(&t);
+        if (track_batch_ready(&t, SIM_START_MS + s * 1000LL) || (s == SIM_SECONDS && t.batch_points))
+        {
+            uint8_t batch[TRACK_BATCH_BYTES];
+            uint16_t points = 0;
+            size_t len = track_take_batch(&t, batch, sizeof(batch), &points);
+            int got = decode_batch(batch, len, s_decoded + n_dec, SIM_MAX_POINTS - n_dec);
+            bad_batches += len == 0 || len > TRACK_BATCH_BYTES || got != points;
+            if (got < 0)
+                got = 0;
+            if (s_dump)
+            {
+                printf("batch ");
+                print_base64(batch, len);
+                printf("\n");
+                for (int k = 0; k < got; k++)
+                    printf("point %ld %ld %lld\n", (long)s_decoded[n_dec + k].lat_e6,
+                           (long)s_decoded[n_dec + k].lon_e6, (long long)s_decoded[n_dec + k].time_ds);
+            }
+            n_dec += got;
+            bytes += len;
+            batches++;
+        }
+    }
+
+    // Match the decoded points to the fixes they came from
+    int matched = 0, mismatched = 0, first_fix = -1;
+    int at[SIM_MAX_POINTS];
+    for (int s = 0; s < SIM_SECONDS && first_fix < 0; s++)
+        first_fix = have[s] ? s : -1;
+    for (int k = 0; k < n_dec; k++)
+    {
+        int64_t sec = (s_decoded[k].time_ds * 100 - SIM_START_MS) / 1000;
+        bool ok = sec >= 0 && sec < SIM_SECONDS && have[sec] && (k == 0 || sec > at[k - 1]) &&
+                  s_decoded[k].lat_e6 == to_e6(p[sec].lat_e7) && s_decoded[k].lon_e6 == to_e6(p[sec].lon_e7);
+        at[k] = ok ? (int)sec : (k ? at[k - 1] : -1);
+        if (ok)
+            matched++;
+        else if (mismatched++ < 5)
+            printf("%s: decoded point %d (%ld, %ld, %lld) is no fix\n", name, k, (long)s_decoded[k].lat_e6,
+                   (long)s_decoded[k].lon_e6, (long long)s_decoded[k].time_ds);
+    }
+    bool ends = n_dec > 0 && at[0] == first_fix && at[n_dec - 1] == last;
+
+    // Distance of every fix from the decoded path, and the gaps between
+    // kept points
+    double worst_m = 0.0;
+    int long_gaps = 0;
+    for (int k = 0; mismatched == 0 && k + 1 < n_dec; k++)
+    {
+        double ax = (s_decoded[k].lon_e6 * 10.0 - lon0_e7) * k_lon;
+        double ay = (s_decoded[k].lat_e6 * 10.0 - lat0_e7) * SIM_M_PER_E7;
+        double bx = (s_decoded[k + 1].lon_e6 * 10.0 - lon0_e7) * k_lon - ax;
+        double by = (s_decoded[k + 1].lat_e6 * 10.0 - lat0_e7) * SIM_M_PER_E7 - ay;
+        double len2 = bx * bx + by * by;
+        int between = 0;
+        for (int s = at[k] + 1; s < at[k + 1]; s++)
+        {
+            if (!have[s])
+                continue;
+            between++;
+            double qx = (p[s].lon_e7 - lon0_e7) * k_lon - ax, qy = (p[s].lat_e7 - lat0_e7) * SIM_M_PER_E7 - ay;
+            double u = len2 > 0.0 ? (qx * bx + qy * by) / len2 : 0.0;
+            u = u < 0.0 ? 0.0 : (u > 1.0 ? 1.0 : u);
+            double d = hypot(qx - u * bx, qy - u * by);
+            if (d > worst_m)
+                worst_m = d;
+        }
+        if (between > 0 && (at[k + 1] - at[k]) * 1000 > TRACK_MAX_GAP_MS)
+            long_gaps++;
+    }
+
+    track_stats_t st = t.stats;
+    double ratio = n_dec ? (double)fixes / n_dec : 0.0;
+    bool ok = mismatched == 0 && ends && bad_batches == 0 && n_dec == (int)st.kept && st.dropped == 0 &&
+              worst_m <= TRACK_TOLERANCE_M + SIM_ROUND_M && long_gaps == 0 && ratio >= min_ratio;
+    if (!s_dump)
+    {
+        printf("%s: %d fixes, %lu kept (%.1f fixes per point), %d batches, %lu bytes (%.2f bytes per fix)\n", name,
+               fixes, (unsigned long)st.kept, ratio, batches, (unsigned long)bytes, (double)bytes / fixes);
+        printf("%s: %d/%d decoded points match a fix%s, worst distance of a fix from the path %.2f m, %d gaps over "
+               "%d s: %s\n",
+               name, matched, n_dec, ends ? "" : " (ends missing)", worst_m, long_gaps, TRACK_MAX_GAP_MS / 1000,
+               ok ? "ok" : "FAIL");
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    double min_ratio = 8.0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--dump"))
+            s_dump = true;
+        else if (!strcmp(argv[i], "--min-ratio") && i + 1 < argc)
+            min_ratio = atof(argv[++i]);
+    }
+
+    bool ok = run("munich", 481371000, 115754000, min_ratio);
+    s_rng = 21;
+    ok &= run("south-west", -481371000, -115754000, min_ratio);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
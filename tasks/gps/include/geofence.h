@@ -0,0 +1,73 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Polygon geofences with a precomputed grid index. Each zone's bounding
+// box is split into GEOFENCE_GRID x GEOFENCE_GRID cells. A cell that no
+// edge crosses is known to be inside or outside. A boundary cell keeps the
+// inside state of a reference point (its centre, moved off any edge that
+// runs through it) and a mask of the edges that touch it. A fix in an
+// inside/outside cell is resolved by one lookup. A fix in a boundary cell
+// only tests that cell's edges against the segment from the reference
+// point. Coordinates stay in integer 1e-7 degrees relative to the box, so
+// the test is exact. No ESP-IDF dependencies.
+
+#define GEOFENCE_MAX_ZONES    4
+#define GEOFENCE_MAX_VERTICES 32 // one bit per edge in the cell masks
+#define GEOFENCE_GRID         16
+#define GEOFENCE_REF_SEARCH   8  // how far a boundary cell's reference may move off its centre
+#define GEOFENCE_CONFIRM      3  // consecutive fixes before a transition is reported
+
+typedef struct {
+    int32_t lat_e7;
+    int32_t lon_e7;
+} geofence_point_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t n;                             // vertices
+    int32_t min_lat, min_lon;              // bounding box origin
+    int32_t span_lat, span_lon;            // box size + 1
+    int32_t x[GEOFENCE_MAX_VERTICES];      // lon relative to the box
+    int32_t y[GEOFENCE_MAX_VERTICES];      // lat relative to the box
+    uint8_t cell[GEOFENCE_GRID * GEOFENCE_GRID];
+    uint32_t edges[GEOFENCE_GRID * GEOFENCE_GRID]; // boundary cells only
+    int8_t ref_dx[GEOFENCE_GRID * GEOFENCE_GRID];  // boundary cells: reference point
+    int8_t ref_dy[GEOFENCE_GRID * GEOFENCE_GRID];  // offset from the centre
+
+    bool inside;        // reported state
+    bool known;         // a state has been reported since loading
+    bool candidate;     // state the current streak agrees on
+    uint8_t streak;     // fixes in a row disagreeing with the reported state
+} geofence_zone_t;
+
+typedef struct {
+    geofence_zone_t zones[GEOFENCE_MAX_ZONES];
+    uint8_t count;
+    uint32_t fast_hits; // fixes resolved from the grid alone
+    uint32_t edge_tests;
+} geofence_t;
+
+typedef struct {
+    uint8_t zone_id;
+    bool inside; // true: entered, false: left
+} geofence_event_t;
+
+void geofence_init(geofence_t *g);
+
+// Adds a simple polygon (no self-intersections, 3..GEOFENCE_MAX_VERTICES
+// vertices, either winding). Returns false if it does not fit.
+bool geofence_add(geofence_t *g, uint8_t id, const geofence_point_t *v, int n);
+
+// Loads zones from text, one per line:
+//   <id>: <lat>,<lon> <lat>,<lon> ...
+// in decimal degrees. Blank lines and lines starting with # are skipped.
+// Returns the number of zones loaded, or -1 on a malformed line.
+int geofence_load(geofence_t *g, const char *text);
+
+bool geofence_contains(geofence_t *g, const geofence_zone_t *z, int32_t lat_e7, int32_t lon_e7);
+
+// Runs one fix through every zone. Confirmed transitions are written to
+// events (at most max); the first fix after loading reports each zone's
+// starting state. Returns the number written.
+int geofence_update(geofence_t *g, int32_t lat_e7, int32_t lon_e7, geofence_event_t *events, int max);
@@ -0,0 +1,90 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Receiver power policy. While the wearer moves the receiver runs at the
+// fast rate. Once every fix stays within GPS_PWR_STILL_RADIUS_M for
+// GPS_PWR_SLOW_AFTER_MS it drops to the slow rate. After GPS_PWR_SLEEP_AFTER_MS
+// it is switched off. A sleeping receiver wakes periodically for a short
+// check: if the position has moved it goes back to fast tracking,
+// otherwise it sleeps again for twice as long, up to GPS_PWR_SLEEP_MAX_MS.
+// A wake-up that finds no fix within the timeout counts as no sky view
+// and backs off the same way. The cap bounds how long a walk can go
+// unnoticed; while geofences are loaded it is GPS_PWR_FENCE_MAX_MS,
+// so leaving a zone is seen within about a minute. No ESP-IDF
+// dependencies.
+
+#define GPS_PWR_FAST_RATE_MS     100    // 10 Hz
+#define GPS_PWR_SLOW_RATE_MS     1000
+#define GPS_PWR_STILL_RADIUS_M   25     // GPS noise stays well inside this
+#define GPS_PWR_MOVE_SPEED_MM_S  1000   // faster than this for a few fixes is motion
+#define GPS_PWR_MOVE_FIXES       3
+#define GPS_PWR_SLOW_AFTER_MS    30000
+#define GPS_PWR_SLEEP_AFTER_MS   120000
+#define GPS_PWR_SLEEP_MIN_MS     60000
+#define GPS_PWR_SLEEP_MAX_MS     240000
+#define GPS_PWR_FENCE_MAX_MS     60000  // sleep cap while geofences are loaded
+#define GPS_PWR_CHECK_FIXES      3      // fixes taken on a wake-up before deciding
+#define GPS_PWR_ACQUIRE_MS       60000  // a wake-up gives up without a fix after this
+#define GPS_PWR_COLD_ACQUIRE_MS  180000 // first fix after boot
+
+typedef enum {
+    GPS_PWR_ACQUIRE, // on, waiting for a fix
+    GPS_PWR_FAST,
+    GPS_PWR_SLOW,
+    GPS_PWR_CHECK,   // woken from sleep, looking for motion
+    GPS_PWR_SLEEP,   // receiver off
+} gps_power_state_t;
+
+typedef struct {
+    uint32_t ttf_last_ms;      // power-on to first valid fix
+    uint32_t ttf_avg_ms;
+    uint32_t ttf_max_ms;
+    uint32_t fixes_acquired;
+    uint32_t acquire_timeouts;
+    uint32_t wakeups;
+    uint64_t on_ms;            // receiver powered
+    uint64_t off_ms;
+    uint64_t state_ms[GPS_PWR_SLEEP + 1];
+} gps_power_stats_t;
+
+typedef struct {
+    gps_power_state_t state;
+    int64_t state_since_ms;
+    int64_t power_on_ms;       // start of the current acquisition
+    int64_t last_ms;           // last time the accounting ran
+    bool cold;                 // no fix since boot
+    bool acquired;             // a fix since power_on_ms
+
+    // Stationary tracking
+    bool have_anchor;
+    int32_t anchor_lat_e7, anchor_lon_e7;
+    int64_t still_since_ms;
+    uint8_t fast_fixes;        // consecutive fixes above the motion speed
+
+    // Sleep and wake-up check
+    uint32_t sleep_ms;
+    uint32_t sleep_max_ms;
+    int64_t wake_at_ms;
+    uint8_t check_fixes;       // fixes left before deciding on a wake-up
+
+    uint64_t ttf_sum_ms;
+    gps_power_stats_t stats;
+} gps_power_t;
+
+void gps_power_init(gps_power_t *p, int64_t now_ms);
+
+// Both return true when the receiver has to be reconfigured; read
+// gps_power_on() and gps_power_rate_ms() then
+bool gps_power_on_fix(gps_power_t *p, int64_t now_ms, bool valid, int32_t lat_e7, int32_t lon_e7, uint32_t speed_mm_s);
+bool gps_power_tick(gps_power_t *p, int64_t now_ms);
+
+// Geofences loaded or cleared: switches the sleep cap, shortening a sleep
+// already under way if needed
+void gps_power_set_fenced(gps_power_t *p, bool fenced);
+
+bool gps_power_on(const gps_power_t *p);
+uint16_t gps_power_rate_ms(const gps_power_t *p);
+
+// Stats with the running state's time added in
+void gps_power_get_stats(gps_power_t *p, int64_t now_ms, gps_power_stats_t *out);
@@ -1,15 +1,84 @@
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
+#include "driver/uart.h"
+#include "gps_power.h"
+#include "nmea_parser.h"
+#include "track_recorder.h"
+#include "geofence.h"
+
+// Receiver link. The receiver must already be set to this baud rate; 10 Hz
+// with GGA+RMC+VTG+GSA is about 3 kB/s, a quarter of what 115200 carries.
+#define GPS_UART_NUM       UART_NUM_2
+#define GPS_UART_TX_IO     17
+#define GPS_UART_RX_IO     16
+#define GPS_UART_BAUD      115200
+#define GPS_UART_RX_BUF    2048 // driver ring buffer, ~180 ms of a saturated link
+#define GPS_UART_QUEUE_LEN 16
+#define GPS_READ_CHUNK     256
+#define GPS_TASK_PRIO      3
+#define GPS_TASK_STACK     3072
+#define GPS_FENCE_EVENTS   8 // transitions held until read
+#define GPS_VITALS_INTERVAL_US 1000000 // fixes kept in the vitals store
+
+// Receiver power (see gps_power.h). With a switch on the receiver supply,
+// set GPS_POWER_GPIO to its enable pin. Left at -1 the receiver is
+// put into u-blox backup mode over the UART instead and woken by traffic on
+// its RX line. The rate is set with UBX-CFG-RATE either way.
+#define GPS_POWER_GPIO     -1
+#define GPS_WAKE_MS        100  // receiver boot before it takes commands
+#define GPS_TICK_MS        1000 // power policy runs at least this often
 
 typedef struct {
     float latitude;
     float longitude;
     bool valid;
+    int32_t lat_e7;       // full resolution, degrees * 1e7
+    int32_t lon_e7;
+    float altitude_m;
+    float speed_kmh;
+    float course_deg;
+    float hdop;
+    uint8_t fix_quality;  // GGA: 0 none, 1 GPS, 2 DGPS, 4/5 RTK, 6 dead reckoning
+    uint8_t fix_type;     // GSA: 1 none, 2 2D, 3 3D
+    uint8_t satellites;
+    uint32_t utc_ms;      // time of day of the fix
+    uint32_t date;        // ddmmyy
+    int64_t timestamp_us; // esp_timer time the fix arrived
 } gps_data_t;
 
-void gps_init(void);
+typedef struct {
+    nmea_stats_t nmea;
+    uint32_t fixes;          // GGA/RMC sentences published
+    uint32_t uart_overflows; // RX FIFO or ring buffer overruns, data dropped
+    track_stats_t track;
+    uint32_t fence_events_lost;
+    gps_power_state_t power_state;
+    gps_power_stats_t power;
+} gps_stats_t;
 
-void gps_update(void);
+// Installs the UART driver and starts the receive task
+void gps_init(void);
 
 void gps_get_data(gps_data_t *out);
-    
\ No newline at end of file
+
+void gps_get_stats(gps_stats_t *out);
+
+// Valid fixes are recorded as a simplified track (see track_recorder.h).
+// True when a batch is due for upload.
+bool gps_track_ready(void);
+
+// Takes the pending track batch; returns its length, 0 if none is due or
+// it does not fit in max (TRACK_BATCH_BYTES always does)
+size_t gps_take_track(uint8_t *out, size_t max, uint16_t *points);
+
+// Replaces the geofences with the zones in text (format in geofence.h).
+// Every valid fix is checked against them; returns the zone count or -1.
+int gps_set_geofences(const char *text);
+
+// Oldest confirmed zone transition, left queued until it is acknowledged
+// with its id, so one that could not be delivered is offered again
+bool gps_peek_geofence_event(geofence_event_t *out, uint32_t *id);
+
+// Removes the transition returned with id; a no-op if it is already gone
+void gps_ack_geofence_event(uint32_t id);
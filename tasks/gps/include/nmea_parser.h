@@ -0,0 +1,76 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental NMEA 0183 parser. Bytes are consumed one at a time straight
+// from the receive buffer: fields are converted to integers as their
+// digits arrive and the checksum is kept as a running XOR, so no sentence
+// is ever copied or re-scanned. A sentence's fields are only merged into
+// the fix once its checksum matches and every field is in range. Understands GGA, RMC, VTG and GSA
+// from any talker (GP, GN, GL, ...). No ESP-IDF dependencies.
+
+#define NMEA_MAX_SENTENCE 82 // '$' to LF, per the standard
+
+typedef enum {
+    NMEA_GGA = 1 << 0,
+    NMEA_RMC = 1 << 1,
+    NMEA_VTG = 1 << 2,
+    NMEA_GSA = 1 << 3,
+} nmea_sentence_t;
+
+typedef struct {
+    int32_t lat_e7;       // degrees * 1e7, north positive
+    int32_t lon_e7;       // degrees * 1e7, east positive
+    int32_t alt_cm;       // above mean sea level
+    uint32_t utc_ms;      // time of day
+    uint32_t date;        // ddmmyy, 0 until an RMC with a date
+    uint32_t speed_mm_s;
+    uint16_t course_cdeg; // 0.01 degree
+    uint16_t hdop_c;      // dilution of precision * 100
+    uint16_t pdop_c;
+    uint16_t vdop_c;
+    uint8_t quality;      // GGA fix quality, 0 = no fix
+    uint8_t fix_type;     // GSA: 1 none, 2 2D, 3 3D
+    uint8_t satellites;   // used in the solution
+    bool rmc_valid;       // RMC status 'A'
+    bool has_position;
+} nmea_fix_t;
+
+typedef struct {
+    uint32_t bytes;
+    uint32_t sentences;  // checksum OK and understood
+    uint32_t ignored;    // checksum OK, other sentence types
+    uint32_t bad_checksum;
+    uint32_t malformed;  // too long, missing checksum, bad characters or a field out of range
+} nmea_stats_t;
+
+typedef struct {
+    int64_t mant;   // digits seen so far, without the decimal point
+    uint8_t frac;   // digits after the point
+    uint8_t digits;
+    bool point;
+    bool neg;
+    char letter;    // first non-numeric character, for N/S, A/V, ...
+} nmea_field_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t type;      // nmea_sentence_t being parsed, 0 while unknown
+    uint8_t len;
+    uint8_t field_idx;
+    uint8_t sum;
+    uint8_t expect_sum;
+    char tag[5];       // talker + sentence type
+    nmea_field_t field;
+    nmea_fix_t pend;   // fields of the sentence in progress
+    uint32_t pend_mask; // which pend members it has set
+    nmea_fix_t fix;
+    nmea_stats_t stats;
+} nmea_parser_t;
+
+void nmea_init(nmea_parser_t *p);
+
+// Consumes len bytes. Returns a mask of nmea_sentence_t completed (and
+// merged into p->fix) along the way.
+uint32_t nmea_feed(nmea_parser_t *p, const uint8_t *data, size_t len);
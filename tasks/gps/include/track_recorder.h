@@ -0,0 +1,72 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Records a GPS track with on-line simplification and packs the kept
+// points into compact upload batches. Fixes are held in an opening window
+// while a straight line from the last kept point still passes within
+// TRACK_TOLERANCE_M of every one of them. Once it no longer does, the
+// newest point that still fit is kept and the window restarts from it.
+// Kept points are written as zigzag varints: the first point of a batch
+// absolute, the others as deltas from the previous point. No ESP-IDF
+// dependencies.
+//
+// Batch format, version 1:
+//   u8 version
+//   first point: zz(lat_e6) zz(lon_e6) zz(time_ds)   absolute
+//   each next:   zz(dlat)   zz(dlon)   zz(dtime)     deltas
+// where time_ds is Unix time in tenths of a second.
+
+#define TRACK_FORMAT_VERSION   1
+#define TRACK_TOLERANCE_M      5.0f   // largest distance of a dropped fix from the kept path
+#define TRACK_WINDOW           32     // fixes held while a segment is open
+#define TRACK_MAX_GAP_MS       60000  // keep at least one point a minute
+#define TRACK_BATCH_BYTES      480
+#define TRACK_BATCH_MAX_AGE_MS 300000 // a partly filled batch is due after this long
+#define TRACK_POINT_MAX_BYTES  20     // 5 + 5 + 10 for the worst-case point
+
+typedef struct {
+    int32_t lat_e7;
+    int32_t lon_e7;
+    int64_t time_ms; // Unix time, UTC
+} track_point_t;
+
+typedef struct {
+    uint32_t fixes;     // points offered
+    uint32_t kept;      // points written to a batch
+    uint32_t dropped;   // kept points lost because no batch was taken in time
+    uint32_t batches;
+    uint32_t bytes;     // batch bytes handed out
+} track_stats_t;
+
+typedef struct {
+    bool have_anchor;
+    track_point_t anchor;
+    float anchor_cos;   // cos(latitude) at the anchor, for the local projection
+    track_point_t window[TRACK_WINDOW];
+    uint8_t window_len;
+
+    uint8_t batch[TRACK_BATCH_BYTES];
+    size_t batch_len;
+    uint16_t batch_points;
+    int64_t batch_start_ms;
+    int32_t prev_lat_e6, prev_lon_e6; // last point written, for the deltas
+    int64_t prev_time_ds;
+
+    track_stats_t stats;
+} track_recorder_t;
+
+void track_init(track_recorder_t *t);
+
+void track_add(track_recorder_t *t, const track_point_t *p);
+
+// Keeps the last fix of the open segment, e.g. when recording stops
+void track_flush(track_recorder_t *t);
+
+// True once the batch is full or older than TRACK_BATCH_MAX_AGE_MS
+bool track_batch_ready(const track_recorder_t *t, int64_t now_ms);
+
+// Moves the batch to out and starts a new one. Returns its length, or 0
+// if it is empty or does not fit in max.
+size_t track_take_batch(track_recorder_t *t, uint8_t *out, size_t max, uint16_t *points);
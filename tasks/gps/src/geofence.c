@@ -0,0 +1,324 @@
+#include "geofence.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    CELL_OUT,
+    CELL_IN,
+    CELL_EDGE_OUT, // boundary cell, centre outside
+    CELL_EDGE_IN,  // boundary cell, centre inside
+};
+
+#define GEOFENCE_MAX_SPAN (1 << 30) // keeps every cross product inside int64_t
+
+void geofence_init(geofence_t *g)
+{
+    memset(g, 0, sizeof(*g));
+}
+
+// > 0 when p is left of a->b
+static int64_t orient(int64_t ax, int64_t ay, int64_t bx, int64_t by, int64_t px, int64_t py)
+{
+    return (bx - ax) * (py - ay) - (px - ax) * (by - ay);
+}
+
+// Ray casting over every edge, half-open in y so shared vertices count once
+static bool zone_pip(const geofence_zone_t *z, int32_t px, int32_t py)
+{
+    bool in = false;
+    for (int i = 0, j = z->n - 1; i < z->n; j = i++)
+    {
+        int32_t ay = z->y[j], by = z->y[i];
+        if ((ay > py) == (by > py))
+            continue;
+        int64_t o = orient(z->x[j], ay, z->x[i], by, px, py);
+        if ((by > ay) ? o > 0 : o < 0)
+            in = !in;
+    }
+    return in;
+}
+
+static bool zone_on_edge(const geofence_zone_t *z, int64_t px, int64_t py)
+{
+    for (int i = 0, j = z->n - 1; i < z->n; j = i++)
+    {
+        int64_t ax = z->x[j], ay = z->y[j], bx = z->x[i], by = z->y[i];
+        if (orient(ax, ay, bx, by, px, py) == 0 && px >= (ax < bx ? ax : bx) && px <= (ax > bx ? ax : bx) &&
+            py >= (ay < by ? ay : by) && py <= (ay > by ? ay : by))
+            return true;
+    }
+    return false;
+}
+
+// Reference point of a boundary cell: its centre, or the nearest point
+// around it that is on no edge. A point on an edge has no defined state,
+// and the walk in geofence_contains() needs one.
+static void cell_reference(geofence_zone_t *z, int c, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+    int32_t cx = x0 + (x1 - x0) / 2, cy = y0 + (y1 - y0) / 2;
+    for (int r = 0; r <= GEOFENCE_REF_SEARCH; r++)
+    {
+        for (int dy = -r; dy <= r; dy++)
+        {
+            for (int dx = -r; dx <= r; dx++)
+            {
+                if ((dx != -r && dx != r && dy != -r && dy != r) || cx + dx < x0 || cx + dx >= x1 || cy + dy < y0 ||
+                    cy + dy >= y1)
+                    continue;
+                if (!zone_on_edge(z, cx + dx, cy + dy))
+                {
+                    z->ref_dx[c] = (int8_t)dx;
+                    z->ref_dy[c] = (int8_t)dy;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+// Whether the segment (x0,y0)-(x1,y1) touches the rectangle, widened by
+// one unit so rounding can only add edges, never miss one
+static bool segment_hits_rect(double x0, double y0, double x1, double y1,
+                              double rx0, double ry0, double rx1, double ry1)
+{
+    double t0 = 0.0, t1 = 1.0;
+    double dx = x1 - x0, dy = y1 - y0;
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {x0 - (rx0 - 1), (rx1 + 1) - x0, y0 - (ry0 - 1), (ry1 + 1) - y0};
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (p[k] == 0.0)
+        {
+            if (q[k] < 0.0)
+                return false;
+            continue;
+        }
+        double r = q[k] / p[k];
+        if (p[k] < 0.0)
+        {
+            if (r > t1)
+                return false;
+            if (r > t0)
+                t0 = r;
+        }
+        else
+        {
+            if (r < t0)
+                return false;
+            if (r < t1)
+                t1 = r;
+        }
+    }
+    return true;
+}
+
+static int32_t cell_edge_x(const geofence_zone_t *z, int i)
+{
+    return (int32_t)((int64_t)i * z->span_lon / GEOFENCE_GRID);
+}
+
+static int32_t cell_edge_y(const geofence_zone_t *z, int j)
+{
+    return (int32_t)((int64_t)j * z->span_lat / GEOFENCE_GRID);
+}
+
+bool geofence_add(geofence_t *g, uint8_t id, const geofence_point_t *v, int n)
+{
+    if (g->count >= GEOFENCE_MAX_ZONES || n < 3 || n > GEOFENCE_MAX_VERTICES)
+        return false;
+
+    geofence_zone_t *z = &g->zones[g->count];
+    memset(z, 0, sizeof(*z));
+
+    int32_t min_lat = v[0].lat_e7, max_lat = v[0].lat_e7;
+    int32_t min_lon = v[0].lon_e7, max_lon = v[0].lon_e7;
+    for (int i = 1; i < n; i++)
+    {
+        if (v[i].lat_e7 < min_lat) min_lat = v[i].lat_e7;
+        if (v[i].lat_e7 > max_lat) max_lat = v[i].lat_e7;
+        if (v[i].lon_e7 < min_lon) min_lon = v[i].lon_e7;
+        if (v[i].lon_e7 > max_lon) max_lon = v[i].lon_e7;
+    }
+    if ((int64_t)max_lat - min_lat >= GEOFENCE_MAX_SPAN || (int64_t)max_lon - min_lon >= GEOFENCE_MAX_SPAN)
+        return false;
+
+    z->id = id;
+    z->n = (uint8_t)n;
+    z->min_lat = min_lat;
+    z->min_lon = min_lon;
+    z->span_lat = max_lat - min_lat + 1;
+    z->span_lon = max_lon - min_lon + 1;
+    for (int i = 0; i < n; i++)
+    {
+        z->x[i] = v[i].lon_e7 - min_lon;
+        z->y[i] = v[i].lat_e7 - min_lat;
+    }
+
+    for (int cj = 0; cj < GEOFENCE_GRID; cj++)
+    {
+        for (int ci = 0; ci < GEOFENCE_GRID; ci++)
+        {
+            int32_t x0 = cell_edge_x(z, ci), x1 = cell_edge_x(z, ci + 1);
+            int32_t y0 = cell_edge_y(z, cj), y1 = cell_edge_y(z, cj + 1);
+            uint32_t mask = 0;
+            for (int i = 0, j = n - 1; i < n; j = i++)
+            {
+                if (segment_hits_rect(z->x[j], z->y[j], z->x[i], z->y[i], x0, y0, x1, y1))
+                    mask |= 1u << i; // edge i runs from vertex i-1 to vertex i
+            }
+
+            int c = cj * GEOFENCE_GRID + ci;
+            if (mask)
+                cell_reference(z, c, x0, y0, x1, y1);
+            bool centre_in = zone_pip(z, x0 + (x1 - x0) / 2 + z->ref_dx[c], y0 + (y1 - y0) / 2 + z->ref_dy[c]);
+            z->edges[c] = mask;
+            if (mask)
+                z->cell[c] = centre_in ? CELL_EDGE_IN : CELL_EDGE_OUT;
+            else
+                z->cell[c] = centre_in ? CELL_IN : CELL_OUT;
+        }
+    }
+
+    g->count++;
+    return true;
+}
+
+bool geofence_contains(geofence_t *g, const geofence_zone_t *z, int32_t lat_e7, int32_t lon_e7)
+{
+    int64_t px = (int64_t)lon_e7 - z->min_lon;
+    int64_t py = (int64_t)lat_e7 - z->min_lat;
+    if (px < 0 || py < 0 || px >= z->span_lon || py >= z->span_lat)
+    {
+        g->fast_hits++;
+        return false;
+    }
+
+    int ci = (int)(px * GEOFENCE_GRID / z->span_lon);
+    int cj = (int)(py * GEOFENCE_GRID / z->span_lat);
+    int c = cj * GEOFENCE_GRID + ci;
+    if (z->cell[c] == CELL_IN || z->cell[c] == CELL_OUT)
+    {
+        g->fast_hits++;
+        return z->cell[c] == CELL_IN;
+    }
+
+    // Walk from the cell's reference point, whose state is known, flipping
+    // on every edge of this cell the short segment crosses
+    g->edge_tests++;
+    int32_t x0 = cell_edge_x(z, ci), x1 = cell_edge_x(z, ci + 1);
+    int32_t y0 = cell_edge_y(z, cj), y1 = cell_edge_y(z, cj + 1);
+    int64_t cx = x0 + (x1 - x0) / 2 + z->ref_dx[c], cy = y0 + (y1 - y0) / 2 + z->ref_dy[c];
+    bool in = z->cell[c] == CELL_EDGE_IN;
+
+    uint32_t mask = z->edges[c];
+    while (mask)
+    {
+        int i = __builtin_ctz(mask);
+        mask &= mask - 1;
+        int j = i ? i - 1 : z->n - 1;
+        int64_t ax = z->x[j], ay = z->y[j], bx = z->x[i], by = z->y[i];
+
+        // Edge endpoints half-open about the segment, as in ray casting
+        bool sa = orient(cx, cy, px, py, ax, ay) > 0;
+        bool sb = orient(cx, cy, px, py, bx, by) > 0;
+        if (sa == sb)
+            continue;
+        bool sc = orient(ax, ay, bx, by, cx, cy) > 0;
+        bool sq = orient(ax, ay, bx, by, px, py) > 0;
+        if (sc != sq)
+            in = !in;
+    }
+    return in;
+}
+
+int geofence_update(geofence_t *g, int32_t lat_e7, int32_t lon_e7, geofence_event_t *events, int max)
+{
+    int count = 0;
+    for (int k = 0; k < g->count; k++)
+    {
+        geofence_zone_t *z = &g->zones[k];
+        bool in = geofence_contains(g, z, lat_e7, lon_e7);
+
+        if (z->known && in == z->inside)
+        {
+            z->streak = 0;
+            continue;
+        }
+        if (z->streak > 0 && in != z->candidate)
+            z->streak = 0;
+        z->candidate = in;
+        if (++z->streak < GEOFENCE_CONFIRM)
+            continue;
+
+        z->inside = in;
+        z->known = true;
+        z->streak = 0;
+        if (count < max)
+            events[count++] = (geofence_event_t){z->id, in};
+    }
+    return count;
+}
+
+static const char *skip_blank(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+        p++;
+    return p;
+}
+
+int geofence_load(geofence_t *g, const char *text)
+{
+    const char *p = text;
+    int loaded = 0;
+
+    while (*p)
+    {
+        p = skip_blank(p);
+        if (*p == '#' || *p == '\n' || *p == '\0')
+        {
+            while (*p && *p != '\n')
+                p++;
+            if (*p)
+                p++;
+            continue;
+        }
+
+        char *end;
+        long id = strtol(p, &end, 10);
+        if (end == p)
+            return -1;
+        p = skip_blank(end);
+        if (*p++ != ':' || id < 0 || id > UINT8_MAX)
+            return -1;
+
+        geofence_point_t v[GEOFENCE_MAX_VERTICES];
+        int n = 0;
+        while (1)
+        {
+            p = skip_blank(p);
+            if (*p == '\n' || *p == '\0')
+                break;
+            if (n == GEOFENCE_MAX_VERTICES)
+                return -1;
+            double lat = strtod(p, &end);
+            if (end == p || *end != ',')
+                return -1;
+            p = end + 1;
+            double lon = strtod(p, &end);
+            if (end == p || fabs(lat) > 90.0 || fabs(lon) > 180.0)
+                return -1;
+            p = end;
+            v[n].lat_e7 = (int32_t)llround(lat * 1e7);
+            v[n].lon_e7 = (int32_t)llround(lon * 1e7);
+            n++;
+        }
+
+        if (!geofence_add(g, (uint8_t)id, v, n))
+            return -1;
+        loaded++;
+    }
+    return loaded;
+}
@@ -0,0 +1,203 @@
+#include "gps_power.h"
+#include <math.h>
+#include <string.h>
+
+#define GPS_PWR_M_PER_E7 0.011131949f
+
+void gps_power_init(gps_power_t *p, int64_t now_ms)
+{
+    memset(p, 0, sizeof(*p));
+    p->state = GPS_PWR_ACQUIRE;
+    p->state_since_ms = now_ms;
+    p->power_on_ms = now_ms;
+    p->last_ms = now_ms;
+    p->cold = true;
+    p->sleep_ms = GPS_PWR_SLEEP_MIN_MS;
+    p->sleep_max_ms = GPS_PWR_SLEEP_MAX_MS;
+}
+
+void gps_power_set_fenced(gps_power_t *p, bool fenced)
+{
+    p->sleep_max_ms = fenced ? GPS_PWR_FENCE_MAX_MS : GPS_PWR_SLEEP_MAX_MS;
+    if (p->sleep_ms > p->sleep_max_ms)
+        p->sleep_ms = p->sleep_max_ms;
+    if (p->state == GPS_PWR_SLEEP && p->wake_at_ms > p->state_since_ms + p->sleep_max_ms)
+        p->wake_at_ms = p->state_since_ms + p->sleep_max_ms;
+}
+
+bool gps_power_on(const gps_power_t *p)
+{
+    return p->state != GPS_PWR_SLEEP;
+}
+
+uint16_t gps_power_rate_ms(const gps_power_t *p)
+{
+    return p->state == GPS_PWR_FAST ? GPS_PWR_FAST_RATE_MS : GPS_PWR_SLOW_RATE_MS;
+}
+
+static void gps_power_account(gps_power_t *p, int64_t now_ms)
+{
+    int64_t dt = now_ms - p->last_ms;
+    if (dt <= 0)
+        return;
+    p->stats.state_ms[p->state] += dt;
+    if (gps_power_on(p))
+        p->stats.on_ms += dt;
+    else
+        p->stats.off_ms += dt;
+    p->last_ms = now_ms;
+}
+
+// Returns true when the receiver's power or rate changes
+static bool gps_power_enter(gps_power_t *p, gps_power_state_t state, int64_t now_ms)
+{
+    bool was_on = gps_power_on(p);
+    uint16_t was_rate = gps_power_rate_ms(p);
+
+    p->state = state;
+    p->state_since_ms = now_ms;
+    if (state == GPS_PWR_SLEEP)
+        p->wake_at_ms = now_ms + p->sleep_ms;
+    if (!was_on && gps_power_on(p))
+    {
+        p->power_on_ms = now_ms;
+        p->acquired = false;
+    }
+    return was_on != gps_power_on(p) || (gps_power_on(p) && was_rate != gps_power_rate_ms(p));
+}
+
+// Before entering GPS_PWR_SLEEP, which sets the wake-up from sleep_ms
+static void gps_power_sleep_longer(gps_power_t *p)
+{
+    p->sleep_ms = p->sleep_ms * 2 > p->sleep_max_ms ? p->sleep_max_ms : p->sleep_ms * 2;
+}
+
+static float gps_power_distance_m(const gps_power_t *p, int32_t lat_e7, int32_t lon_e7)
+{
+    float k = cosf(p->anchor_lat_e7 * (float)(M_PI / 180.0 / 1e7));
+    float dx = (lon_e7 - p->anchor_lon_e7) * GPS_PWR_M_PER_E7 * k;
+    float dy = (lat_e7 - p->anchor_lat_e7) * GPS_PWR_M_PER_E7;
+    return sqrtf(dx * dx + dy * dy);
+}
+
+static void gps_power_set_anchor(gps_power_t *p, int64_t now_ms, int32_t lat_e7, int32_t lon_e7)
+{
+    p->anchor_lat_e7 = lat_e7;
+    p->anchor_lon_e7 = lon_e7;
+    p->have_anchor = true;
+    p->still_since_ms = now_ms;
+    p->fast_fixes = 0;
+}
+
+bool gps_power_on_fix(gps_power_t *p, int64_t now_ms, bool valid, int32_t lat_e7, int32_t lon_e7, uint32_t speed_mm_s)
+{
+    gps_power_account(p, now_ms);
+    if (p->state == GPS_PWR_SLEEP)
+        return false;
+
+    if (!valid)
+    {
+        // Lost the sky while tracking: reacquire under the timeout
+        if (p->state == GPS_PWR_FAST || p->state == GPS_PWR_SLOW)
+        {
+            bool changed = gps_power_enter(p, GPS_PWR_ACQUIRE, now_ms);
+            p->power_on_ms = now_ms;
+            p->acquired = false;
+            return changed;
+        }
+        return false;
+    }
+
+    if (!p->acquired)
+    {
+        uint32_t ttf = (uint32_t)(now_ms - p->power_on_ms);
+        p->acquired = true;
+        p->cold = false;
+        p->stats.ttf_last_ms = ttf;
+        if (ttf > p->stats.ttf_max_ms)
+            p->stats.ttf_max_ms = ttf;
+        p->ttf_sum_ms += ttf;
+        p->stats.fixes_acquired++;
+        p->stats.ttf_avg_ms = (uint32_t)(p->ttf_sum_ms / p->stats.fixes_acquired);
+    }
+
+    if (speed_mm_s > GPS_PWR_MOVE_SPEED_MM_S)
+        p->fast_fixes++;
+    else
+        p->fast_fixes = 0;
+    bool moving = !p->have_anchor || p->fast_fixes >= GPS_PWR_MOVE_FIXES ||
+                  gps_power_distance_m(p, lat_e7, lon_e7) > GPS_PWR_STILL_RADIUS_M;
+
+    switch (p->state)
+    {
+    case GPS_PWR_ACQUIRE:
+        gps_power_set_anchor(p, now_ms, lat_e7, lon_e7);
+        return gps_power_enter(p, GPS_PWR_FAST, now_ms);
+
+    case GPS_PWR_CHECK:
+        if (moving)
+        {
+            p->sleep_ms = GPS_PWR_SLEEP_MIN_MS;
+            gps_power_set_anchor(p, now_ms, lat_e7, lon_e7);
+            return gps_power_enter(p, GPS_PWR_FAST, now_ms);
+        }
+        if (--p->check_fixes == 0)
+        {
+            gps_power_sleep_longer(p);
+            return gps_power_enter(p, GPS_PWR_SLEEP, now_ms);
+        }
+        return false;
+
+    case GPS_PWR_FAST:
+    case GPS_PWR_SLOW:
+        if (moving)
+        {
+            gps_power_set_anchor(p, now_ms, lat_e7, lon_e7);
+            return p->state == GPS_PWR_SLOW ? gps_power_enter(p, GPS_PWR_FAST, now_ms) : false;
+        }
+        if (p->state == GPS_PWR_FAST && now_ms - p->still_since_ms >= GPS_PWR_SLOW_AFTER_MS)
+            return gps_power_enter(p, GPS_PWR_SLOW, now_ms);
+        if (p->state == GPS_PWR_SLOW && now_ms - p->still_since_ms >= GPS_PWR_SLEEP_AFTER_MS)
+        {
+            p->sleep_ms = GPS_PWR_SLEEP_MIN_MS;
+            return gps_power_enter(p, GPS_PWR_SLEEP, now_ms);
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+bool gps_power_tick(gps_power_t *p, int64_t now_ms)
+{
+    gps_power_account(p, now_ms);
+
+    if (p->state == GPS_PWR_SLEEP)
+    {
+        if (now_ms < p->wake_at_ms)
+            return false;
+        p->stats.wakeups++;
+        p->check_fixes = GPS_PWR_CHECK_FIXES;
+        p->fast_fixes = 0;
+        return gps_power_enter(p, GPS_PWR_CHECK, now_ms);
+    }
+
+    if ((p->state == GPS_PWR_ACQUIRE || p->state == GPS_PWR_CHECK) && !p->acquired)
+    {
+        int64_t limit = p->cold ? GPS_PWR_COLD_ACQUIRE_MS : GPS_PWR_ACQUIRE_MS;
+        if (now_ms - p->power_on_ms < limit)
+            return false;
+        // No sky view; try again later, less often each time
+        p->stats.acquire_timeouts++;
+        gps_power_sleep_longer(p);
+        return gps_power_enter(p, GPS_PWR_SLEEP, now_ms);
+    }
+    return false;
+}
+
+void gps_power_get_stats(gps_power_t *p, int64_t now_ms, gps_power_stats_t *out)
+{
+    gps_power_account(p, now_ms);
+    *out = p->stats;
+}
@@ -1,20 +1,454 @@
-
 #include "gps_tracker.h"
-#include "driver/uart.h"
+#include "vitals_store.h"
+#include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
+#include <stdlib.h>
 #include <string.h>
-#include "driver/gpio.h"
 
-void gps_init(void) {
-    
+static const char *TAG = "GPS";
+
+static QueueHandle_t s_uart_queue = NULL;
+static TaskHandle_t s_task = NULL;
+static nmea_parser_t s_parser;
+
+// Published fix; written by the GPS task, read by anyone
+static gps_data_t s_data = {0};
+static gps_stats_t s_stats = {0};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static track_recorder_t s_track;
+static SemaphoreHandle_t s_track_mutex = NULL;
+static int64_t s_track_unix_ms = 0; // last recorded fix, and when it arrived
+static int64_t s_track_us = 0;
+static int64_t s_vitals_us = 0; // last fix put in the vitals store
+
+static geofence_t s_fence;
+static SemaphoreHandle_t s_fence_mutex = NULL;
+static geofence_event_t s_fence_events[GPS_FENCE_EVENTS];
+static uint8_t s_fence_head = 0, s_fence_count = 0; // guarded by s_lock
+static uint32_t s_fence_popped = 0; // events ever removed; id of the one at head
+
+static gps_power_t s_power; // guarded by s_lock
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t gps_days_from_civil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + doe - 719468;
+}
+
+// Unix time of the fix in ms, 0 until an RMC has supplied the date
+static int64_t gps_unix_ms(const nmea_fix_t *f)
+{
+    if (f->date == 0)
+        return 0;
+    int dd = f->date / 10000;
+    int mm = f->date / 100 % 100;
+    int yy = f->date % 100;
+    return gps_days_from_civil(2000 + yy, mm, dd) * 86400000LL + f->utc_ms;
+}
+
+static void gps_record(const gps_data_t *d)
+{
+    int64_t t = gps_unix_ms(&s_parser.fix);
+    if (!d->valid || t == 0)
+    {
+        // Losing the fix ends the segment where it was last seen
+        xSemaphoreTake(s_track_mutex, portMAX_DELAY);
+        track_flush(&s_track);
+        xSemaphoreGive(s_track_mutex);
+        return;
+    }
+
+    geofence_event_t ev[GEOFENCE_MAX_ZONES];
+    xSemaphoreTake(s_fence_mutex, portMAX_DELAY);
+    int n = geofence_update(&s_fence, d->lat_e7, d->lon_e7, ev, GEOFENCE_MAX_ZONES);
+    xSemaphoreGive(s_fence_mutex);
+    for (int i = 0; i < n; i++)
+    {
+        ESP_LOGI(TAG, "Zone %u %s", ev[i].zone_id, ev[i].inside ? "entered" : "left");
+        portENTER_CRITICAL(&s_lock);
+        if (s_fence_count == GPS_FENCE_EVENTS)
+        {
+            // Keep the newest transitions
+            s_fence_head = (s_fence_head + 1) % GPS_FENCE_EVENTS;
+            s_fence_count--;
+            s_fence_popped++;
+            s_stats.fence_events_lost++;
+        }
+        s_fence_events[(s_fence_head + s_fence_count) % GPS_FENCE_EVENTS] = ev[i];
+        s_fence_count++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+
+    if (s_vitals_us == 0 || d->timestamp_us - s_vitals_us >= GPS_VITALS_INTERVAL_US)
+    {
+        vitals_add_gps(vitals_store(), d->timestamp_us, d->lat_e7, d->lon_e7);
+        s_vitals_us = d->timestamp_us;
+    }
+
+    track_point_t p = {d->lat_e7, d->lon_e7, t};
+    xSemaphoreTake(s_track_mutex, portMAX_DELAY);
+    track_add(&s_track, &p);
+    s_track_unix_ms = t;
+    s_track_us = d->timestamp_us;
+    xSemaphoreGive(s_track_mutex);
+}
+
+// Current UTC extrapolated from the last fix, so a batch still ages out
+// after the signal is lost. Call with the track mutex held.
+static int64_t gps_track_now_ms(void)
+{
+    return s_track_unix_ms + (esp_timer_get_time() - s_track_us) / 1000;
+}
+
+static void gps_ubx_send(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+    uint8_t hdr[6] = {0xB5, 0x62, cls, id, len & 0xFF, len >> 8};
+    uint8_t ck_a = 0, ck_b = 0;
+
+    // Fletcher-8 over class, id, length and payload
+    for (int i = 2; i < 6; i++)
+    {
+        ck_a += hdr[i];
+        ck_b += ck_a;
+    }
+    for (uint16_t i = 0; i < len; i++)
+    {
+        ck_a += payload[i];
+        ck_b += ck_a;
+    }
+    uint8_t ck[2] = {ck_a, ck_b};
+
+    uart_write_bytes(GPS_UART_NUM, hdr, sizeof(hdr));
+    if (len)
+        uart_write_bytes(GPS_UART_NUM, payload, len);
+    uart_write_bytes(GPS_UART_NUM, ck, sizeof(ck));
+}
+
+static void gps_set_rate(uint16_t rate_ms)
+{
+    // CFG-RATE: measRate, navRate 1, timeRef GPS
+    uint8_t p[6] = {rate_ms & 0xFF, rate_ms >> 8, 1, 0, 1, 0};
+    gps_ubx_send(0x06, 0x08, p, sizeof(p));
+}
+
+static void gps_set_receiver_power(bool on)
+{
+#if GPS_POWER_GPIO >= 0
+    gpio_set_level(GPS_POWER_GPIO, on);
+#else
+    if (on)
+    {
+        // Any byte on RX wakes the receiver from backup
+        static const uint8_t wake[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+        uart_write_bytes(GPS_UART_NUM, wake, sizeof(wake));
+    }
+    else
+    {
+        // RXM-PMREQ: backup mode until woken (duration 0, flags bit 1)
+        static const uint8_t pmreq[8] = {0, 0, 0, 0, 0x02, 0, 0, 0};
+        gps_ubx_send(0x02, 0x41, pmreq, sizeof(pmreq));
+        uart_wait_tx_done(GPS_UART_NUM, pdMS_TO_TICKS(100));
+    }
+#endif
+}
+
+// Applies the policy's decision to the receiver
+static void gps_apply_power(bool was_on)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool on = gps_power_on(&s_power);
+    uint16_t rate = gps_power_rate_ms(&s_power);
+    gps_power_state_t state = s_power.state;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "Power state %d, %s at %u ms", state, on ? "on" : "off", rate);
+    if (!on)
+    {
+        gps_set_receiver_power(false);
+        // Close the track segment; the wearer has not moved since
+        xSemaphoreTake(s_track_mutex, portMAX_DELAY);
+        track_flush(&s_track);
+        xSemaphoreGive(s_track_mutex);
+        return;
+    }
+    if (!was_on)
+    {
+        gps_set_receiver_power(true);
+        vTaskDelay(pdMS_TO_TICKS(GPS_WAKE_MS));
+        // Whatever arrived while it slept is stale
+        uart_flush_input(GPS_UART_NUM);
+        xQueueReset(s_uart_queue);
+        nmea_init(&s_parser);
+    }
+    gps_set_rate(rate);
+}
+
+static void gps_publish(uint32_t done, int64_t now)
+{
+    const nmea_fix_t *f = &s_parser.fix;
+    gps_data_t d;
+
+    portENTER_CRITICAL(&s_lock);
+    d = s_data;
+    portEXIT_CRITICAL(&s_lock);
+
+    // Validity follows whichever position sentence came last
+    if (done & NMEA_RMC)
+        d.valid = f->has_position && f->rmc_valid;
+    if (done & NMEA_GGA)
+        d.valid = f->has_position && f->quality > 0;
+
+    d.lat_e7 = f->lat_e7;
+    d.lon_e7 = f->lon_e7;
+    d.latitude = f->lat_e7 / 1e7f;
+    d.longitude = f->lon_e7 / 1e7f;
+    d.altitude_m = f->alt_cm / 100.0f;
+    d.speed_kmh = f->speed_mm_s * 0.0036f;
+    d.course_deg = f->course_cdeg / 100.0f;
+    d.hdop = f->hdop_c / 100.0f;
+    d.fix_quality = f->quality;
+    d.fix_type = f->fix_type;
+    d.satellites = f->satellites;
+    d.utc_ms = f->utc_ms;
+    d.date = f->date;
+    d.timestamp_us = now;
+
+    portENTER_CRITICAL(&s_lock);
+    s_data = d;
+    s_stats.fixes++;
+    bool reconfigure = false;
+    if (done & NMEA_RMC)
+        reconfigure = gps_power_on_fix(&s_power, now / 1000, d.valid, d.lat_e7, d.lon_e7, f->speed_mm_s);
+    portEXIT_CRITICAL(&s_lock);
+
+    // GGA and RMC of one epoch carry the same position; record it once
+    if (done & NMEA_RMC)
+        gps_record(&d);
+    if (reconfigure)
+        gps_apply_power(true);
+}
+
+static void gps_task(void *arg)
+{
+    uart_event_t ev;
+    uint8_t buf[GPS_READ_CHUNK];
+
+    gps_apply_power(true);
+
+    while (1)
+    {
+        // Times out so the policy can wake a sleeping receiver
+        bool got = xQueueReceive(s_uart_queue, &ev, pdMS_TO_TICKS(GPS_TICK_MS)) == pdTRUE;
+
+        portENTER_CRITICAL(&s_lock);
+        bool was_on = gps_power_on(&s_power);
+        bool reconfigure = gps_power_tick(&s_power, esp_timer_get_time() / 1000);
+        portEXIT_CRITICAL(&s_lock);
+        if (reconfigure)
+        {
+            gps_apply_power(was_on);
+            continue;
+        }
+        if (!got)
+            continue;
+
+        switch (ev.type)
+        {
+        case UART_DATA:
+        {
+            // Parsed straight out of the read buffer, a chunk at a time
+            size_t left = ev.size;
+            while (left > 0)
+            {
+                int n = uart_read_bytes(GPS_UART_NUM, buf, left < sizeof(buf) ? left : sizeof(buf), 0);
+                if (n <= 0)
+                    break;
+                left -= n;
+                uint32_t done = nmea_feed(&s_parser, buf, n);
+                if (done & (NMEA_GGA | NMEA_RMC))
+                    gps_publish(done, esp_timer_get_time());
+            }
+            break;
+        }
+
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // The sentence in progress is lost; the parser resyncs on the next '$'
+            ESP_LOGW(TAG, "UART overflow, dropping buffered data");
+            uart_flush_input(GPS_UART_NUM);
+            xQueueReset(s_uart_queue);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.uart_overflows++;
+            portEXIT_CRITICAL(&s_lock);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void gps_init(void)
+{
+    if (s_task)
+        return;
+
+    const uart_config_t cfg = {
+        .baud_rate = GPS_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+#if GPS_POWER_GPIO >= 0
+    const gpio_config_t io = {
+        .pin_bit_mask = 1ULL << GPS_POWER_GPIO,
+        .mode = GPIO_MODE_OUTPUT,
+    };
+    gpio_config(&io);
+    gpio_set_level(GPS_POWER_GPIO, 1);
+#endif
+
+    esp_err_t err = uart_driver_install(GPS_UART_NUM, GPS_UART_RX_BUF, 0, GPS_UART_QUEUE_LEN, &s_uart_queue, 0);
+    if (err == ESP_OK)
+        err = uart_param_config(GPS_UART_NUM, &cfg);
+    if (err == ESP_OK)
+        err = uart_set_pin(GPS_UART_NUM, GPS_UART_TX_IO, GPS_UART_RX_IO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "UART setup failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    nmea_init(&s_parser);
+    track_init(&s_track);
+    s_track_mutex = xSemaphoreCreateMutex();
+    geofence_init(&s_fence);
+    s_fence_mutex = xSemaphoreCreateMutex();
+    gps_power_init(&s_power, esp_timer_get_time() / 1000);
+    if (xTaskCreate(gps_task, "gps", GPS_TASK_STACK, NULL, GPS_TASK_PRIO, &s_task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create GPS task");
+        return;
+    }
+    ESP_LOGI(TAG, "Listening on UART%d at %d baud", GPS_UART_NUM, GPS_UART_BAUD);
+}
+
+void gps_get_data(gps_data_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_data;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void gps_get_stats(gps_stats_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    out->power_state = s_power.state;
+    gps_power_get_stats(&s_power, esp_timer_get_time() / 1000, &out->power);
+    portEXIT_CRITICAL(&s_lock);
+    // Parser counters are only written by the GPS task
+    out->nmea = s_parser.stats;
+
+    if (s_track_mutex)
+    {
+        xSemaphoreTake(s_track_mutex, portMAX_DELAY);
+        out->track = s_track.stats;
+        xSemaphoreGive(s_track_mutex);
+    }
+}
+
+bool gps_track_ready(void)
+{
+    if (!s_track_mutex)
+        return false;
+
+    xSemaphoreTake(s_track_mutex, portMAX_DELAY);
+    bool ready = track_batch_ready(&s_track, gps_track_now_ms());
+    xSemaphoreGive(s_track_mutex);
+    return ready;
+}
+
+size_t gps_take_track(uint8_t *out, size_t max, uint16_t *points)
+{
+    if (!s_track_mutex)
+        return 0;
+
+    xSemaphoreTake(s_track_mutex, portMAX_DELAY);
+    size_t len = 0;
+    if (track_batch_ready(&s_track, gps_track_now_ms()))
+        len = track_take_batch(&s_track, out, max, points);
+    xSemaphoreGive(s_track_mutex);
+    return len;
 }
 
-void gps_update(void) {
-    
+int gps_set_geofences(const char *text)
+{
+    if (!s_fence_mutex)
+        return -1;
+
+    // Built aside so a bad config leaves the current zones in place
+    geofence_t *g = malloc(sizeof(*g));
+    if (!g)
+        return -1;
+    geofence_init(g);
+    int n = geofence_load(g, text);
+    if (n >= 0)
+    {
+        xSemaphoreTake(s_fence_mutex, portMAX_DELAY);
+        s_fence = *g;
+        xSemaphoreGive(s_fence_mutex);
+        // Leaving a zone must not wait out a long sleep
+        portENTER_CRITICAL(&s_lock);
+        gps_power_set_fenced(&s_power, n > 0);
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "%d geofence zone(s) loaded", n);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Invalid geofence config");
+    }
+    free(g);
+    return n;
 }
 
-void gps_get_data(gps_data_t *out) {
+bool gps_peek_geofence_event(geofence_event_t *out, uint32_t *id)
+{
+    bool ok = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_fence_count > 0)
+    {
+        *out = s_fence_events[s_fence_head];
+        *id = s_fence_popped;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ok;
+}
 
-}
\ No newline at end of file
+void gps_ack_geofence_event(uint32_t id)
+{
+    portENTER_CRITICAL(&s_lock);
+    // Already gone if the queue overflowed since the peek
+    if (s_fence_count > 0 && s_fence_popped == id)
+    {
+        s_fence_head = (s_fence_head + 1) % GPS_FENCE_EVENTS;
+        s_fence_count--;
+        s_fence_popped++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,395 @@
+#include "nmea_parser.h"
+#include <string.h>
+
+enum {
+    NMEA_S_IDLE,
+    NMEA_S_TAG,
+    NMEA_S_FIELDS,
+    NMEA_S_SUM_HI,
+    NMEA_S_SUM_LO,
+};
+
+// pend_mask bits: which members the sentence in progress has supplied
+#define F_TIME    (1u << 0)
+#define F_LAT     (1u << 1)
+#define F_LON     (1u << 2)
+#define F_SOUTH   (1u << 3)
+#define F_WEST    (1u << 4)
+#define F_ALT     (1u << 5)
+#define F_QUALITY (1u << 6)
+#define F_SATS    (1u << 7)
+#define F_HDOP    (1u << 8)
+#define F_PDOP    (1u << 9)
+#define F_VDOP    (1u << 10)
+#define F_FIXTYPE (1u << 11)
+#define F_SPEED   (1u << 12)
+#define F_COURSE  (1u << 13)
+#define F_DATE    (1u << 14)
+#define F_STATUS  (1u << 15)
+#define F_RANGE   (1u << 16) // a field was out of range; the sentence is dropped
+
+#define NMEA_MAX_DIGITS 12 // more than any field we read; later digits are dropped
+#define NMEA_MAX_VALUE  1000000000000LL // bound on scaled values, keeps unit conversions in int64_t
+
+static const int64_t s_pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000};
+
+void nmea_init(nmea_parser_t *p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+// Field value with exactly dec decimals; extra digits are truncated
+static int64_t field_scaled(const nmea_field_t *f, int dec)
+{
+    int64_t v = f->mant;
+    int diff = dec - f->frac;
+    // dec is at most 5 and frac at most NMEA_MAX_DIGITS
+    while (diff < -7)
+    {
+        v /= s_pow10[7];
+        diff += 7;
+    }
+    v = diff >= 0 ? v * s_pow10[diff] : v / s_pow10[-diff];
+    if (v > NMEA_MAX_VALUE)
+        v = NMEA_MAX_VALUE;
+    return f->neg ? -v : v;
+}
+
+static uint32_t range_bit(bool ok)
+{
+    return ok ? 0 : F_RANGE;
+}
+
+// ddmm.mmmmm -> degrees * 1e7, -1 if negative or the minutes reach 60
+static int64_t field_angle_e7(const nmea_field_t *f)
+{
+    int64_t v = field_scaled(f, 5);
+    int64_t deg = v / 10000000;
+    int64_t min_e5 = v % 10000000;
+    if (v < 0 || min_e5 >= 6000000)
+        return -1;
+    return deg * 10000000 + (min_e5 * 100 + 30) / 60;
+}
+
+// hhmmss.sss -> milliseconds of the day, -1 if not a time (ss 60 is a leap second)
+static int64_t field_time_ms(const nmea_field_t *f)
+{
+    int64_t v = field_scaled(f, 3);
+    int64_t hh = v / 10000000;
+    int64_t mm = v / 100000 % 100;
+    int64_t ss = v / 1000 % 100;
+    if (v < 0 || hh > 23 || mm > 59 || ss > 60)
+        return -1;
+    return ((hh * 60 + mm) * 60 + ss) * 1000 + v % 1000;
+}
+
+// Knots (scale num/den to mm/s) or 0.01 degree; -1 if out of range
+static int64_t field_speed_mm_s(const nmea_field_t *f, int64_t num, int64_t den)
+{
+    int64_t v = field_scaled(f, 3) * num / den;
+    return v < 0 || v > UINT32_MAX ? -1 : v;
+}
+
+static int64_t field_course_cdeg(const nmea_field_t *f)
+{
+    int64_t v = field_scaled(f, 2);
+    if (v == 36000)
+        return 0;
+    return v < 0 || v > 36000 ? -1 : v;
+}
+
+static uint16_t field_u16(int64_t v)
+{
+    return v < 0 ? 0 : (v > UINT16_MAX ? UINT16_MAX : (uint16_t)v);
+}
+
+static void nmea_field_done(nmea_parser_t *p)
+{
+    const nmea_field_t *f = &p->field;
+    nmea_fix_t *d = &p->pend;
+    bool num = f->digits > 0;
+    int64_t v;
+
+    switch (p->type)
+    {
+    case NMEA_GGA:
+        switch (p->field_idx)
+        {
+        case 1: if (num) { v = field_time_ms(f); d->utc_ms = (uint32_t)v; p->pend_mask |= F_TIME | range_bit(v >= 0); } break;
+        case 2: if (num) { v = field_angle_e7(f); d->lat_e7 = (int32_t)v; p->pend_mask |= F_LAT | range_bit(v >= 0 && v <= 900000000); } break;
+        case 3: if (f->letter == 'S') p->pend_mask |= F_SOUTH; break;
+        case 4: if (num) { v = field_angle_e7(f); d->lon_e7 = (int32_t)v; p->pend_mask |= F_LON | range_bit(v >= 0 && v <= 1800000000); } break;
+        case 5: if (f->letter == 'W') p->pend_mask |= F_WEST; break;
+        case 6: if (num) { d->quality = (uint8_t)f->mant; p->pend_mask |= F_QUALITY | range_bit(f->mant <= 8); } break;
+        case 7: if (num) { v = field_scaled(f, 0); d->satellites = (uint8_t)v; p->pend_mask |= F_SATS | range_bit(v >= 0 && v <= 99); } break;
+        case 8: if (num) { d->hdop_c = field_u16(field_scaled(f, 2)); p->pend_mask |= F_HDOP; } break;
+        case 9: if (num) { v = field_scaled(f, 2); d->alt_cm = (int32_t)v; p->pend_mask |= F_ALT | range_bit(v >= INT32_MIN && v <= INT32_MAX); } break;
+        }
+        break;
+
+    case NMEA_RMC:
+        switch (p->field_idx)
+        {
+        case 1: if (num) { v = field_time_ms(f); d->utc_ms = (uint32_t)v; p->pend_mask |= F_TIME | range_bit(v >= 0); } break;
+        case 2: d->rmc_valid = f->letter == 'A'; p->pend_mask |= F_STATUS; break;
+        case 3: if (num) { v = field_angle_e7(f); d->lat_e7 = (int32_t)v; p->pend_mask |= F_LAT | range_bit(v >= 0 && v <= 900000000); } break;
+        case 4: if (f->letter == 'S') p->pend_mask |= F_SOUTH; break;
+        case 5: if (num) { v = field_angle_e7(f); d->lon_e7 = (int32_t)v; p->pend_mask |= F_LON | range_bit(v >= 0 && v <= 1800000000); } break;
+        case 6: if (f->letter == 'W') p->pend_mask |= F_WEST; break;
+        case 7: if (num) { v = field_speed_mm_s(f, 514444, 1000000); d->speed_mm_s = (uint32_t)v; p->pend_mask |= F_SPEED | range_bit(v >= 0); } break;
+        case 8: if (num) { v = field_course_cdeg(f); d->course_cdeg = (uint16_t)v; p->pend_mask |= F_COURSE | range_bit(v >= 0); } break;
+        case 9: if (num) { v = field_scaled(f, 0); d->date = (uint32_t)v; p->pend_mask |= F_DATE | range_bit(v >= 10100 && v <= 311299); } break;
+        }
+        break;
+
+    case NMEA_VTG:
+        switch (p->field_idx)
+        {
+        case 1: if (num) { v = field_course_cdeg(f); d->course_cdeg = (uint16_t)v; p->pend_mask |= F_COURSE | range_bit(v >= 0); } break;
+        case 5: if (num) { v = field_speed_mm_s(f, 514444, 1000000); d->speed_mm_s = (uint32_t)v; p->pend_mask |= F_SPEED | range_bit(v >= 0); } break;
+        case 7: if (num) { v = field_speed_mm_s(f, 10, 36); d->speed_mm_s = (uint32_t)v; p->pend_mask |= F_SPEED | range_bit(v >= 0); } break;
+        }
+        break;
+
+    case NMEA_GSA:
+        switch (p->field_idx)
+        {
+        case 2: if (num) { d->fix_type = (uint8_t)f->mant; p->pend_mask |= F_FIXTYPE | range_bit(f->mant >= 1 && f->mant <= 3); } break;
+        case 15: if (num) { d->pdop_c = field_u16(field_scaled(f, 2)); p->pend_mask |= F_PDOP; } break;
+        case 16: if (num) { d->hdop_c = field_u16(field_scaled(f, 2)); p->pend_mask |= F_HDOP; } break;
+        case 17: if (num) { d->vdop_c = field_u16(field_scaled(f, 2)); p->pend_mask |= F_VDOP; } break;
+        }
+        break;
+    }
+
+    memset(&p->field, 0, sizeof(p->field));
+    p->field_idx++;
+}
+
+static void nmea_commit(nmea_parser_t *p)
+{
+    const nmea_fix_t *d = &p->pend;
+    nmea_fix_t *fix = &p->fix;
+    uint32_t m = p->pend_mask;
+
+    if ((m & F_LAT) && (m & F_LON))
+    {
+        fix->lat_e7 = (m & F_SOUTH) ? -d->lat_e7 : d->lat_e7;
+        fix->lon_e7 = (m & F_WEST) ? -d->lon_e7 : d->lon_e7;
+        fix->has_position = true;
+    }
+    if (m & F_TIME)
+        fix->utc_ms = d->utc_ms;
+    if (m & F_ALT)
+        fix->alt_cm = d->alt_cm;
+    if (m & F_QUALITY)
+        fix->quality = d->quality;
+    if (m & F_SATS)
+        fix->satellites = d->satellites;
+    if (m & F_HDOP)
+        fix->hdop_c = d->hdop_c;
+    if (m & F_PDOP)
+        fix->pdop_c = d->pdop_c;
+    if (m & F_VDOP)
+        fix->vdop_c = d->vdop_c;
+    if (m & F_FIXTYPE)
+        fix->fix_type = d->fix_type;
+    if (m & F_SPEED)
+        fix->speed_mm_s = d->speed_mm_s;
+    if (m & F_COURSE)
+        fix->course_cdeg = d->course_cdeg;
+    if (m & F_DATE)
+        fix->date = d->date;
+    if (m & F_STATUS)
+        fix->rmc_valid = d->rmc_valid;
+}
+
+static uint8_t nmea_type(const char *tag)
+{
+    // tag[0..1] is the talker; any is accepted
+    const char *t = tag + 2;
+    if (t[0] == 'G' && t[1] == 'G' && t[2] == 'A')
+        return NMEA_GGA;
+    if (t[0] == 'R' && t[1] == 'M' && t[2] == 'C')
+        return NMEA_RMC;
+    if (t[0] == 'V' && t[1] == 'T' && t[2] == 'G')
+        return NMEA_VTG;
+    if (t[0] == 'G' && t[1] == 'S' && t[2] == 'A')
+        return NMEA_GSA;
+    return 0;
+}
+
+static int hex_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+static void nmea_start(nmea_parser_t *p)
+{
+    p->state = NMEA_S_TAG;
+    p->type = 0;
+    p->len = 1;
+    p->sum = 0;
+    p->pend_mask = 0;
+    memset(&p->field, 0, sizeof(p->field));
+}
+
+static void nmea_abort(nmea_parser_t *p)
+{
+    p->stats.malformed++;
+    p->state = NMEA_S_IDLE;
+}
+
+static uint32_t nmea_push(nmea_parser_t *p, uint8_t c)
+{
+    if (c == '$')
+    {
+        if (p->state != NMEA_S_IDLE)
+            p->stats.malformed++;
+        nmea_start(p);
+        return 0;
+    }
+    if (p->state == NMEA_S_IDLE)
+        return 0;
+
+    if (c < 0x20 || c > 0x7E)
+    {
+        nmea_abort(p);
+        return 0;
+    }
+    // Some proprietary sentences run past the limit; only ours must not
+    if (++p->len > NMEA_MAX_SENTENCE - 2)
+    {
+        if (p->state == NMEA_S_FIELDS && !p->type)
+        {
+            p->stats.ignored++;
+            p->state = NMEA_S_IDLE;
+        }
+        else
+        {
+            nmea_abort(p);
+        }
+        return 0;
+    }
+
+    switch (p->state)
+    {
+    case NMEA_S_TAG:
+        if (c == ',')
+        {
+            if (p->len != 7)
+            {
+                nmea_abort(p);
+                return 0;
+            }
+            p->type = nmea_type(p->tag);
+            p->field_idx = 1;
+            p->sum ^= c;
+            p->state = NMEA_S_FIELDS;
+            return 0;
+        }
+        if (p->len > 6)
+        {
+            nmea_abort(p);
+            return 0;
+        }
+        p->tag[p->len - 2] = (char)c;
+        p->sum ^= c;
+        return 0;
+
+    case NMEA_S_FIELDS:
+        if (c == '*')
+        {
+            nmea_field_done(p);
+            p->state = NMEA_S_SUM_HI;
+            return 0;
+        }
+        p->sum ^= c;
+        if (c == ',')
+        {
+            nmea_field_done(p);
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            nmea_field_t *f = &p->field;
+            if (f->digits < NMEA_MAX_DIGITS)
+            {
+                f->mant = f->mant * 10 + (c - '0');
+                f->digits++;
+                if (f->point)
+                    f->frac++;
+            }
+        }
+        else if (c == '.')
+        {
+            p->field.point = true;
+        }
+        else if (c == '-' && p->field.digits == 0)
+        {
+            p->field.neg = true;
+        }
+        else if (!p->field.letter)
+        {
+            p->field.letter = (char)c;
+        }
+        return 0;
+
+    case NMEA_S_SUM_HI:
+    {
+        int v = hex_value(c);
+        if (v < 0)
+        {
+            nmea_abort(p);
+            return 0;
+        }
+        p->expect_sum = (uint8_t)(v << 4);
+        p->state = NMEA_S_SUM_LO;
+        return 0;
+    }
+
+    case NMEA_S_SUM_LO:
+    {
+        int v = hex_value(c);
+        p->state = NMEA_S_IDLE;
+        if (v < 0)
+        {
+            p->stats.malformed++;
+            return 0;
+        }
+        if ((p->expect_sum | v) != p->sum)
+        {
+            p->stats.bad_checksum++;
+            return 0;
+        }
+        if (!p->type)
+        {
+            p->stats.ignored++;
+            return 0;
+        }
+        if (p->pend_mask & F_RANGE)
+        {
+            p->stats.malformed++;
+            return 0;
+        }
+        nmea_commit(p);
+        p->stats.sentences++;
+        return p->type;
+    }
+    }
+    return 0;
+}
+
+uint32_t nmea_feed(nmea_parser_t *p, const uint8_t *data, size_t len)
+{
+    uint32_t done = 0;
+    for (size_t i = 0; i < len; i++)
+        done |= nmea_push(p, data[i]);
+    p->stats.bytes += len;
+    return done;
+}
@@ -0,0 +1,156 @@
+#include "track_recorder.h"
+#include <math.h>
+#include <string.h>
+
+#define TRACK_M_PER_E7 0.011131949f // metres per 1e-7 degree of latitude
+
+void track_init(track_recorder_t *t)
+{
+    memset(t, 0, sizeof(*t));
+}
+
+static size_t put_zigzag(uint8_t *out, int64_t v)
+{
+    uint64_t u = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    size_t n = 0;
+    while (u >= 0x80)
+    {
+        out[n++] = (uint8_t)(u | 0x80);
+        u >>= 7;
+    }
+    out[n++] = (uint8_t)u;
+    return n;
+}
+
+static void track_write(track_recorder_t *t, const track_point_t *p)
+{
+    if (t->batch_len + TRACK_POINT_MAX_BYTES > TRACK_BATCH_BYTES)
+    {
+        t->stats.dropped++;
+        return;
+    }
+
+    // 1e-6 degree (~11 cm) is well below what the receiver resolves
+    int32_t lat = (p->lat_e7 + (p->lat_e7 >= 0 ? 5 : -5)) / 10;
+    int32_t lon = (p->lon_e7 + (p->lon_e7 >= 0 ? 5 : -5)) / 10;
+    int64_t tds = p->time_ms / 100;
+
+    uint8_t *out = t->batch;
+    if (t->batch_len == 0)
+    {
+        out[t->batch_len++] = TRACK_FORMAT_VERSION;
+        t->batch_len += put_zigzag(out + t->batch_len, lat);
+        t->batch_len += put_zigzag(out + t->batch_len, lon);
+        t->batch_len += put_zigzag(out + t->batch_len, tds);
+        t->batch_start_ms = p->time_ms;
+    }
+    else
+    {
+        t->batch_len += put_zigzag(out + t->batch_len, (int64_t)lat - t->prev_lat_e6);
+        t->batch_len += put_zigzag(out + t->batch_len, (int64_t)lon - t->prev_lon_e6);
+        t->batch_len += put_zigzag(out + t->batch_len, tds - t->prev_time_ds);
+    }
+
+    t->prev_lat_e6 = lat;
+    t->prev_lon_e6 = lon;
+    t->prev_time_ds = tds;
+    t->batch_points++;
+    t->stats.kept++;
+}
+
+static void track_keep(track_recorder_t *t, const track_point_t *p)
+{
+    track_write(t, p);
+    t->anchor = *p;
+    t->anchor_cos = cosf(p->lat_e7 * (float)(M_PI / 180.0 / 1e7));
+    t->have_anchor = true;
+    t->window_len = 0;
+}
+
+// Distance in metres from q to the segment anchor -> p, in a flat
+// projection around the anchor
+static float track_deviation(const track_recorder_t *t, const track_point_t *p, const track_point_t *q)
+{
+    float kx = TRACK_M_PER_E7 * t->anchor_cos;
+    float px = (p->lon_e7 - t->anchor.lon_e7) * kx;
+    float py = (p->lat_e7 - t->anchor.lat_e7) * TRACK_M_PER_E7;
+    float qx = (q->lon_e7 - t->anchor.lon_e7) * kx;
+    float qy = (q->lat_e7 - t->anchor.lat_e7) * TRACK_M_PER_E7;
+
+    float len2 = px * px + py * py;
+    float u = len2 > 0.0f ? (qx * px + qy * py) / len2 : 0.0f;
+    if (u < 0.0f)
+        u = 0.0f;
+    else if (u > 1.0f)
+        u = 1.0f;
+    float dx = qx - u * px;
+    float dy = qy - u * py;
+    return sqrtf(dx * dx + dy * dy);
+}
+
+void track_add(track_recorder_t *t, const track_point_t *p)
+{
+    t->stats.fixes++;
+    if (!t->have_anchor)
+    {
+        track_keep(t, p);
+        return;
+    }
+
+    bool fits = t->window_len < TRACK_WINDOW && p->time_ms - t->anchor.time_ms <= TRACK_MAX_GAP_MS;
+    for (int i = 0; fits && i < t->window_len; i++)
+    {
+        if (track_deviation(t, p, &t->window[i]) > TRACK_TOLERANCE_M)
+            fits = false;
+    }
+
+    if (fits)
+    {
+        t->window[t->window_len++] = *p;
+        return;
+    }
+
+    if (t->window_len == 0)
+    {
+        track_keep(t, p);
+        return;
+    }
+
+    // The segment ends at the last fix that still fit; p opens the next one
+    track_point_t last = t->window[t->window_len - 1];
+    track_keep(t, &last);
+    t->window[t->window_len++] = *p;
+}
+
+void track_flush(track_recorder_t *t)
+{
+    if (t->window_len > 0)
+    {
+        track_point_t last = t->window[t->window_len - 1];
+        track_keep(t, &last);
+    }
+}
+
+bool track_batch_ready(const track_recorder_t *t, int64_t now_ms)
+{
+    if (t->batch_points == 0)
+        return false;
+    return t->batch_len + TRACK_POINT_MAX_BYTES > TRACK_BATCH_BYTES ||
+           now_ms - t->batch_start_ms >= TRACK_BATCH_MAX_AGE_MS;
+}
+
+size_t track_take_batch(track_recorder_t *t, uint8_t *out, size_t max, uint16_t *points)
+{
+    size_t len = t->batch_len;
+    if (len == 0 || len > max)
+        return 0;
+
+    memcpy(out, t->batch, len);
+    if (points)
+        *points = t->batch_points;
+    t->stats.batches++;
+    t->stats.bytes += len;
+    t->batch_len = 0;
+    t->batch_points = 0;
+    return len;
+}
@@ -0,0 +1,199 @@
+// Host check of the fixed-point PPG front end against a double-precision
+// reference of the same DC blocker and band-pass cascade, designed from the
+// corner frequencies rather than copied from the Q30 tables. Also times
+// ppg_dsp_process(). Exits non-zero when a rate falls below the bounds.
+#include "ppg_dsp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DC_CORNER_HZ 0.08
+#define HP_CORNER_HZ 0.5
+#define LP_CORNER_HZ 4.0
+#define TRACE_S      120
+#define MIN_SNR_DB   65.0 // reference AC power over fixed-point error power
+#define MAX_COEF_LSB 2    // Q30 LSBs between the table and the design
+#define BENCH_SAMPLES 2000000
+
+typedef struct {
+    double b0, b1, b2, a1, a2;
+    double x1, x2, y1, y2;
+} ref_biquad_t;
+
+typedef struct {
+    double pole;
+    double x_prev, y_prev;
+    bool seeded;
+    ref_biquad_t bq[PPG_DSP_SECTIONS];
+} ref_channel_t;
+
+// RBJ cookbook, Q = 1/sqrt(2), normalised by a0
+static void design_biquad(ref_biquad_t *b, double fs, double f0, bool high_pass)
+{
+    double w0 = 2.0 * M_PI * f0 / fs;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2.0 * M_SQRT1_2);
+    double a0 = 1.0 + alpha;
+    double k = high_pass ? (1.0 + cw) / 2.0 : (1.0 - cw) / 2.0;
+
+    b->b0 = k / a0;
+    b->b1 = (high_pass ? -2.0 * k : 2.0 * k) / a0;
+    b->b2 = k / a0;
+    b->a1 = -2.0 * cw / a0;
+    b->a2 = (1.0 - alpha) / a0;
+    b->x1 = b->x2 = b->y1 = b->y2 = 0.0;
+}
+
+static void ref_init(ref_channel_t *ch, double fs)
+{
+    ch->pole = 1.0 - 2.0 * M_PI * DC_CORNER_HZ / fs;
+    ch->x_prev = ch->y_prev = 0.0;
+    ch->seeded = false;
+    design_biquad(&ch->bq[0], fs, HP_CORNER_HZ, true);
+    design_biquad(&ch->bq[1], fs, LP_CORNER_HZ, false);
+}
+
+// Same structure and start-up seeding as channel_step(), in counts
+static double ref_step(ref_channel_t *ch, double x)
+{
+    if (!ch->seeded)
+    {
+        ch->x_prev = x;
+        ch->seeded = true;
+    }
+    double y = x - ch->x_prev + ch->pole * ch->y_prev;
+    ch->x_prev = x;
+    ch->y_prev = y;
+
+    for (int i = 0; i < PPG_DSP_SECTIONS; i++)
+    {
+        ref_biquad_t *b = &ch->bq[i];
+        double out = b->b0 * y + b->b1 * b->x1 + b->b2 * b->x2 - b->a1 * b->y1 - b->a2 * b->y2;
+        b->x2 = b->x1;
+        b->x1 = y;
+        b->y2 = b->y1;
+        b->y1 = out;
+        y = out;
+    }
+    return -y;
+}
+
+static uint32_t s_rng = 12345;
+
+// Uniform in [-1, 1), deterministic so runs are comparable
+static double noise(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (double)(s_rng >> 8) / (double)(1u << 23) - 1.0;
+}
+
+// Wrist-like IR trace: DC, 72 bpm pulse with a dicrotic harmonic, breathing
+// wander and sensor noise. Absorption rises in systole, so the pulse dips.
+static uint16_t synth_ir(double t)
+{
+    double beat = 2.0 * M_PI * 1.2 * t;
+    double v = 20000.0 - 180.0 * sin(beat) - 60.0 * sin(2.0 * beat + 0.8) + 120.0 * sin(2.0 * M_PI * 0.25 * t) +
+               4.0 * noise();
+    return (uint16_t)lround(v);
+}
+
+static int coef_lsb_error(const ppg_biquad_coeffs_t *q, const ref_biquad_t *r)
+{
+    const double one = (double)(1 << 30);
+    long err[5] = {
+        labs(q->b0 - lround(r->b0 * one)), labs(q->b1 - lround(r->b1 * one)), labs(q->b2 - lround(r->b2 * one)),
+        labs(q->a1 - lround(r->a1 * one)), labs(q->a2 - lround(r->a2 * one)),
+    };
+    long worst = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        if (err[i] > worst)
+            worst = err[i];
+    }
+    return (int)worst;
+}
+
+static bool compare_rate(uint32_t fs)
+{
+    const ppg_dsp_config_t *cfg = ppg_dsp_config_for_rate(fs);
+    if (!cfg)
+    {
+        printf("%3lu Hz: no coefficient set\n", (unsigned long)fs);
+        return false;
+    }
+
+    ppg_dsp_t dsp;
+    ppg_dsp_init(&dsp, cfg);
+    ref_channel_t ref;
+    ref_init(&ref, fs);
+
+    int coef_err = 0;
+    for (int i = 0; i < PPG_DSP_SECTIONS; i++)
+    {
+        int e = coef_lsb_error(&cfg->bp[i], &ref.bq[i]);
+        if (e > coef_err)
+            coef_err = e;
+    }
+    int pole_err = abs(cfg->dc_pole_q15 - (int)lround(ref.pole * 32768.0));
+
+    s_rng = 12345;
+    double sig = 0.0, err = 0.0, worst = 0.0;
+    uint32_t n = fs * TRACE_S;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint16_t ir = synth_ir((double)i / fs);
+        ppg_dsp_out_t o;
+        ppg_dsp_process(&dsp, ir, ir, &o);
+        double want = ref_step(&ref, ir);
+        double got = o.ir_ac / 256.0;
+        double d = fabs(got - want);
+        sig += want * want;
+        err += d * d;
+        if (d > worst)
+            worst = d;
+    }
+
+    double snr = err > 0.0 ? 10.0 * log10(sig / err) : INFINITY;
+    bool ok = snr >= MIN_SNR_DB && coef_err <= MAX_COEF_LSB && pole_err <= 1;
+    printf("%3lu Hz: coef %d LSB, pole %d LSB, max error %.4f counts, rms error %.4f counts, SNR %.1f dB, hr %d bpm %s\n",
+           (unsigned long)fs, coef_err, pole_err, worst, sqrt(err / n), snr, ppg_dsp_heart_rate(&dsp),
+           ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static void bench(void)
+{
+    static uint16_t trace[1000];
+    for (int i = 0; i < 1000; i++)
+        trace[i] = synth_ir(i / 100.0);
+
+    ppg_dsp_t dsp;
+    ppg_dsp_init(&dsp, ppg_dsp_config_for_rate(100));
+    ppg_dsp_out_t o;
+    uint32_t beats = 0;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint16_t s = trace[i % 1000];
+        ppg_dsp_process(&dsp, s, s, &o);
+        beats += o.beat;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    printf("ppg_dsp_process: %.1f ns/sample (IR + red), %.2f Msamples/s, %lu beats\n", ns / BENCH_SAMPLES,
+           BENCH_SAMPLES / ns * 1e3, (unsigned long)beats);
+}
+
+int main(void)
+{
+    static const uint32_t rates[] = {50, 100, 167, 200};
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+        ok &= compare_rate(rates[i]);
+    bench();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,114 @@
+// Host simulation of the respiratory-rate estimator. Builds per-beat
+// baseline, amplitude and interval series modulated by breathing at a known
+// rate, feeds them to resp_add_beat() like health_on_beat() does and
+// compares every estimate made after the first full window. A noise-only
+// run must stay unknown. Exits non-zero when a case misses its bound.
+#include "resp_rate.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SIM_S       180
+#define DC_Q8       (20000 << 8) // IR baseline
+#define AMP_Q8      (300 << 8)   // pulse amplitude
+#define MAX_ERR_BPM 1
+
+typedef struct {
+    double breaths_bpm;  // 0 = no breathing modulation
+    double hr_bpm;
+    double riiv, riav, rifv; // relative modulation depths
+} resp_case_t;
+
+typedef struct {
+    int estimates;
+    int unknown;
+    int worst_err;
+    double eval_us; // mean cost of a call that ran the estimate
+} resp_outcome_t;
+
+static uint32_t s_rng;
+
+// Uniform in [-1, 1)
+static double noise(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return (double)(s_rng >> 8) / (double)(1u << 23) - 1.0;
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static resp_outcome_t run(const resp_case_t *c)
+{
+    resp_rate_t r;
+    resp_init(&r);
+    resp_outcome_t o = {0};
+    double eval_total = 0.0;
+    double t = 0.0;
+    s_rng = 7;
+
+    while (t < SIM_S)
+    {
+        double phase = 2.0 * M_PI * c->breaths_bpm / 60.0 * t;
+        double breath = c->breaths_bpm > 0.0 ? sin(phase) : 0.0;
+        double rr = 60.0 / c->hr_bpm * (1.0 + c->rifv * breath + 0.02 * noise());
+        t += rr;
+
+        int32_t baseline = (int32_t)(DC_Q8 * (1.0 + c->riiv * breath + 0.001 * noise()));
+        int32_t amplitude = (int32_t)(AMP_Q8 * (1.0 + c->riav * cos(phase) + 0.03 * noise()));
+        double t0 = now_us();
+        bool evaluated = resp_add_beat(&r, (int64_t)(t * 1e6), baseline, amplitude, (uint32_t)(rr * 1e6));
+        double spent = now_us() - t0;
+
+        if (!evaluated || t < RESP_WINDOW_S + 5)
+            continue;
+        eval_total += spent;
+        o.estimates++;
+        if (r.rate_bpm == 0)
+        {
+            o.unknown++;
+            continue;
+        }
+        int err = abs(r.rate_bpm - (int)lround(c->breaths_bpm));
+        if (err > o.worst_err)
+            o.worst_err = err;
+    }
+    if (o.estimates)
+        o.eval_us = eval_total / o.estimates;
+    return o;
+}
+
+int main(void)
+{
+    static const resp_case_t cases[] = {
+        {8, 60, 0.004, 0.10, 0.05},  {12, 72, 0.004, 0.10, 0.05}, {16, 72, 0.004, 0.10, 0.05},
+        {20, 90, 0.004, 0.10, 0.04}, {25, 100, 0.003, 0.08, 0.03}, {30, 110, 0.003, 0.08, 0.03},
+        {15, 65, 0.004, 0.0, 0.05},  {15, 65, 0.0, 0.10, 0.05},   {15, 65, 0.004, 0.10, 0.0},
+    };
+    static const resp_case_t quiet = {0, 75, 0, 0, 0};
+    bool ok = true;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        const resp_case_t *c = &cases[i];
+        resp_outcome_t o = run(c);
+        bool pass = o.estimates > 0 && o.unknown == 0 && o.worst_err <= MAX_ERR_BPM;
+        printf("%2.0f br/min at %3.0f bpm (RIIV %.3f RIAV %.2f RIFV %.2f): %d estimates, %d unknown, worst error %d, "
+               "%.1f us/estimate %s\n",
+               c->breaths_bpm, c->hr_bpm, c->riiv, c->riav, c->rifv, o.estimates, o.unknown, o.worst_err, o.eval_us,
+               pass ? "ok" : "FAIL");
+        ok &= pass;
+    }
+
+    resp_outcome_t o = run(&quiet);
+    bool pass = o.unknown == o.estimates;
+    printf("no breathing at %3.0f bpm: %d estimates, %d unknown %s\n", quiet.hr_bpm, o.estimates, o.unknown,
+           pass ? "ok" : "FAIL");
+    ok &= pass;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,231 @@
+// Host replay of RR interval files through the rhythm screen, with beat and
+// episode accuracy against per-beat labels, plus a throughput benchmark.
+// Beats take the same route as in health_tracker (rr_route.h), HRV window
+// included, so the accuracy is that of the firmware path.
+//
+//     rhythm_replay [--min-se PCT] [--min-sp PCT] file...
+//     rhythm_replay --synth > rr.csv
+//
+// One beat per line: "rr[,label]". rr is in ms below 10000, in us otherwise
+// (both occur in exported recordings) and is taken as a beat that passed
+// the signal-quality gate; 0 marks a gap and breaks the chains the way
+// lost lock does on the watch. label is A for atrial fibrillation,
+// anything else counts as non-AF. Lines not starting with a digit are
+// skipped. Exits non-zero when sensitivity or specificity is below the
+// given minimum.
+#include "rr_route.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_BEATS 10000000
+
+typedef struct {
+    uint32_t af_beats, af_flagged;
+    uint32_t other_beats, other_flagged;
+    uint32_t af_episodes, af_detected;
+    uint64_t detect_latency;  // beats from episode start to the flag, detected episodes only
+    uint32_t cleared;
+    uint64_t clear_latency;   // beats from episode end until the flag drops
+    uint32_t false_episodes;  // flag raised while the label was not AF
+    uint32_t hrv_rejected;    // beats the HRV artifact filter dropped
+} rhythm_score_t;
+
+static bool replay_file(const char *path, rhythm_score_t *sc)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    hrv_t h;
+    rhythm_t r;
+    hrv_init(&h);
+    rhythm_init(&r);
+    char line[128];
+    bool in_af = false, detected = false, clearing = false;
+    uint32_t episode_beats = 0, beats = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        if (!isdigit((unsigned char)line[0]))
+            continue;
+        char *p;
+        double rr = strtod(line, &p);
+        bool af = false;
+        if (*p == ',')
+        {
+            while (*++p == ' ')
+                ;
+            af = (*p == 'A' || *p == 'a');
+        }
+
+        if (af && !in_af)
+        {
+            sc->af_episodes++;
+            episode_beats = 0;
+            detected = false;
+        }
+        else if (!af && in_af)
+        {
+            episode_beats = 0;
+            clearing = r.flagged;
+        }
+        in_af = af;
+
+        if (rr <= 0.0)
+        {
+            rr_route_break(&h, &r);
+            continue;
+        }
+        uint32_t rr_us = (uint32_t)lround(rr < 10000.0 ? rr * 1000.0 : rr);
+        rr_route_t route = rr_route_beat(&h, &r, rr_us);
+        sc->hrv_rejected += !route.hrv_accepted;
+        if (route.rhythm_changed && r.flagged && !af && !clearing)
+            sc->false_episodes++;
+        beats++;
+        episode_beats++;
+
+        if (af)
+        {
+            sc->af_beats++;
+            sc->af_flagged += r.flagged;
+            if (r.flagged && !detected)
+            {
+                detected = true;
+                sc->af_detected++;
+                sc->detect_latency += episode_beats;
+            }
+        }
+        else
+        {
+            sc->other_beats++;
+            sc->other_flagged += r.flagged;
+            if (clearing && !r.flagged)
+            {
+                clearing = false;
+                sc->cleared++;
+                sc->clear_latency += episode_beats;
+            }
+        }
+    }
+    fclose(f);
+    printf("%s: %lu beats\n", path, (unsigned long)beats);
+    return true;
+}
+
+static uint32_t s_rng = 5;
+
+static double gauss(void)
+{
+    double u, v;
+    do
+    {
+        s_rng = s_rng * 1664525u + 1013904223u;
+        u = (s_rng >> 8) / 16777216.0;
+        s_rng = s_rng * 1664525u + 1013904223u;
+        v = (s_rng >> 8) / 16777216.0;
+    } while (u <= 0.0);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+// Labelled synthetic series: sinus rhythm with respiratory arrhythmia, AF,
+// noisy sinus with a gap, AF again, and a slow sinus tail
+static void synth(void)
+{
+    static const struct {
+        int beats;
+        char label;
+        double mean, rsa, period, jitter;
+    } seg[] = {
+        {400, 'N', 900, 80, 4.0, 15},
+        {500, 'A', 650, 0, 1, 150},
+        {400, 'N', 800, 20, 9.0, 30},
+        {300, 'A', 720, 0, 1, 180},
+        {200, 'N', 1050, 40, 5.0, 10},
+    };
+
+    printf("# rr_ms,label (synthetic, rhythm_replay --synth)\n");
+    for (size_t s = 0; s < sizeof(seg) / sizeof(seg[0]); s++)
+    {
+        for (int i = 0; i < seg[s].beats; i++)
+        {
+            if (s == 2 && i == 200)
+                printf("0,%c\n", seg[s].label);
+            double rr = seg[s].mean + seg[s].rsa * sin(2.0 * M_PI * i / seg[s].period) + seg[s].jitter * gauss();
+            if (rr < 320.0)
+                rr = 320.0;
+            printf("%.0f,%c\n", rr, seg[s].label);
+        }
+    }
+}
+
+static void bench(void)
+{
+    hrv_t h;
+    rhythm_t r;
+    hrv_init(&h);
+    rhythm_init(&r);
+    uint32_t changes = 0;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < BENCH_BEATS; i++)
+        changes += rr_route_beat(&h, &r, 600000 + (i * 7919u) % 400000).rhythm_changed;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    printf("hrv + rhythm: %.1f ns/beat (%lu flag changes)\n", ns / BENCH_BEATS, (unsigned long)changes);
+}
+
+static double pct(uint32_t num, uint32_t den)
+{
+    return den ? 100.0 * num / den : 100.0;
+}
+
+int main(int argc, char **argv)
+{
+    double min_se = 0.0, min_sp = 0.0;
+    rhythm_score_t sc = {0};
+    bool ok = true;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--synth"))
+        {
+            synth();
+            return EXIT_SUCCESS;
+        }
+        if (!strcmp(argv[i], "--min-se") && i + 1 < argc)
+            min_se = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--min-sp") && i + 1 < argc)
+            min_sp = atof(argv[++i]);
+        else
+        {
+            ok &= replay_file(argv[i], &sc);
+            files++;
+        }
+    }
+
+    if (files)
+    {
+        double se = pct(sc.af_flagged, sc.af_beats);
+        double sp = pct(sc.other_beats - sc.other_flagged, sc.other_beats);
+        printf("AF beats %lu, flagged %.1f %% (sensitivity)\n", (unsigned long)sc.af_beats, se);
+        printf("non-AF beats %lu, unflagged %.1f %% (specificity)\n", (unsigned long)sc.other_beats, sp);
+        printf("AF episodes %lu, detected %lu, mean latency %.0f beats to flag, %.0f beats to clear, false flags %lu\n",
+               (unsigned long)sc.af_episodes, (unsigned long)sc.af_detected,
+               sc.af_detected ? (double)sc.detect_latency / sc.af_detected : 0.0,
+               sc.cleared ? (double)sc.clear_latency / sc.cleared : 0.0, (unsigned long)sc.false_episodes);
+        printf("HRV artifact filter rejected %lu beats\n", (unsigned long)sc.hrv_rejected);
+        ok &= se >= min_se && sp >= min_sp;
+    }
+    bench();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
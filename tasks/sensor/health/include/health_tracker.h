@@ -2,18 +2,87 @@
 
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
+#include "max30100.h"
+#include "hrv.h"
+#include "rhythm.h"
+
+// SpO2 readings below this confidence should not be shown or uploaded
+#define HEALTH_SPO2_MIN_CONFIDENCE 60
+
+// Readings below this signal quality are not shown, charted or sent
+#define HEALTH_SQI_MIN 50
+
+#define HEALTH_RR_RING_SIZE 32 // must be a power of two
 
 typedef struct {
     int heart_rate;
     int spo2;
+    int spo2_confidence; // 0..100
+    int sqi;             // signal quality over the last beats, 0..100
+    int resp_rate;       // breaths per minute, 0 until a window is collected
     bool valid;
+    // Beat these values were produced at: its vitals_store HR sequence
+    // number and esp_timer time; timestamp_ms is 0 before the first one
+    uint32_t seq;
+    uint32_t timestamp_ms;
 } health_data_t;
 
+typedef struct {
+    uint32_t rr_us;       // beat-to-beat interval, sub-sample resolution
+    int64_t timestamp_us; // time of the closing beat
+} health_rr_t;
+
+typedef enum {
+    HEALTH_PROFILE_SPOT,       // 200 Hz, quick lock for on-demand checks
+    HEALTH_PROFILE_CONTINUOUS, // 100 Hz, everyday wear
+    HEALTH_PROFILE_OVERNIGHT,  // 50 Hz, short pulses, lowest LED duty
+    HEALTH_PROFILE_COUNT,
+} health_profile_t;
+
+typedef struct {
+    const char *name;
+    max30100_sampling_rate_t rate;
+    max30100_pulse_width_t pulse_width;
+    max30100_current_t ir_current;  // AGC starting point
+    max30100_current_t red_current;
+} health_profile_cfg_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t cycles_per_sample_avg;
+    uint32_t cycles_per_sample_max;
+    uint32_t led_changes;    // LED current updates made by the AGC
+} health_dsp_stats_t;
+
 
 void health_init(void);
 
 void health_update(void);
 
+// Powers the PPG sensor up or down. Waking restarts the filters, so a
+// fresh reading takes a few beats to lock.
+void health_set_active(bool active);
+
+// Requests an acquisition profile. Rate, pulse width, LED currents and DSP
+// coefficients switch together on the next health_update() or wake-up,
+// without re-initialising the sensor. Readings restart after a switch.
+void health_set_profile(health_profile_t profile);
+
+health_profile_t health_get_profile(void);
+
 void health_get_data(health_data_t *out);
 
+// Pops accepted RR intervals, oldest first. Artifacts rejected by the HRV
+// filter are not reported.
+size_t health_read_rr(health_rr_t *out, size_t max);
+
+// RMSSD/SDNN/pNN50 over the last HRV_WINDOW_BEATS intervals
+void health_get_hrv(hrv_metrics_t *out);
+
+// Irregular-rhythm screening over the same RR stream
+void health_get_rhythm(rhythm_result_t *out);
+
+void health_get_dsp_stats(health_dsp_stats_t *out);
+
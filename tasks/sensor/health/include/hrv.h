@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Time-domain HRV over a sliding window of RR intervals. Every accepted beat
+// updates running sums in O(1), and the window has a fixed size, so RMSSD,
+// SDNN and pNN50 cost the same at any window length. No ESP-IDF
+// dependencies.
+
+#define HRV_WINDOW_BEATS   64
+#define HRV_RR_MIN_US      300000  // 200 bpm
+#define HRV_RR_MAX_US      2000000 // 30 bpm
+#define HRV_ECTOPIC_PCT    25      // change vs the window mean that marks an artifact
+#define HRV_NN50_US        50000
+#define HRV_RESEED_RUN     4       // consecutive artifacts taken as a real rate change
+
+typedef struct {
+    uint32_t rr_us;
+    uint32_t diff_sq_ms2; // (rr - previous rr)^2 in ms^2, 0 without a predecessor
+    bool has_diff;
+    bool nn50;
+} hrv_beat_t;
+
+typedef struct {
+    hrv_beat_t beats[HRV_WINDOW_BEATS];
+    uint16_t head;
+    uint16_t count;
+    bool chained;          // the newest beat can take a successive difference
+
+    int64_t rr_sum;        // us
+    int64_t rr_ms_sum;     // ms, exact integer variance with rr_sq_sum
+    int64_t rr_sq_sum;     // ms^2
+    int64_t diff_sq_sum;   // ms^2
+    uint16_t diffs;
+    uint16_t nn50;
+    uint32_t rejected;
+    uint8_t reject_run;    // consecutive in-range beats rejected against the mean
+    uint32_t reseeds;
+} hrv_t;
+
+typedef struct {
+    float rmssd_ms;
+    float sdnn_ms;
+    uint8_t pnn50_pct;
+    uint16_t beats;        // RR intervals in the window
+} hrv_metrics_t;
+
+void hrv_init(hrv_t *h);
+
+// Adds one RR interval; returns false when it was rejected as an artifact.
+// HRV_RESEED_RUN rejections in a row mean the rate itself has moved (after
+// a gap, standing up, exercise): the window restarts from the new beats.
+bool hrv_add_rr(hrv_t *h, uint32_t rr_us);
+
+// Forgets the beat chain after a gap (lost lock, sensor off) without
+// dropping the window
+void hrv_break(hrv_t *h);
+
+void hrv_get(const hrv_t *h, hrv_metrics_t *out);
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// LED current control for the PPG front end. Each channel's DC level is kept
+// inside a band of the ADC range by stepping its LED current one register
+// step at a time. Currents only rise while DC is below the band, so each
+// channel settles at the lowest current that gives a usable signal, and they
+// drop as soon as DC leaves the top of the band or a sample clips. The band
+// is wider than the largest step ratio, so one step never jumps across it.
+// No ESP-IDF dependencies; steps are MAX30100 LED_CONFIG codes (0..15).
+
+#define LED_AGC_STEPS        16
+#define LED_AGC_LOW_PCT      25 // step up below this share of full scale
+#define LED_AGC_HIGH_PCT     65 // step down above it
+#define LED_AGC_CLIP_PCT     98 // any raw sample above this steps down at once
+#define LED_AGC_CONTACT_PCT  3  // IR DC below this means nothing on the sensor
+#define LED_AGC_PROBE_STEP   2  // current held while there is no contact
+#define LED_AGC_MAX_STEP     (LED_AGC_STEPS - 1)
+#define LED_AGC_SETTLE_MS    500 // hold after a change; the caller rescales the DC tracker
+#define LED_AGC_EVAL_MS      250
+
+typedef struct {
+    uint8_t step;
+    uint16_t peak;   // highest raw sample since the last evaluation
+} led_agc_channel_t;
+
+typedef struct {
+    led_agc_channel_t ir;
+    led_agc_channel_t red;
+    uint32_t low, high, clip, contact; // thresholds in Q8 counts / raw counts
+    uint32_t settle_samples;
+    uint32_t eval_samples;
+    uint32_t countdown;
+    bool contact_ok;
+    uint32_t changes;
+} led_agc_t;
+
+void led_agc_init(led_agc_t *agc, uint32_t full_scale, uint32_t fs_hz, uint8_t ir_step, uint8_t red_step);
+
+// Feeds one sample with the current DC estimates (Q8). Returns true when a
+// step changed; the caller then writes the new currents to the sensor.
+bool led_agc_update(led_agc_t *agc, uint16_t ir_raw, uint16_t red_raw, int32_t ir_dc, int32_t red_dc);
+
+// LED current of a step in 0.1 mA, for rescaling signals across a change
+uint16_t led_agc_current_ma10(uint8_t step);
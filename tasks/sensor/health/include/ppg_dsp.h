@@ -0,0 +1,81 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Streaming fixed-point PPG front end: DC blocker -> band-pass biquad cascade
+// -> adaptive-threshold peak detector. Every stage holds O(1) state and runs
+// one sample at a time. No ESP-IDF dependencies so it also builds on a host.
+//
+// Fixed-point formats:
+//   raw samples      16-bit ADC counts
+//   AC / DC signals  Q8 (counts << 8)
+//   DC blocker pole  Q15
+//   biquad coeffs    Q30, int64 accumulator, rounding error fed back
+
+#define PPG_DSP_SECTIONS 2
+
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;
+} ppg_biquad_coeffs_t;
+
+typedef struct {
+    uint32_t fs_hz;
+    int32_t dc_pole_q15;
+    ppg_biquad_coeffs_t bp[PPG_DSP_SECTIONS];
+} ppg_dsp_config_t;
+
+typedef struct {
+    int32_t x1, x2, y1, y2;
+    int32_t err; // accumulator remainder of the last output, Q30
+} ppg_biquad_state_t;
+
+typedef struct {
+    int32_t x_prev;     // Q8
+    int32_t y_prev;     // Q8
+    int32_t dc;         // Q8, slow mean of the raw signal
+    ppg_biquad_state_t bq[PPG_DSP_SECTIONS];
+} ppg_channel_t;
+
+typedef struct {
+    ppg_dsp_config_t cfg;
+    ppg_channel_t ir;
+    ppg_channel_t red;
+
+    // Peak detector state (operates on inverted band-passed IR)
+    int32_t prev1, prev2;
+    int32_t threshold;
+    int32_t min_amplitude;
+    uint8_t decay_shift;
+    uint32_t sample_idx;
+    uint32_t last_peak_idx;
+    int32_t last_peak_frac_q8; // sub-sample offset of the last peak, -128..128
+    uint32_t refractory;
+    uint32_t max_ibi;
+    uint32_t ibi_avg_q8;
+    bool locked;
+} ppg_dsp_t;
+
+typedef struct {
+    int32_t ir_ac;          // Q8, inverted so systolic peaks are positive
+    int32_t red_ac;         // Q8, same polarity as ir_ac
+    int32_t ir_dc;          // Q8
+    int32_t red_dc;         // Q8
+    bool beat;              // a beat was confirmed on this sample
+    int32_t peak_amplitude; // Q8, valid when beat
+    uint32_t ibi_samples;   // valid when beat and > 0
+    uint32_t ibi_q8;        // interval with parabolic peak refinement, Q8 samples
+} ppg_dsp_out_t;
+
+// Coefficient set for a MAX30100 sample rate (50/100/167/200 Hz), NULL otherwise
+const ppg_dsp_config_t *ppg_dsp_config_for_rate(uint32_t fs_hz);
+
+void ppg_dsp_init(ppg_dsp_t *dsp, const ppg_dsp_config_t *cfg);
+
+void ppg_dsp_process(ppg_dsp_t *dsp, uint16_t ir, uint16_t red, ppg_dsp_out_t *out);
+
+// Scales the filter and detector state by the given gains (Q8, 256 = 1.0)
+// so a step in LED current does not ring through the band-pass
+void ppg_dsp_rescale(ppg_dsp_t *dsp, int32_t ir_q8, int32_t red_q8);
+
+// Averaged heart rate in bpm, 0 when not locked
+int ppg_dsp_heart_rate(const ppg_dsp_t *dsp);
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// PPG signal-quality index. Each beat is scored on three things:
+//   perfusion  IR peak-to-trough AC over DC; a loose finger gives almost none
+//   shape      Pearson correlation with a running beat template; motion
+//              artifacts do not look like the wearer's pulse
+//   clipping   any raw sample at the ADC rails voids the beat
+// Samples are folded into PPG_SQI_POINTS bins as they arrive, scaled by the
+// expected beat length, so memory and per-sample work are fixed. The
+// correlation costs PPG_SQI_POINTS steps once per beat. The per-beat scores
+// are smoothed into a window index. No ESP-IDF dependencies.
+
+#define PPG_SQI_POINTS        32
+#define PPG_SQI_MIN_PI_PPM    2000  // 0.2 % perfusion scores 0
+#define PPG_SQI_GOOD_PI_PPM   10000 // 1 % and above scores full marks
+#define PPG_SQI_MIN_CORR      0.5f  // template correlation that scores 0
+#define PPG_SQI_TEMPLATE_CORR 0.8f  // beats at least this similar refine the template
+
+typedef struct {
+    uint16_t full_scale;
+
+    // Current beat
+    int32_t bins[PPG_SQI_POINTS];
+    uint16_t counts[PPG_SQI_POINTS];
+    uint32_t samples;
+    int32_t ac_min, ac_max;
+    bool clipped;
+
+    float tmpl[PPG_SQI_POINTS];
+    bool have_template;
+
+    uint32_t pi_ppm;   // last beat's perfusion index, parts per million
+    float corr;        // last beat's template correlation
+    int beat_score;
+    int sqi;           // smoothed 0..100
+} ppg_sqi_t;
+
+void ppg_sqi_init(ppg_sqi_t *q, uint16_t full_scale);
+
+// Per sample: raw counts for clip detection, inverted IR AC (Q8) and the
+// expected beat length in samples (0 until the detector has locked)
+void ppg_sqi_add_sample(ppg_sqi_t *q, uint16_t ir_raw, uint16_t red_raw, int32_t ir_ac, uint32_t expected_ibi);
+
+// Closes the current beat; returns the updated window index
+int ppg_sqi_on_beat(ppg_sqi_t *q, int32_t ir_dc);
+
+// Lost lock or sensor off-body: the index decays to 0 and the beat is dropped
+void ppg_sqi_reset_beat(ppg_sqi_t *q);
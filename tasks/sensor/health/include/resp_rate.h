@@ -0,0 +1,46 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Respiratory rate from the three respiratory modulations of the PPG, one
+// value per beat:
+//   RIIV  baseline (DC) intensity
+//   RIAV  pulse amplitude
+//   RIFV  beat-to-beat interval (respiratory sinus arrhythmia)
+// Beats are linearly resampled into a short RESP_FS_HZ buffer. Every
+// RESP_EVAL_MS each series is Hann-windowed and Goertzel-evaluated over the
+// breathing band only. The normalised spectra are then fused: the estimate
+// is reported only when at least two modulations agree on the rate. No
+// ESP-IDF dependencies.
+
+#define RESP_FS_HZ        2
+#define RESP_WINDOW_S     32
+#define RESP_POINTS       (RESP_FS_HZ * RESP_WINDOW_S)
+#define RESP_MIN_BPM      6
+#define RESP_MAX_BPM      40
+#define RESP_EVAL_MS      5000
+#define RESP_AGREE_BPM    4
+#define RESP_QUALITY_MIN  40 // below this the rate is reported as unknown
+#define RESP_SERIES       3
+
+typedef struct {
+    float buf[RESP_SERIES][RESP_POINTS];
+    uint16_t head;
+    uint16_t count;
+
+    bool have_prev;
+    int64_t prev_us;
+    float prev[RESP_SERIES];
+    int64_t next_point_us;  // time of the next resampled point
+
+    int64_t last_eval_us;
+    int rate_bpm;           // 0 while unknown
+    int quality;            // 0..100, share of fused power at the peak
+} resp_rate_t;
+
+// Also used to restart after contact loss or an LED current step; the
+// rate reads 0 until a full window has been collected again
+void resp_init(resp_rate_t *r);
+
+// Adds one beat. Returns true when a new estimate was computed.
+bool resp_add_beat(resp_rate_t *r, int64_t timestamp_us, int32_t baseline, int32_t amplitude, uint32_t rr_us);
@@ -0,0 +1,68 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Irregular-rhythm (AF likelihood) screening on the clean RR stream. It
+// must see ectopic-looking intervals too, so it is fed ahead of the HRV
+// artifact filter (rr_route.h).
+// Over a rolling window of beats it tracks three irregularity measures, each
+// updated in O(1) per beat with fixed memory:
+//   nRMSSD   RMSSD of successive differences normalised by the mean RR
+//   entropy  Shannon entropy of the RR histogram (fixed-width bins)
+//   TPR      turning-point ratio; a random series sits near 2/3
+// The combined score must stay high for RHYTHM_CONFIRM_BEATS before the
+// flag is raised and low for as long before it clears. This is a
+// screening hint, not a diagnosis. No ESP-IDF dependencies.
+
+#define RHYTHM_WINDOW_BEATS  64
+#define RHYTHM_BIN_US        50000
+#define RHYTHM_BIN_BASE_US   300000
+#define RHYTHM_BINS          32
+#define RHYTHM_FLAG_SCORE    60
+#define RHYTHM_CLEAR_SCORE   30
+#define RHYTHM_CONFIRM_BEATS 32
+
+typedef struct {
+    uint32_t rr_us;
+    uint32_t diff_sq_ms2;
+    uint8_t bin;
+    bool has_diff;
+    bool turning;          // this beat is a strict local extremum of its neighbours
+} rhythm_beat_t;
+
+typedef struct {
+    rhythm_beat_t beats[RHYTHM_WINDOW_BEATS];
+    uint16_t head;
+    uint16_t count;
+    bool chained;
+
+    int64_t rr_sum;
+    int64_t diff_sq_sum;
+    uint16_t diffs;
+    uint16_t turning;
+    uint16_t triples;      // beats with both neighbours in the chain
+    uint8_t hist[RHYTHM_BINS];
+    float clogc_sum;       // sum of c * log2(c) over the histogram
+
+    int score;
+    uint16_t streak;       // beats the score has been on the other side
+    bool flagged;
+} rhythm_t;
+
+typedef struct {
+    float nrmssd;
+    float entropy;         // 0..1, normalised by log2(RHYTHM_BINS)
+    float tpr;
+    int score;             // 0..100, valid once the window is full
+    bool flagged;
+} rhythm_result_t;
+
+void rhythm_init(rhythm_t *r);
+
+// Adds one clean RR interval. Returns true when the flag changed state.
+bool rhythm_add_rr(rhythm_t *r, uint32_t rr_us);
+
+// Marks a gap in the beat chain (lost lock, artifact)
+void rhythm_break(rhythm_t *r);
+
+void rhythm_get(const rhythm_t *r, rhythm_result_t *out);
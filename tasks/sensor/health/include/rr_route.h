@@ -0,0 +1,24 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "hrv.h"
+#include "rhythm.h"
+
+// Routes one beat's RR interval to HRV and rhythm screening. The two want
+// different beats: HRV drops ectopic intervals against its window mean,
+// while an irregular rhythm is made of exactly such intervals, so rhythm
+// screening takes every clean, in-range interval regardless of the HRV
+// filter. Shared by health_tracker and the host replay so both run the
+// same gating. No ESP-IDF dependencies.
+
+typedef struct {
+    bool hrv_accepted;   // kept in the HRV window
+    bool rhythm_changed; // the rhythm flag changed state
+} rr_route_t;
+
+// Interval ending a beat that passed the signal-quality gate
+rr_route_t rr_route_beat(hrv_t *h, rhythm_t *r, uint32_t rr_us);
+
+// A poor beat, lost lock or sensor off-body: breaks both chains so no
+// difference spans the gap
+void rr_route_break(hrv_t *h, rhythm_t *r);
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Ratio-of-ratios SpO2 over a sliding window of whole beats. Each sample only
+// adds two squares into the current beat; each beat moves the window by one
+// slot and maps R through an interpolation table generated at compile time.
+// No ESP-IDF dependencies.
+
+#define SPO2_WINDOW_BEATS 4
+
+typedef struct {
+    int64_t ir_ac_sq;  // sum of squared Q8 AC over the beat
+    int64_t red_ac_sq;
+    uint32_t samples;
+    int32_t ir_dc;     // Q8 at the end of the beat
+    int32_t red_dc;
+    int32_t ratio_q12; // per-beat R, for the consistency check
+} spo2_beat_t;
+
+typedef struct {
+    spo2_beat_t cur;
+    spo2_beat_t beats[SPO2_WINDOW_BEATS];
+    uint8_t head;
+    uint8_t count;
+
+    // Running window sums, updated in O(1) per beat
+    int64_t ir_ac_sq, red_ac_sq;
+    uint32_t samples;
+    int64_t ir_dc, red_dc;
+    int32_t ratio_sum;
+    int64_t ratio_sq_sum;
+} spo2_estimator_t;
+
+typedef struct {
+    int spo2;          // percent
+    int confidence;    // 0..100
+    int32_t ratio_q12; // R in Q12
+} spo2_result_t;
+
+void spo2_init(spo2_estimator_t *e);
+
+void spo2_add_sample(spo2_estimator_t *e, int32_t ir_ac, int32_t red_ac);
+
+// Closes the current beat; returns true when out holds a fresh estimate
+bool spo2_on_beat(spo2_estimator_t *e, int32_t ir_dc, int32_t red_dc, spo2_result_t *out);
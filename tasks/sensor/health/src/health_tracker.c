@@ -1,21 +1,106 @@
 #include "health_tracker.h"
 #include "max30100.h"
+#include "ppg_dsp.h"
+#include "spo2_estimator.h"
+#include "led_agc.h"
+#include "hrv.h"
+#include "rhythm.h"
+#include "rr_route.h"
+#include "ppg_sqi.h"
+#include "resp_rate.h"
+#include "sensor_hal.h"
+#include "vitals_store.h"
 #include "i2c_common.h"
 #include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <stdatomic.h>
 
 static const char *TAG = "HEALTH_TRACKER";
 
-static max30100_config_t s_config;
-static health_data_t s_data = {0, 0, false};
+#define HEALTH_DRAIN_CHUNK 32
+
+static health_data_t s_data = {0};
+static ppg_dsp_t s_dsp;
+static spo2_estimator_t s_spo2;
+static health_dsp_stats_t s_dsp_stats;
+static led_agc_t s_agc;
+static hrv_t s_hrv;
+static rhythm_t s_rhythm;
+static ppg_sqi_t s_sqi;
+static resp_rate_t s_resp;
+
+// Per-beat RR intervals: health_update() produces, any one task consumes
+static health_rr_t s_rr_ring[HEALTH_RR_RING_SIZE];
+static atomic_uint s_rr_head = 0;
+static atomic_uint s_rr_tail = 0;
+
+// AGC decision made during a chunk, written once the chunk is done
+static bool s_led_dirty = false;
+static uint8_t s_led_old_ir, s_led_old_red;
+
+// LED change waiting for the first sample taken at the new current
+static bool s_rescale_pending = false;
+static int64_t s_rescale_from_us;
+static int32_t s_rescale_ir_q8, s_rescale_red_q8;
+
+// Allowed SpO2-mode rate/pulse-width pairs per the datasheet
+static const health_profile_cfg_t s_profiles[HEALTH_PROFILE_COUNT] = {
+    [HEALTH_PROFILE_SPOT] = {"spot", MAX30100_SAMPLING_RATE_200HZ, MAX30100_PULSE_WIDTH_800US_ADC_15,
+                             MAX30100_LED_CURRENT_14_2MA, MAX30100_LED_CURRENT_11MA},
+    [HEALTH_PROFILE_CONTINUOUS] = {"continuous", MAX30100_SAMPLING_RATE_100HZ, MAX30100_PULSE_WIDTH_1600US_ADC_16,
+                                   MAX30100_LED_CURRENT_11MA, MAX30100_LED_CURRENT_7_6MA},
+    [HEALTH_PROFILE_OVERNIGHT] = {"overnight", MAX30100_SAMPLING_RATE_50HZ, MAX30100_PULSE_WIDTH_400US_ADC_14,
+                                  MAX30100_LED_CURRENT_11MA, MAX30100_LED_CURRENT_7_6MA},
+};
+
+static health_profile_t s_profile = HEALTH_PROFILE_CONTINUOUS;
+static volatile health_profile_t s_profile_req = HEALTH_PROFILE_CONTINUOUS;
+static int64_t s_profile_from_us = 0; // samples older than this predate the last switch
+
+// Restarts the signal chain for the active profile's rate and currents
+static void health_reset_chain(void)
+{
+    const health_profile_cfg_t *p = &s_profiles[s_profile];
+    uint32_t fs = max30100_sample_rate_hz(p->rate);
+    ppg_dsp_init(&s_dsp, ppg_dsp_config_for_rate(fs));
+    spo2_init(&s_spo2);
+    hrv_init(&s_hrv);
+    rhythm_init(&s_rhythm);
+    resp_init(&s_resp);
+    led_agc_init(&s_agc, max30100_adc_full_scale(p->pulse_width), fs, p->ir_current, p->red_current);
+    ppg_sqi_init(&s_sqi, (uint16_t)max30100_adc_full_scale(p->pulse_width));
+    s_led_dirty = false;
+    s_rescale_pending = false;
+    s_data.valid = false;
+    s_data.spo2_confidence = 0;
+    s_data.sqi = 0;
+    s_data.resp_rate = 0;
+}
 
 void health_init(void)
 {
-    esp_err_t err = max30100_init(
-        &s_config, I2C_NUM_0, MAX30100_MODE_SPO2_HR, MAX30100_SAMPLING_RATE_100HZ,
-        MAX30100_PULSE_WIDTH_1600US_ADC_16, MAX30100_LED_CURRENT_11MA,
-        MAX30100_LED_CURRENT_7_6MA, 15, 10, true, false);
+    const health_profile_cfg_t *p = &s_profiles[s_profile];
+    max30100_config_t cfg = {
+        .mode = MAX30100_MODE_SPO2_HR,
+        .sampling_rate = p->rate,
+        .pulse_width = p->pulse_width,
+        .ir_current = p->ir_current,
+        .red_current = p->red_current,
+        .high_res_mode = true,
+        .int_gpio = MAX30100_INT_GPIO,
+        .int_source = MAX30100_INT_FIFO_ALMOST_FULL,
+    };
+
+    health_reset_chain();
+
+    esp_err_t err = sensor_hal_ppg_init(&cfg);
+    if (err == ESP_OK)
+    {
+        err = sensor_hal_ppg_start();
+    }
 
     if (err != ESP_OK)
     {
@@ -23,29 +108,240 @@ void health_init(void)
     }
 }
 
-void health_update(void)
+void health_set_profile(health_profile_t profile)
+{
+    if (profile < HEALTH_PROFILE_COUNT)
+        s_profile_req = profile;
+}
+
+health_profile_t health_get_profile(void)
+{
+    return s_profile;
+}
+
+// Runs in the context that calls health_update(), so it never races the DSP
+static void health_apply_profile(void)
 {
-    max30100_data_t d;
-    esp_err_t err = max30100_update(&s_config, &d);
+    health_profile_t req = s_profile_req;
+    if (req == s_profile)
+        return;
+
+    const health_profile_cfg_t *p = &s_profiles[req];
+    esp_err_t err = sensor_hal_ppg_set_sampling(p->rate, p->pulse_width);
     if (err == ESP_OK)
+        err = sensor_hal_ppg_set_led_current(p->red_current, p->ir_current);
+    if (err != ESP_OK)
     {
-        s_data.heart_rate = (int)d.heart_bpm;
-        s_data.spo2 = (int)d.spO2;
+        ESP_LOGE(TAG, "Profile %s failed: %s", p->name, esp_err_to_name(err));
+        s_profile_req = s_profile;
+        return;
+    }
+
+    s_profile = req;
+    s_profile_from_us = esp_timer_get_time();
+    health_reset_chain();
+    ESP_LOGI(TAG, "Profile %s", p->name);
+}
+
+static void health_push_rr(uint32_t rr_us, int64_t timestamp_us)
+{
+    unsigned head = atomic_load_explicit(&s_rr_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&s_rr_tail, memory_order_acquire);
+    if (head - tail >= HEALTH_RR_RING_SIZE)
+        return; // nobody is reading; newer intervals are kept by the HRV window anyway
+    s_rr_ring[head & (HEALTH_RR_RING_SIZE - 1)] = (health_rr_t){rr_us, timestamp_us};
+    atomic_store_explicit(&s_rr_head, head + 1, memory_order_release);
+}
+
+static void health_on_beat(const ppg_dsp_out_t *o, int64_t timestamp_us)
+{
+    int hr = ppg_dsp_heart_rate(&s_dsp);
+    if (hr > 0)
+    {
+        s_data.heart_rate = hr;
         s_data.valid = true;
-        // ESP_LOGI(TAG, "Heart Rate: %d bpm, SpO2: %d%%", s_data.heart_rate, s_data.spo2);
     }
-    else
+
+    s_data.sqi = ppg_sqi_on_beat(&s_sqi, o->ir_dc);
+    if (hr > 0)
+    {
+        s_data.seq = vitals_add_hr(vitals_store(), timestamp_us, (uint8_t)hr, (uint8_t)s_data.sqi);
+        s_data.timestamp_ms = (uint32_t)(timestamp_us / 1000);
+    }
+
+    // Only clean beats reach HRV and rhythm screening; a poor one breaks
+    // the chain so no difference spans it
+    if (s_sqi.beat_score < HEALTH_SQI_MIN)
+    {
+        rr_route_break(&s_hrv, &s_rhythm);
+    }
+    else if (o->ibi_q8 > 0)
+    {
+        uint32_t rr_us = (uint32_t)(((uint64_t)o->ibi_q8 * 1000000u) / (s_dsp.cfg.fs_hz << 8));
+        // A skipped beat is simply interpolated across by the resampler
+        if (resp_add_beat(&s_resp, timestamp_us, o->ir_dc, o->peak_amplitude, rr_us))
+            s_data.resp_rate = s_resp.rate_bpm;
+        rr_route_t route = rr_route_beat(&s_hrv, &s_rhythm, rr_us);
+        if (route.hrv_accepted)
+            health_push_rr(rr_us, timestamp_us);
+        if (route.rhythm_changed)
+            ESP_LOGW(TAG, "Irregular rhythm %s", s_rhythm.flagged ? "detected" : "cleared");
+    }
+
+    spo2_result_t r;
+    if (spo2_on_beat(&s_spo2, o->ir_dc, o->red_dc, &r))
     {
+        s_data.spo2 = r.spo2;
+        s_data.spo2_confidence = r.confidence;
+        vitals_add_spo2(vitals_store(), timestamp_us, (uint8_t)r.spo2, (uint8_t)r.confidence);
+    }
+
+    int32_t rec[] = {s_data.heart_rate, s_data.spo2, s_data.spo2_confidence, s_data.sqi, s_data.resp_rate, (int32_t)o->ibi_q8};
+    sensor_hal_note_output(rec, sizeof(rec));
+}
+
+static int32_t health_gain_q8(uint8_t from, uint8_t to)
+{
+    uint16_t old_ma = led_agc_current_ma10(from);
+    return old_ma ? (int32_t)((led_agc_current_ma10(to) << 8) / old_ma) : 256;
+}
+
+static void health_apply_led(uint8_t old_ir, uint8_t old_red)
+{
+    s_led_dirty = false;
+    s_dsp_stats.led_changes++;
+    esp_err_t err = sensor_hal_ppg_set_led_current(s_agc.red.step, s_agc.ir.step);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "LED current update failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    s_rescale_pending = true;
+    s_rescale_from_us = esp_timer_get_time();
+    s_rescale_ir_q8 = health_gain_q8(old_ir, s_agc.ir.step);
+    s_rescale_red_q8 = health_gain_q8(old_red, s_agc.red.step);
+    ESP_LOGI(TAG, "LED current IR %u.%u mA, red %u.%u mA%s",
+             led_agc_current_ma10(s_agc.ir.step) / 10, led_agc_current_ma10(s_agc.ir.step) % 10,
+             led_agc_current_ma10(s_agc.red.step) / 10, led_agc_current_ma10(s_agc.red.step) % 10,
+             s_agc.contact_ok ? "" : " (no contact)");
+}
+
+static void health_process_sample(const max30100_sample_t *s)
+{
+    if (s->timestamp_us < s_profile_from_us)
+        return;
+
+    if (s_rescale_pending && s->timestamp_us >= s_rescale_from_us)
+    {
+        ppg_dsp_rescale(&s_dsp, s_rescale_ir_q8, s_rescale_red_q8);
+        // Baseline and amplitude step with the current; breathing would
+        // not survive that in the window
+        resp_init(&s_resp);
+        s_rescale_pending = false;
+    }
+
+    ppg_dsp_out_t o;
+    ppg_dsp_process(&s_dsp, s->ir, s->red, &o);
+    ppg_sqi_add_sample(&s_sqi, s->ir, s->red, o.ir_ac, s_dsp.locked ? s_dsp.ibi_avg_q8 >> 8 : 0);
+
+    if (!s_led_dirty)
+    {
+        s_led_old_ir = s_agc.ir.step;
+        s_led_old_red = s_agc.red.step;
+    }
+    if (led_agc_update(&s_agc, s->ir, s->red, o.ir_dc, o.red_dc))
+    {
+        s_led_dirty = true;
+    }
+
+    spo2_add_sample(&s_spo2, o.ir_ac, o.red_ac);
+
+    if (o.beat)
+    {
+        health_on_beat(&o, s->timestamp_us);
+    }
+}
+
+void health_update(void)
+{
+    health_apply_profile();
+
+    max30100_sample_t buf[HEALTH_DRAIN_CHUNK];
+    size_t n;
+    while ((n = sensor_hal_ppg_read(buf, HEALTH_DRAIN_CHUNK)) > 0)
+    {
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (size_t i = 0; i < n; i++)
+        {
+            health_process_sample(&buf[i]);
+        }
+        uint32_t per_sample = (esp_cpu_get_cycle_count() - start) / n;
+
+        s_dsp_stats.samples += n;
+        s_dsp_stats.cycles_per_sample_avg += ((int32_t)per_sample - (int32_t)s_dsp_stats.cycles_per_sample_avg) / 8;
+        if (per_sample > s_dsp_stats.cycles_per_sample_max)
+            s_dsp_stats.cycles_per_sample_max = per_sample;
+
+        if (s_led_dirty)
+        {
+            health_apply_led(s_led_old_ir, s_led_old_red);
+        }
+    }
+
+    if (!s_dsp.locked || !s_agc.contact_ok)
+    {
+        rr_route_break(&s_hrv, &s_rhythm);
+        ppg_sqi_reset_beat(&s_sqi);
+        resp_init(&s_resp);
+        s_data.sqi = 0;
+        s_data.resp_rate = 0;
         s_data.valid = false;
-        ESP_LOGW(TAG, "max30100_update failed: %s", esp_err_to_name(err));
+        s_data.spo2_confidence = 0;
     }
-    if (d.pulse_detected)
+}
+
+void health_set_active(bool active)
+{
+    if (!active)
     {
-        // ESP_LOGI("HEALTH", "Pulse detected @ BPM: %.2f", d.heart_bpm);
+        sensor_hal_ppg_set_power(false);
+        s_data.valid = false;
+        s_data.spo2_confidence = 0;
+        return;
     }
-    else
+
+    // Whatever is still buffered predates the shutdown; start the filters fresh
+    max30100_sample_t buf[HEALTH_DRAIN_CHUNK];
+    while (sensor_hal_ppg_read(buf, HEALTH_DRAIN_CHUNK) > 0)
     {
-        // ESP_LOGW("HEALTH", "No pulse detected for %d updates.");
+    }
+    health_profile_t before = s_profile;
+    uint8_t ir_step = s_agc.ir.step;
+    uint8_t red_step = s_agc.red.step;
+    health_apply_profile();
+    if (s_profile == before)
+    {
+        // Same wearer and profile as before the shutdown: keep the currents
+        // the AGC found, and make sure the LEDs run at them too
+        health_reset_chain();
+        esp_err_t err = sensor_hal_ppg_set_led_current(red_step, ir_step);
+        if (err == ESP_OK)
+        {
+            s_agc.ir.step = ir_step;
+            s_agc.red.step = red_step;
+        }
+        else
+        {
+            ESP_LOGW(TAG, "LED current restore failed: %s", esp_err_to_name(err));
+        }
+    }
+    // A new profile has already written its own currents and reset the chain
+
+    esp_err_t err = sensor_hal_ppg_set_power(true);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "max30100 wake-up failed: %s", esp_err_to_name(err));
     }
 }
 
@@ -53,3 +349,32 @@ void health_get_data(health_data_t *out)
 {
     *out = s_data;
 }
+
+size_t health_read_rr(health_rr_t *out, size_t max)
+{
+    unsigned tail = atomic_load_explicit(&s_rr_tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&s_rr_head, memory_order_acquire);
+    size_t n = 0;
+    while (tail != head && n < max)
+    {
+        out[n++] = s_rr_ring[tail & (HEALTH_RR_RING_SIZE - 1)];
+        tail++;
+    }
+    atomic_store_explicit(&s_rr_tail, tail, memory_order_release);
+    return n;
+}
+
+void health_get_hrv(hrv_metrics_t *out)
+{
+    hrv_get(&s_hrv, out);
+}
+
+void health_get_rhythm(rhythm_result_t *out)
+{
+    rhythm_get(&s_rhythm, out);
+}
+
+void health_get_dsp_stats(health_dsp_stats_t *out)
+{
+    *out = s_dsp_stats;
+}
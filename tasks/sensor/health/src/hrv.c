@@ -0,0 +1,135 @@
+#include "hrv.h"
+#include <math.h>
+#include <string.h>
+
+void hrv_init(hrv_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void hrv_break(hrv_t *h)
+{
+    h->chained = false;
+}
+
+static inline uint32_t hrv_ms(uint32_t us)
+{
+    return (us + 500) / 1000;
+}
+
+static void hrv_drop_oldest(hrv_t *h)
+{
+    uint16_t oldest = (h->head + HRV_WINDOW_BEATS - h->count) % HRV_WINDOW_BEATS;
+    const hrv_beat_t *b = &h->beats[oldest];
+    h->rr_sum -= b->rr_us;
+    h->rr_ms_sum -= hrv_ms(b->rr_us);
+    h->rr_sq_sum -= hrv_ms(b->rr_us) * hrv_ms(b->rr_us);
+    if (b->has_diff)
+    {
+        h->diff_sq_sum -= b->diff_sq_ms2;
+        h->diffs--;
+        h->nn50 -= b->nn50;
+    }
+
+    // The next beat's difference referred to the one leaving the window
+    if (h->count > 1)
+    {
+        hrv_beat_t *next = &h->beats[(oldest + 1) % HRV_WINDOW_BEATS];
+        if (next->has_diff)
+        {
+            h->diff_sq_sum -= next->diff_sq_ms2;
+            h->diffs--;
+            h->nn50 -= next->nn50;
+            next->has_diff = false;
+        }
+    }
+    h->count--;
+}
+
+// Empties the window, keeping the counters
+static void hrv_reseed(hrv_t *h)
+{
+    uint32_t rejected = h->rejected;
+    uint32_t reseeds = h->reseeds + 1;
+    hrv_init(h);
+    h->rejected = rejected;
+    h->reseeds = reseeds;
+}
+
+bool hrv_add_rr(hrv_t *h, uint32_t rr_us)
+{
+    if (rr_us < HRV_RR_MIN_US || rr_us > HRV_RR_MAX_US)
+    {
+        h->rejected++;
+        h->chained = false;
+        return false;
+    }
+
+    if (h->count >= 4)
+    {
+        int64_t mean = h->rr_sum / h->count;
+        int64_t dev = (int64_t)rr_us - mean;
+        if ((dev < 0 ? -dev : dev) * 100 > mean * HRV_ECTOPIC_PCT)
+        {
+            // Rejected beats never move the mean, so a lasting rate change
+            // would lock everything out; a run of them restarts the window
+            if (++h->reject_run < HRV_RESEED_RUN)
+            {
+                // A missed or extra beat also invalidates the next difference
+                h->rejected++;
+                h->chained = false;
+                return false;
+            }
+            hrv_reseed(h);
+        }
+    }
+    h->reject_run = 0;
+
+    if (h->count == HRV_WINDOW_BEATS)
+        hrv_drop_oldest(h);
+
+    hrv_beat_t *b = &h->beats[h->head];
+    memset(b, 0, sizeof(*b));
+    b->rr_us = rr_us;
+    if (h->chained && h->count > 0)
+    {
+        const hrv_beat_t *prev = &h->beats[(h->head + HRV_WINDOW_BEATS - 1) % HRV_WINDOW_BEATS];
+        int32_t d = (int32_t)rr_us - (int32_t)prev->rr_us;
+        uint32_t ad = d < 0 ? -d : d;
+        uint32_t d_ms = hrv_ms(ad);
+        b->has_diff = true;
+        b->diff_sq_ms2 = d_ms * d_ms;
+        b->nn50 = ad > HRV_NN50_US;
+        h->diff_sq_sum += b->diff_sq_ms2;
+        h->diffs++;
+        h->nn50 += b->nn50;
+    }
+
+    h->rr_sum += rr_us;
+    h->rr_ms_sum += hrv_ms(rr_us);
+    h->rr_sq_sum += hrv_ms(rr_us) * hrv_ms(rr_us);
+    h->head = (h->head + 1) % HRV_WINDOW_BEATS;
+    h->count++;
+    h->chained = true;
+    return true;
+}
+
+void hrv_get(const hrv_t *h, hrv_metrics_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->beats = h->count;
+
+    if (h->diffs > 0)
+    {
+        out->rmssd_ms = sqrtf((float)h->diff_sq_sum / h->diffs);
+        out->pnn50_pct = (uint8_t)((h->nn50 * 100u + h->diffs / 2) / h->diffs);
+    }
+
+    if (h->count > 1)
+    {
+        // Sample variance from the running sums, exact in integers (ms^2)
+        int64_t n = h->count;
+        int64_t var = (n * h->rr_sq_sum - h->rr_ms_sum * h->rr_ms_sum) / (n * (n - 1));
+        out->sdnn_ms = var > 0 ? sqrtf((float)var) : 0.0f;
+    }
+}
@@ -0,0 +1,82 @@
+#include "led_agc.h"
+#include <string.h>
+
+static const uint16_t s_current_ma10[LED_AGC_STEPS] = {
+    0, 44, 76, 110, 142, 174, 208, 240, 271, 306, 338, 370, 402, 436, 468, 500,
+};
+
+uint16_t led_agc_current_ma10(uint8_t step)
+{
+    return s_current_ma10[step < LED_AGC_STEPS ? step : LED_AGC_MAX_STEP];
+}
+
+void led_agc_init(led_agc_t *agc, uint32_t full_scale, uint32_t fs_hz, uint8_t ir_step, uint8_t red_step)
+{
+    memset(agc, 0, sizeof(*agc));
+    agc->ir.step = ir_step;
+    agc->red.step = red_step;
+    agc->low = (full_scale * LED_AGC_LOW_PCT / 100) << 8;
+    agc->high = (full_scale * LED_AGC_HIGH_PCT / 100) << 8;
+    agc->contact = (full_scale * LED_AGC_CONTACT_PCT / 100) << 8;
+    agc->clip = full_scale * LED_AGC_CLIP_PCT / 100;
+    agc->settle_samples = fs_hz * LED_AGC_SETTLE_MS / 1000;
+    agc->eval_samples = fs_hz * LED_AGC_EVAL_MS / 1000;
+    agc->countdown = agc->settle_samples;
+    agc->contact_ok = true;
+}
+
+// Returns the next step for one channel; clipping overrides the settle time
+static uint8_t led_agc_channel_step(const led_agc_t *agc, const led_agc_channel_t *ch, int32_t dc)
+{
+    if (ch->peak >= agc->clip || dc > (int32_t)agc->high)
+        return ch->step > 1 ? ch->step - 1 : ch->step;
+    if (dc < (int32_t)agc->low && ch->step < LED_AGC_MAX_STEP)
+        return ch->step + 1;
+    return ch->step;
+}
+
+bool led_agc_update(led_agc_t *agc, uint16_t ir_raw, uint16_t red_raw, int32_t ir_dc, int32_t red_dc)
+{
+    if (ir_raw > agc->ir.peak)
+        agc->ir.peak = ir_raw;
+    if (red_raw > agc->red.peak)
+        agc->red.peak = red_raw;
+
+    // Clipping cuts the evaluation interval short, but not the settle time
+    // right after a change, which may still see samples at the old current
+    bool clipped = ir_raw >= agc->clip || red_raw >= agc->clip;
+    if (agc->countdown > 0 && !(clipped && agc->countdown <= agc->eval_samples))
+    {
+        agc->countdown--;
+        return false;
+    }
+
+    uint8_t ir_step, red_step;
+    agc->contact_ok = ir_dc >= (int32_t)agc->contact;
+    if (!agc->contact_ok)
+    {
+        // Climbing cannot fix a missing finger; park at a low probe current
+        ir_step = LED_AGC_PROBE_STEP;
+        red_step = LED_AGC_PROBE_STEP;
+    }
+    else
+    {
+        ir_step = led_agc_channel_step(agc, &agc->ir, ir_dc);
+        red_step = led_agc_channel_step(agc, &agc->red, red_dc);
+    }
+
+    agc->ir.peak = 0;
+    agc->red.peak = 0;
+
+    if (ir_step == agc->ir.step && red_step == agc->red.step)
+    {
+        agc->countdown = agc->eval_samples;
+        return false;
+    }
+
+    agc->ir.step = ir_step;
+    agc->red.step = red_step;
+    agc->countdown = agc->settle_samples;
+    agc->changes++;
+    return true;
+}
@@ -0,0 +1,194 @@
+#include "ppg_dsp.h"
+#include <stddef.h>
+#include <string.h>
+
+#define PPG_DC_MEAN_SHIFT    6
+#define PPG_THRESHOLD_Q15    20480 // new threshold = 5/8 of the last peak
+#define PPG_MIN_AMPLITUDE_Q8 (8 << 8)
+#define PPG_MIN_BPM          30
+#define PPG_MAX_BPM          220
+
+// Band-pass = 2nd-order Butterworth high-pass at 0.5 Hz followed by a
+// 2nd-order Butterworth low-pass at 4 Hz (RBJ bilinear design, Q30).
+// DC blocker pole places the corner at ~0.08 Hz.
+static const ppg_dsp_config_t s_configs[] = {
+    {50, 32438, {{1027080468, -2054160935, 1027080468, -2052132225, 982447822},
+                 {49533645, 99067291, 49533645, -1403686611, 528079369}}},
+    {100, 32603, {{1050152231, -2100304461, 1050152231, -2099786147, 1027080952},
+                  {14344332, 28688664, 14344332, -1768946685, 752582188}}},
+    {167, 32669, {{1059553435, -2119106869, 1059553435, -2118919376, 1045552538},
+                  {5486631, 10973262, 5486631, -1919693900, 867898600}}},
+    {200, 32686, {{1061881538, -2123763076, 1061881538, -2123632067, 1050152262},
+                  {3888751, 7777502, 3888751, -1957103774, 898916953}}},
+};
+
+const ppg_dsp_config_t *ppg_dsp_config_for_rate(uint32_t fs_hz)
+{
+    for (size_t i = 0; i < sizeof(s_configs) / sizeof(s_configs[0]); i++)
+    {
+        if (s_configs[i].fs_hz == fs_hz)
+            return &s_configs[i];
+    }
+    return NULL;
+}
+
+static inline int32_t biquad_step(const ppg_biquad_coeffs_t *c, ppg_biquad_state_t *s, int32_t x)
+{
+    int64_t acc = (int64_t)c->b0 * x + (int64_t)c->b1 * s->x1 + (int64_t)c->b2 * s->x2 -
+                  (int64_t)c->a1 * s->y1 - (int64_t)c->a2 * s->y2 + s->err;
+    int32_t y = (int32_t)((acc + (1 << 29)) >> 30);
+    // Fed back next sample; without it the rounding noise is amplified by
+    // the high-pass poles next to z = 1 (about 30 dB worse at 200 Hz)
+    s->err = (int32_t)(acc - ((int64_t)y << 30));
+    s->x2 = s->x1;
+    s->x1 = x;
+    s->y2 = s->y1;
+    s->y1 = y;
+    return y;
+}
+
+// Returns the band-passed AC component (Q8) and tracks the DC level
+static int32_t channel_step(const ppg_dsp_config_t *cfg, ppg_channel_t *ch, uint16_t raw)
+{
+    int32_t x = (int32_t)raw << 8;
+
+    if (ch->dc == 0)
+    {
+        // Seed from the first sample so the filters do not ring on start-up
+        ch->dc = x;
+        ch->x_prev = x;
+    }
+    ch->dc += (x - ch->dc) >> PPG_DC_MEAN_SHIFT;
+
+    // y[n] = x[n] - x[n-1] + p * y[n-1]
+    int32_t y = x - ch->x_prev + (int32_t)(((int64_t)cfg->dc_pole_q15 * ch->y_prev) >> 15);
+    ch->x_prev = x;
+    ch->y_prev = y;
+
+    for (int i = 0; i < PPG_DSP_SECTIONS; i++)
+    {
+        y = biquad_step(&cfg->bp[i], &ch->bq[i], y);
+    }
+    return y;
+}
+
+void ppg_dsp_init(ppg_dsp_t *dsp, const ppg_dsp_config_t *cfg)
+{
+    memset(dsp, 0, sizeof(*dsp));
+    dsp->cfg = *cfg;
+    dsp->min_amplitude = PPG_MIN_AMPLITUDE_Q8;
+    dsp->refractory = cfg->fs_hz * 60 / PPG_MAX_BPM;
+    dsp->max_ibi = cfg->fs_hz * 60 / PPG_MIN_BPM;
+
+    // Threshold roughly halves every second: (1 - 2^-k)^fs ~= 0.5
+    dsp->decay_shift = 1;
+    while ((1u << dsp->decay_shift) < cfg->fs_hz * 3 / 2)
+        dsp->decay_shift++;
+}
+
+// Vertex of the parabola through three samples around a maximum, as an
+// offset from the middle one in Q8 samples
+static int32_t peak_offset_q8(int32_t left, int32_t mid, int32_t right)
+{
+    int64_t den = (int64_t)left - 2 * (int64_t)mid + right;
+    if (den >= 0)
+        return 0;
+    int32_t off = (int32_t)((((int64_t)left - right) << 7) / den);
+    if (off > 128)
+        off = 128;
+    if (off < -128)
+        off = -128;
+    return off;
+}
+
+void ppg_dsp_process(ppg_dsp_t *dsp, uint16_t ir, uint16_t red, ppg_dsp_out_t *out)
+{
+    // Blood volume increases absorption, so invert to make systole a maximum
+    int32_t cur = -channel_step(&dsp->cfg, &dsp->ir, ir);
+    out->ir_ac = cur;
+    out->red_ac = -channel_step(&dsp->cfg, &dsp->red, red);
+    out->ir_dc = dsp->ir.dc;
+    out->red_dc = dsp->red.dc;
+    out->beat = false;
+    out->peak_amplitude = 0;
+    out->ibi_samples = 0;
+    out->ibi_q8 = 0;
+
+    dsp->sample_idx++;
+    dsp->threshold -= dsp->threshold >> dsp->decay_shift;
+
+    // prev1 is a local maximum; confirm it against threshold and refractory time
+    uint32_t peak_idx = dsp->sample_idx - 1;
+    uint32_t since_peak = peak_idx - dsp->last_peak_idx;
+    if (dsp->prev1 > dsp->prev2 && dsp->prev1 >= cur &&
+        dsp->prev1 > dsp->threshold && dsp->prev1 > dsp->min_amplitude &&
+        since_peak >= dsp->refractory)
+    {
+        out->beat = true;
+        out->peak_amplitude = dsp->prev1;
+        int32_t frac = peak_offset_q8(dsp->prev2, dsp->prev1, cur);
+        dsp->threshold = (int32_t)(((int64_t)dsp->prev1 * PPG_THRESHOLD_Q15) >> 15);
+
+        if (dsp->last_peak_idx != 0 && since_peak <= dsp->max_ibi)
+        {
+            uint32_t ibi_q8 = (uint32_t)((int32_t)(since_peak << 8) + frac - dsp->last_peak_frac_q8);
+            out->ibi_samples = since_peak;
+            out->ibi_q8 = ibi_q8;
+            if (!dsp->locked)
+            {
+                dsp->ibi_avg_q8 = ibi_q8;
+                dsp->locked = true;
+            }
+            else
+            {
+                dsp->ibi_avg_q8 += (int32_t)(ibi_q8 - dsp->ibi_avg_q8) >> 2;
+            }
+        }
+        dsp->last_peak_idx = peak_idx;
+        dsp->last_peak_frac_q8 = frac;
+    }
+    else if (dsp->locked && since_peak > dsp->max_ibi)
+    {
+        dsp->locked = false;
+    }
+
+    dsp->prev2 = dsp->prev1;
+    dsp->prev1 = cur;
+}
+
+static inline int32_t scale_q8(int32_t v, int32_t k_q8)
+{
+    return (int32_t)(((int64_t)v * k_q8) >> 8);
+}
+
+static void channel_rescale(ppg_channel_t *ch, int32_t k_q8)
+{
+    ch->x_prev = scale_q8(ch->x_prev, k_q8);
+    ch->y_prev = scale_q8(ch->y_prev, k_q8);
+    ch->dc = scale_q8(ch->dc, k_q8);
+    for (int i = 0; i < PPG_DSP_SECTIONS; i++)
+    {
+        ppg_biquad_state_t *s = &ch->bq[i];
+        s->x1 = scale_q8(s->x1, k_q8);
+        s->x2 = scale_q8(s->x2, k_q8);
+        s->y1 = scale_q8(s->y1, k_q8);
+        s->y2 = scale_q8(s->y2, k_q8);
+        s->err = scale_q8(s->err, k_q8);
+    }
+}
+
+void ppg_dsp_rescale(ppg_dsp_t *dsp, int32_t ir_q8, int32_t red_q8)
+{
+    channel_rescale(&dsp->ir, ir_q8);
+    channel_rescale(&dsp->red, red_q8);
+    dsp->prev1 = scale_q8(dsp->prev1, ir_q8);
+    dsp->prev2 = scale_q8(dsp->prev2, ir_q8);
+    dsp->threshold = scale_q8(dsp->threshold, ir_q8);
+}
+
+int ppg_dsp_heart_rate(const ppg_dsp_t *dsp)
+{
+    if (!dsp->locked || dsp->ibi_avg_q8 == 0)
+        return 0;
+    return (int)((dsp->cfg.fs_hz * 60u * 256u + dsp->ibi_avg_q8 / 2) / dsp->ibi_avg_q8);
+}
@@ -0,0 +1,143 @@
+#include "ppg_sqi.h"
+#include <math.h>
+#include <string.h>
+
+static void ppg_sqi_clear_beat(ppg_sqi_t *q)
+{
+    memset(q->bins, 0, sizeof(q->bins));
+    memset(q->counts, 0, sizeof(q->counts));
+    q->samples = 0;
+    q->ac_min = INT32_MAX;
+    q->ac_max = INT32_MIN;
+    q->clipped = false;
+}
+
+void ppg_sqi_init(ppg_sqi_t *q, uint16_t full_scale)
+{
+    memset(q, 0, sizeof(*q));
+    q->full_scale = full_scale;
+    ppg_sqi_clear_beat(q);
+}
+
+void ppg_sqi_reset_beat(ppg_sqi_t *q)
+{
+    ppg_sqi_clear_beat(q);
+    q->sqi = 0;
+}
+
+void ppg_sqi_add_sample(ppg_sqi_t *q, uint16_t ir_raw, uint16_t red_raw, int32_t ir_ac, uint32_t expected_ibi)
+{
+    if (ir_raw >= q->full_scale || red_raw >= q->full_scale || ir_raw == 0 || red_raw == 0)
+        q->clipped = true;
+
+    if (ir_ac < q->ac_min)
+        q->ac_min = ir_ac;
+    if (ir_ac > q->ac_max)
+        q->ac_max = ir_ac;
+
+    if (expected_ibi > 0)
+    {
+        uint32_t bin = q->samples * PPG_SQI_POINTS / expected_ibi;
+        if (bin < PPG_SQI_POINTS)
+        {
+            q->bins[bin] += ir_ac >> 4; // headroom: a bin sums several Q8 samples
+            q->counts[bin]++;
+        }
+    }
+    q->samples++;
+}
+
+// Pearson correlation of the folded beat with the template; empty bins are
+// skipped so a beat shorter than expected still compares fairly
+static float ppg_sqi_correlate(const ppg_sqi_t *q, const float *beat, const bool *valid)
+{
+    float sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+    int n = 0;
+    for (int i = 0; i < PPG_SQI_POINTS; i++)
+    {
+        if (!valid[i])
+            continue;
+        float x = beat[i], y = q->tmpl[i];
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        syy += y * y;
+        sxy += x * y;
+        n++;
+    }
+    if (n < PPG_SQI_POINTS / 2)
+        return 0.0f;
+
+    float cov = sxy - sx * sy / n;
+    float vx = sxx - sx * sx / n;
+    float vy = syy - sy * sy / n;
+    if (vx <= 0.0f || vy <= 0.0f)
+        return 0.0f;
+    return cov / sqrtf(vx * vy);
+}
+
+static int score_linear(float v, float lo, float hi)
+{
+    if (v <= lo)
+        return 0;
+    if (v >= hi)
+        return 100;
+    return (int)(100.0f * (v - lo) / (hi - lo));
+}
+
+int ppg_sqi_on_beat(ppg_sqi_t *q, int32_t ir_dc)
+{
+    float beat[PPG_SQI_POINTS];
+    bool valid[PPG_SQI_POINTS];
+    int filled = 0;
+    for (int i = 0; i < PPG_SQI_POINTS; i++)
+    {
+        valid[i] = q->counts[i] > 0;
+        beat[i] = valid[i] ? (float)q->bins[i] / q->counts[i] : 0.0f;
+        filled += valid[i];
+    }
+
+    q->pi_ppm = 0;
+    if (ir_dc > 0 && q->ac_max > q->ac_min)
+        q->pi_ppm = (uint32_t)(((int64_t)(q->ac_max - q->ac_min) * 1000000) / ir_dc);
+
+    int pi_score = score_linear((float)q->pi_ppm, PPG_SQI_MIN_PI_PPM, PPG_SQI_GOOD_PI_PPM);
+
+    int shape_score = 0;
+    q->corr = 0.0f;
+    if (filled == 0)
+    {
+        // Detector not locked yet: nothing to fold the beat against
+    }
+    else if (!q->have_template)
+    {
+        memcpy(q->tmpl, beat, sizeof(beat));
+        q->have_template = true;
+    }
+    else
+    {
+        q->corr = ppg_sqi_correlate(q, beat, valid);
+        shape_score = score_linear(q->corr, PPG_SQI_MIN_CORR, 1.0f);
+        if (q->corr >= PPG_SQI_TEMPLATE_CORR && !q->clipped)
+        {
+            for (int i = 0; i < PPG_SQI_POINTS; i++)
+            {
+                if (valid[i])
+                    q->tmpl[i] += (beat[i] - q->tmpl[i]) * 0.25f;
+            }
+        }
+        else if (q->sqi == 0)
+        {
+            // Nothing good seen for a while: the template may be the artifact
+            memcpy(q->tmpl, beat, sizeof(beat));
+        }
+    }
+
+    q->beat_score = q->clipped ? 0 : (pi_score < shape_score ? pi_score : shape_score);
+    q->sqi += (q->beat_score - q->sqi) / 2;
+    if (q->beat_score == 0 && q->sqi < 10)
+        q->sqi = 0;
+
+    ppg_sqi_clear_beat(q);
+    return q->sqi;
+}
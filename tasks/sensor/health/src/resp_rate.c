@@ -0,0 +1,157 @@
+#include "resp_rate.h"
+#include <math.h>
+#include <string.h>
+
+#define RESP_PERIOD_US (1000000 / RESP_FS_HZ)
+#define RESP_BINS      (RESP_MAX_BPM - RESP_MIN_BPM + 1) // 1 breath/min steps
+
+static float s_hann[RESP_POINTS];
+static float s_coeff[RESP_BINS]; // Goertzel 2*cos(w) per candidate rate
+static bool s_tables_ready = false;
+
+static void resp_tables(void)
+{
+    if (s_tables_ready)
+        return;
+    for (int i = 0; i < RESP_POINTS; i++)
+        s_hann[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / (RESP_POINTS - 1));
+    for (int k = 0; k < RESP_BINS; k++)
+    {
+        float hz = (RESP_MIN_BPM + k) / 60.0f;
+        s_coeff[k] = 2.0f * cosf(2.0f * (float)M_PI * hz / RESP_FS_HZ);
+    }
+    s_tables_ready = true;
+}
+
+void resp_init(resp_rate_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    resp_tables();
+}
+
+// Normalised band power of one series, oldest point first
+static void resp_spectrum(const resp_rate_t *r, int series, float *power)
+{
+    const float *buf = r->buf[series];
+    uint16_t start = (r->head + RESP_POINTS - r->count) % RESP_POINTS;
+
+    float mean = 0.0f;
+    for (int i = 0; i < r->count; i++)
+        mean += buf[(start + i) % RESP_POINTS];
+    mean /= r->count;
+
+    float x[RESP_POINTS];
+    for (int i = 0; i < r->count; i++)
+        x[i] = (buf[(start + i) % RESP_POINTS] - mean) * s_hann[i];
+
+    float total = 0.0f;
+    for (int k = 0; k < RESP_BINS; k++)
+    {
+        float s1 = 0.0f, s2 = 0.0f;
+        for (int i = 0; i < r->count; i++)
+        {
+            float s0 = x[i] + s_coeff[k] * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        power[k] = s1 * s1 + s2 * s2 - s_coeff[k] * s1 * s2;
+        total += power[k];
+    }
+
+    for (int k = 0; k < RESP_BINS; k++)
+        power[k] = total > 0.0f ? power[k] / total : 0.0f;
+}
+
+static int resp_peak(const float *power)
+{
+    int best = 0;
+    for (int k = 1; k < RESP_BINS; k++)
+    {
+        if (power[k] > power[best])
+            best = k;
+    }
+    return best;
+}
+
+static void resp_estimate(resp_rate_t *r)
+{
+    float power[RESP_SERIES][RESP_BINS];
+    int peak[RESP_SERIES];
+    float fused[RESP_BINS] = {0};
+
+    for (int s = 0; s < RESP_SERIES; s++)
+    {
+        resp_spectrum(r, s, power[s]);
+        peak[s] = resp_peak(power[s]);
+    }
+
+    // Fuse only the modulations that agree with at least one other
+    int used = 0;
+    for (int s = 0; s < RESP_SERIES; s++)
+    {
+        bool agrees = false;
+        for (int o = 0; o < RESP_SERIES; o++)
+        {
+            int d = peak[s] - peak[o];
+            if (o != s && d <= RESP_AGREE_BPM && d >= -RESP_AGREE_BPM)
+                agrees = true;
+        }
+        if (!agrees)
+            continue;
+        for (int k = 0; k < RESP_BINS; k++)
+            fused[k] += power[s][k];
+        used++;
+    }
+
+    if (used == 0)
+    {
+        r->rate_bpm = 0;
+        r->quality = 0;
+        return;
+    }
+
+    int k = resp_peak(fused);
+    r->rate_bpm = RESP_MIN_BPM + k;
+    // Three bins around the peak against the whole band
+    float around = fused[k] + (k > 0 ? fused[k - 1] : 0.0f) + (k < RESP_BINS - 1 ? fused[k + 1] : 0.0f);
+    r->quality = (int)(100.0f * around / used + 0.5f);
+    if (r->quality < RESP_QUALITY_MIN)
+        r->rate_bpm = 0;
+}
+
+bool resp_add_beat(resp_rate_t *r, int64_t timestamp_us, int32_t baseline, int32_t amplitude, uint32_t rr_us)
+{
+    float cur[RESP_SERIES] = {(float)baseline, (float)amplitude, (float)rr_us};
+
+    if (!r->have_prev)
+    {
+        memcpy(r->prev, cur, sizeof(cur));
+        r->prev_us = timestamp_us;
+        r->next_point_us = timestamp_us;
+        r->last_eval_us = timestamp_us;
+        r->have_prev = true;
+        return false;
+    }
+
+    // Linear interpolation onto the fixed grid between the last two beats
+    int64_t span = timestamp_us - r->prev_us;
+    while (span > 0 && r->next_point_us <= timestamp_us)
+    {
+        float f = (float)(r->next_point_us - r->prev_us) / (float)span;
+        for (int s = 0; s < RESP_SERIES; s++)
+            r->buf[s][r->head] = r->prev[s] + (cur[s] - r->prev[s]) * f;
+        r->head = (r->head + 1) % RESP_POINTS;
+        if (r->count < RESP_POINTS)
+            r->count++;
+        r->next_point_us += RESP_PERIOD_US;
+    }
+    memcpy(r->prev, cur, sizeof(cur));
+    r->prev_us = timestamp_us;
+
+    if (r->count < RESP_POINTS || timestamp_us - r->last_eval_us < (int64_t)RESP_EVAL_MS * 1000)
+        return false;
+
+    r->last_eval_us = timestamp_us;
+    resp_estimate(r);
+    return true;
+}
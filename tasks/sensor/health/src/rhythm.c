@@ -0,0 +1,162 @@
+#include "rhythm.h"
+#include <math.h>
+#include <string.h>
+
+#define RHYTHM_NRMSSD_LO  0.05f
+#define RHYTHM_NRMSSD_HI  0.12f
+#define RHYTHM_ENTROPY_LO 0.35f
+#define RHYTHM_ENTROPY_HI 0.60f
+#define RHYTHM_TPR_SPREAD 0.15f
+
+// c * log2(c) for every count a bin can hold, so the entropy update is a
+// table lookup instead of a log per beat
+static float s_clogc[RHYTHM_WINDOW_BEATS + 1];
+static bool s_clogc_ready = false;
+
+void rhythm_init(rhythm_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    if (!s_clogc_ready)
+    {
+        for (int c = 1; c <= RHYTHM_WINDOW_BEATS; c++)
+            s_clogc[c] = c * log2f((float)c);
+        s_clogc_ready = true;
+    }
+}
+
+void rhythm_break(rhythm_t *r)
+{
+    r->chained = false;
+}
+
+static uint16_t rhythm_idx(const rhythm_t *r, int back)
+{
+    return (uint16_t)((r->head + RHYTHM_WINDOW_BEATS - back) % RHYTHM_WINDOW_BEATS);
+}
+
+static void rhythm_hist_move(rhythm_t *r, uint8_t bin, int delta)
+{
+    r->clogc_sum -= s_clogc[r->hist[bin]];
+    r->hist[bin] += delta;
+    r->clogc_sum += s_clogc[r->hist[bin]];
+}
+
+static void rhythm_drop_oldest(rhythm_t *r)
+{
+    rhythm_beat_t *old = &r->beats[rhythm_idx(r, r->count)];
+    rhythm_beat_t *next = &r->beats[rhythm_idx(r, r->count - 1)];
+
+    r->rr_sum -= old->rr_us;
+    rhythm_hist_move(r, old->bin, -1);
+    if (old->has_diff)
+    {
+        r->diff_sq_sum -= old->diff_sq_ms2;
+        r->diffs--;
+    }
+
+    // The second-oldest beat loses its left neighbour: both its difference
+    // and its turning-point decision go
+    if (next->has_diff)
+    {
+        r->diff_sq_sum -= next->diff_sq_ms2;
+        r->diffs--;
+        next->has_diff = false;
+        if (r->count > 2 && r->beats[rhythm_idx(r, r->count - 2)].has_diff)
+        {
+            r->triples--;
+            r->turning -= next->turning;
+            next->turning = false;
+        }
+    }
+    r->count--;
+}
+
+static float clamp01(float v)
+{
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+static void rhythm_measures(const rhythm_t *r, rhythm_result_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (r->count == 0)
+        return;
+
+    float mean_ms = (float)r->rr_sum / r->count / 1000.0f;
+    if (r->diffs > 0 && mean_ms > 0.0f)
+        out->nrmssd = sqrtf((float)r->diff_sq_sum / r->diffs) / mean_ms;
+
+    // H = log2(N) - sum(c log2 c) / N
+    float n = (float)r->count;
+    out->entropy = clamp01((log2f(n) - r->clogc_sum / n) / log2f((float)RHYTHM_BINS));
+
+    if (r->triples > 0)
+        out->tpr = (float)r->turning / r->triples;
+}
+
+bool rhythm_add_rr(rhythm_t *r, uint32_t rr_us)
+{
+    if (r->count == RHYTHM_WINDOW_BEATS)
+        rhythm_drop_oldest(r);
+
+    rhythm_beat_t *b = &r->beats[r->head];
+    memset(b, 0, sizeof(*b));
+    b->rr_us = rr_us;
+    uint32_t bin = rr_us > RHYTHM_BIN_BASE_US ? (rr_us - RHYTHM_BIN_BASE_US) / RHYTHM_BIN_US : 0;
+    b->bin = bin < RHYTHM_BINS ? bin : RHYTHM_BINS - 1;
+
+    if (r->chained && r->count > 0)
+    {
+        rhythm_beat_t *prev = &r->beats[rhythm_idx(r, 1)];
+        int32_t d = (int32_t)rr_us - (int32_t)prev->rr_us;
+        uint32_t d_ms = ((d < 0 ? -d : d) + 500) / 1000;
+        b->has_diff = true;
+        b->diff_sq_ms2 = d_ms * d_ms;
+        r->diff_sq_sum += b->diff_sq_ms2;
+        r->diffs++;
+
+        // The previous beat now has both neighbours
+        if (prev->has_diff)
+        {
+            uint32_t pp = r->beats[rhythm_idx(r, 2)].rr_us;
+            prev->turning = (prev->rr_us > pp && prev->rr_us > rr_us) ||
+                            (prev->rr_us < pp && prev->rr_us < rr_us);
+            r->triples++;
+            r->turning += prev->turning;
+        }
+    }
+
+    r->rr_sum += rr_us;
+    rhythm_hist_move(r, b->bin, 1);
+    r->head = (r->head + 1) % RHYTHM_WINDOW_BEATS;
+    r->count++;
+    r->chained = true;
+
+    if (r->count < RHYTHM_WINDOW_BEATS)
+        return false;
+
+    rhythm_result_t m;
+    rhythm_measures(r, &m);
+    float s_n = clamp01((m.nrmssd - RHYTHM_NRMSSD_LO) / (RHYTHM_NRMSSD_HI - RHYTHM_NRMSSD_LO));
+    float s_e = clamp01((m.entropy - RHYTHM_ENTROPY_LO) / (RHYTHM_ENTROPY_HI - RHYTHM_ENTROPY_LO));
+    float s_t = clamp01(1.0f - fabsf(m.tpr - 2.0f / 3.0f) / RHYTHM_TPR_SPREAD);
+    r->score = (int)(100.0f * s_n * s_e * s_t + 0.5f);
+
+    // Hysteresis: a sustained score is needed to change state either way
+    bool crossing = r->flagged ? r->score < RHYTHM_CLEAR_SCORE : r->score >= RHYTHM_FLAG_SCORE;
+    r->streak = crossing ? r->streak + 1 : 0;
+    if (r->streak >= RHYTHM_CONFIRM_BEATS)
+    {
+        r->flagged = !r->flagged;
+        r->streak = 0;
+        return true;
+    }
+    return false;
+}
+
+void rhythm_get(const rhythm_t *r, rhythm_result_t *out)
+{
+    rhythm_measures(r, out);
+    out->score = r->count == RHYTHM_WINDOW_BEATS ? r->score : 0;
+    out->flagged = r->flagged;
+}
@@ -0,0 +1,19 @@
+#include "rr_route.h"
+
+void rr_route_break(hrv_t *h, rhythm_t *r)
+{
+    hrv_break(h);
+    rhythm_break(r);
+}
+
+rr_route_t rr_route_beat(hrv_t *h, rhythm_t *r, uint32_t rr_us)
+{
+    rr_route_t out = {false, false};
+    out.hrv_accepted = hrv_add_rr(h, rr_us);
+    // Out of range is a missed or doubled detection, not rhythm
+    if (rr_us < HRV_RR_MIN_US || rr_us > HRV_RR_MAX_US)
+        rhythm_break(r);
+    else
+        out.rhythm_changed = rhythm_add_rr(r, rr_us);
+    return out;
+}
@@ -0,0 +1,147 @@
+#include "spo2_estimator.h"
+#include <string.h>
+
+#define SPO2_R_ONE          4096            // 1.0 in Q12
+#define SPO2_R_MIN          (SPO2_R_ONE / 4)
+#define SPO2_R_MAX          (SPO2_R_ONE * 11 / 10) // top of the calibrated range, about 74 %
+#define SPO2_R_SPREAD_LIMIT (SPO2_R_ONE / 10) // beat-to-beat R spread that drops confidence to 0
+
+// Empirical calibration curve SpO2 = -45.060 R^2 + 30.354 R + 94.845, sampled at
+// R = i/16 and stored as Q8 percent. The compiler evaluates every entry.
+#define SPO2_LUT_STEP_SHIFT 8 // Q12 R >> 8 = table index
+#define SPO2_CURVE(r)       (-45.060 * (r) * (r) + 30.354 * (r) + 94.845)
+#define SPO2_CLAMP(v)       ((v) < 0.0 ? 0.0 : ((v) > 100.0 ? 100.0 : (v)))
+#define SPO2_LUT_ENTRY(i)   ((uint16_t)(SPO2_CLAMP(SPO2_CURVE((i) / 16.0)) * 256.0 + 0.5))
+#define SPO2_LUT_4(i)       SPO2_LUT_ENTRY(i), SPO2_LUT_ENTRY(i + 1), SPO2_LUT_ENTRY(i + 2), SPO2_LUT_ENTRY(i + 3)
+
+static const uint16_t s_spo2_lut[] = {
+    SPO2_LUT_4(0), SPO2_LUT_4(4), SPO2_LUT_4(8), SPO2_LUT_4(12),
+    SPO2_LUT_4(16), SPO2_LUT_4(20), SPO2_LUT_4(24), SPO2_LUT_4(28),
+    SPO2_LUT_ENTRY(32),
+};
+
+#define SPO2_LUT_LEN (sizeof(s_spo2_lut) / sizeof(s_spo2_lut[0]))
+
+static uint32_t isqrt64(uint64_t v)
+{
+    uint64_t res = 0;
+    uint64_t bit = 1ULL << 62;
+    while (bit > v)
+        bit >>= 2;
+    while (bit)
+    {
+        if (v >= res + bit)
+        {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else
+        {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+// Perfusion ratio AC_rms / DC in Q24
+static int64_t perfusion_q24(int64_t ac_sq, uint32_t samples, int64_t dc)
+{
+    if (samples == 0 || dc <= 0)
+        return 0;
+    int64_t rms = isqrt64((uint64_t)ac_sq / samples); // Q8
+    return (rms << 24) / dc;
+}
+
+static int32_t ratio_q12(int64_t red_ac_sq, int64_t ir_ac_sq, uint32_t samples, int64_t red_dc, int64_t ir_dc)
+{
+    int64_t pi_red = perfusion_q24(red_ac_sq, samples, red_dc);
+    int64_t pi_ir = perfusion_q24(ir_ac_sq, samples, ir_dc);
+    if (pi_ir == 0)
+        return 0;
+    return (int32_t)((pi_red << 12) / pi_ir);
+}
+
+static int spo2_from_ratio(int32_t r_q12)
+{
+    uint32_t idx = (uint32_t)r_q12 >> SPO2_LUT_STEP_SHIFT;
+    if (idx >= SPO2_LUT_LEN - 1)
+        return s_spo2_lut[SPO2_LUT_LEN - 1] >> 8;
+
+    uint32_t frac = (uint32_t)r_q12 & ((1u << SPO2_LUT_STEP_SHIFT) - 1);
+    int32_t a = s_spo2_lut[idx];
+    int32_t b = s_spo2_lut[idx + 1];
+    int32_t q8 = a + (((b - a) * (int32_t)frac) >> SPO2_LUT_STEP_SHIFT);
+    return (q8 + 128) >> 8;
+}
+
+void spo2_init(spo2_estimator_t *e)
+{
+    memset(e, 0, sizeof(*e));
+}
+
+void spo2_add_sample(spo2_estimator_t *e, int32_t ir_ac, int32_t red_ac)
+{
+    e->cur.ir_ac_sq += (int64_t)ir_ac * ir_ac;
+    e->cur.red_ac_sq += (int64_t)red_ac * red_ac;
+    e->cur.samples++;
+}
+
+bool spo2_on_beat(spo2_estimator_t *e, int32_t ir_dc, int32_t red_dc, spo2_result_t *out)
+{
+    spo2_beat_t *b = &e->cur;
+    if (b->samples == 0)
+        return false;
+
+    b->ir_dc = ir_dc;
+    b->red_dc = red_dc;
+    b->ratio_q12 = ratio_q12(b->red_ac_sq, b->ir_ac_sq, b->samples, red_dc, ir_dc);
+
+    // Slide the window: drop the oldest beat once it is full
+    if (e->count == SPO2_WINDOW_BEATS)
+    {
+        const spo2_beat_t *old = &e->beats[e->head];
+        e->ir_ac_sq -= old->ir_ac_sq;
+        e->red_ac_sq -= old->red_ac_sq;
+        e->samples -= old->samples;
+        e->ir_dc -= old->ir_dc;
+        e->red_dc -= old->red_dc;
+        e->ratio_sum -= old->ratio_q12;
+        e->ratio_sq_sum -= (int64_t)old->ratio_q12 * old->ratio_q12;
+    }
+    else
+    {
+        e->count++;
+    }
+
+    e->ir_ac_sq += b->ir_ac_sq;
+    e->red_ac_sq += b->red_ac_sq;
+    e->samples += b->samples;
+    e->ir_dc += b->ir_dc;
+    e->red_dc += b->red_dc;
+    e->ratio_sum += b->ratio_q12;
+    e->ratio_sq_sum += (int64_t)b->ratio_q12 * b->ratio_q12;
+
+    e->beats[e->head] = *b;
+    e->head = (e->head + 1) % SPO2_WINDOW_BEATS;
+    memset(b, 0, sizeof(*b));
+
+    int32_t r = ratio_q12(e->red_ac_sq, e->ir_ac_sq, e->samples, e->red_dc / e->count, e->ir_dc / e->count);
+    out->ratio_q12 = r;
+    out->spo2 = spo2_from_ratio(r);
+
+    // Confidence: window fill, beat-to-beat R consistency and calibrated range
+    int confidence = 0;
+    if (r >= SPO2_R_MIN && r <= SPO2_R_MAX)
+    {
+        int64_t n = e->count;
+        int64_t var = (e->ratio_sq_sum * n - (int64_t)e->ratio_sum * e->ratio_sum) / (n * n);
+        int32_t sd = var > 0 ? (int32_t)isqrt64((uint64_t)var) : 0;
+        confidence = 100 - (sd * 100) / SPO2_R_SPREAD_LIMIT;
+        if (confidence < 0)
+            confidence = 0;
+        confidence = confidence * e->count / SPO2_WINDOW_BEATS;
+    }
+    out->confidence = confidence;
+    return true;
+}
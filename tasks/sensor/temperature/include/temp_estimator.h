@@ -0,0 +1,71 @@
+#ifndef TEMP_ESTIMATOR_H
+#define TEMP_ESTIMATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Streaming estimator for the final value of a temperature scan. The reading
+// is modelled as a first-order approach T(t) = Tf - (Tf - T0) * exp(-t / tau).
+// Sampled at a fixed step this becomes T[n+1] = c + k * T[n], so a running
+// least-squares line through consecutive (block-averaged) samples gives
+// Tf = c / (1 - k) without storing the scan. A window that is already flat
+// (a re-scan at equilibrium) has no usable fit and predicts its block mean
+// instead. No ESP-IDF dependencies.
+
+#define TEMP_EST_BLOCK          4      // raw samples averaged per fit point
+#define TEMP_EST_MIN_POINTS     3      // fit pairs before a prediction is trusted
+#define TEMP_EST_STABLE_POINTS  3      // consecutive predictions checked for convergence
+#define TEMP_EST_TOLERANCE_C    0.1f   // convergence band of the prediction
+#define TEMP_EST_FLAT_C         0.05f  // RMS spread of the fit points below which the reading is final
+#define TEMP_EST_SPIKE_C        0.5f   // distance from the extrapolated reading that rejects a sample
+#define TEMP_EST_SPIKE_RUN      2      // consecutive rejections after which a step is accepted
+#define TEMP_EST_NOISE_LIMIT_C  0.2f   // fit residual that drops confidence to 0
+
+typedef struct {
+    uint32_t period_us;     // nominal sample period
+
+    // Spike filter: last two readings as fed to the fit
+    float hist[2];
+    uint8_t hist_len;
+    uint8_t spike_run;
+
+    // Current block
+    float block_sum;
+    int64_t block_ts_sum;
+    uint8_t block_len;
+
+    // Previous block mean, the x of the next fit pair
+    bool have_prev;
+    float prev;
+    int64_t prev_ts;
+
+    // Running sums for y = c + k * x, centred on offset for float precision
+    float offset;
+    uint32_t n;
+    float sx, sy, sxx, sxy, syy;
+
+    float predictions[TEMP_EST_STABLE_POINTS];
+    uint8_t pred_len;
+    uint8_t pred_head;
+
+    float last;             // last accepted sample
+    uint32_t accepted;
+    uint32_t rejected;
+} temp_estimator_t;
+
+typedef struct {
+    float value_c;          // predicted final temperature, or the last sample without a fit
+    int confidence;         // 0..100
+    bool converged;         // prediction settled within TEMP_EST_TOLERANCE_C
+    uint32_t samples;       // accepted samples
+    uint32_t rejected;      // samples dropped as outliers
+} temp_estimate_t;
+
+void temp_est_init(temp_estimator_t *e, uint32_t period_us);
+
+// Feeds one reading; returns false when it was rejected as an outlier
+bool temp_est_add(temp_estimator_t *e, float t_c, int64_t timestamp_us);
+
+void temp_est_get(const temp_estimator_t *e, temp_estimate_t *out);
+
+#endif
@@ -1,8 +1,47 @@
 #ifndef TEMPERATURE_TRACKER_H
 #define TEMPERATURE_TRACKER_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+// Upper bound on a scan; most settle in a few seconds
+#define TEMP_SCAN_MAX_MS 10000
+
+typedef struct {
+    uint32_t reads_ok;
+    uint32_t reads_failed;      // reads that exhausted all retries
+    uint32_t retries;
+    uint32_t last_latency_us;   // request to valid value, including back-off
+    uint32_t max_latency_us;
+    uint32_t last_bus_hold_us;  // single transaction time
+    uint32_t max_bus_hold_us;
+} temperature_stats_t;
+
+typedef struct {
+    float value_c;      // predicted final temperature
+    int confidence;     // 0..100
+    bool converged;     // prediction has settled, the scan can stop
+    uint32_t samples;
+    uint32_t rejected;  // readings dropped as outliers
+    // Last reading in the estimate: vitals_store temperature sequence
+    // number and esp_timer time; timestamp_ms is 0 before the first one
+    uint32_t seq;
+    uint32_t timestamp_ms;
+} temperature_scan_t;
+
 void    temperature_init(void);
-void    temperature_update(void);
+// Asks for a new scan; safe from any task. temperature_tick() resets the
+// estimator before its next reading, which is fed every valid one after.
+void    temperature_start_scan(void);
+// Advances the acquisition state machine; performs at most one bus
+// transaction and never sleeps between retries.
+void    temperature_tick(void);
 float   temperature_get_data(void);
+// Sensor die temperature from the same transaction as the last object reading
+float   temperature_get_ambient(void);
+// esp_timer time of the last valid reading, 0 before the first one
+int64_t temperature_get_timestamp_us(void);
+void    temperature_get_scan(temperature_scan_t *out);
+void    temperature_get_stats(temperature_stats_t *out);
 
 #endif 
@@ -0,0 +1,203 @@
+#include "temp_estimator.h"
+#include <math.h>
+#include <string.h>
+
+static float absf(float v)
+{
+    return v < 0.0f ? -v : v;
+}
+
+void temp_est_init(temp_estimator_t *e, uint32_t period_us)
+{
+    memset(e, 0, sizeof(*e));
+    e->period_us = period_us;
+}
+
+// Fit of y = c + k * x over the pairs so far; false while it is degenerate
+static bool temp_est_fit(const temp_estimator_t *e, float *c, float *k)
+{
+    if (e->n < TEMP_EST_MIN_POINTS)
+        return false;
+
+    float n = (float)e->n;
+    float var_x = e->sxx - e->sx * e->sx / n;
+    if (var_x <= 1e-6f)
+        return false;
+
+    *k = (e->sxy - e->sx * e->sy / n) / var_x;
+    *c = (e->sy - *k * e->sx) / n;
+    return true;
+}
+
+static float temp_est_residual(const temp_estimator_t *e, float c, float k)
+{
+    // Sum of squared residuals expanded from the running sums
+    float n = (float)e->n;
+    float sse = e->syy - 2.0f * c * e->sy - 2.0f * k * e->sxy +
+                n * c * c + 2.0f * c * k * e->sx + k * k * e->sxx;
+    return sse > 0.0f ? sqrtf(sse / n) : 0.0f;
+}
+
+// Asymptote of the current fit; false when there is none to trust
+static bool temp_est_predict(const temp_estimator_t *e, float *out)
+{
+    float c, k;
+    if (!temp_est_fit(e, &c, &k))
+        return false;
+
+    // k outside (0, 1) is not an exponential approach; k near 1 means tau is
+    // far longer than the scan and the asymptote is not observable yet
+    if (k <= 0.0f || k >= 0.98f)
+        return false;
+
+    *out = c / (1.0f - k) + e->offset;
+    return true;
+}
+
+// A window whose fit points barely move is already at equilibrium: the
+// fit is degenerate or fits noise, and the answer is the reading itself
+static bool temp_est_flat(const temp_estimator_t *e)
+{
+    float n = (float)e->n;
+    float var_x = e->sxx - e->sx * e->sx / n;
+    return var_x <= n * TEMP_EST_FLAT_C * TEMP_EST_FLAT_C;
+}
+
+static void temp_est_close_block(temp_estimator_t *e)
+{
+    float mean = e->block_sum / e->block_len;
+    int64_t ts = e->block_ts_sum / e->block_len;
+    e->block_sum = 0.0f;
+    e->block_ts_sum = 0;
+    e->block_len = 0;
+
+    if (e->n == 0 && !e->have_prev)
+        e->offset = mean;
+
+    // The model needs a fixed step; a block that arrives late (retries,
+    // back-off) starts a new pair instead of skewing the fit
+    int64_t step = (int64_t)e->period_us * TEMP_EST_BLOCK;
+    if (e->have_prev && ts - e->prev_ts <= step + step / 2)
+    {
+        float x = e->prev - e->offset;
+        float y = mean - e->offset;
+        e->n++;
+        e->sx += x;
+        e->sy += y;
+        e->sxx += x * x;
+        e->sxy += x * y;
+        e->syy += y * y;
+    }
+
+    e->prev = mean;
+    e->prev_ts = ts;
+    e->have_prev = true;
+
+    if (e->n < TEMP_EST_MIN_POINTS)
+        return;
+
+    // Only consecutive valid fits count towards convergence; a rejected fit
+    // starts the stable window over rather than passing the raw reading off
+    // as a prediction, unless the window is flat and the reading is the
+    // final value
+    float p;
+    if (!temp_est_predict(e, &p))
+    {
+        if (!temp_est_flat(e))
+        {
+            e->pred_len = 0;
+            e->pred_head = 0;
+            return;
+        }
+        p = mean;
+    }
+    e->predictions[e->pred_head] = p;
+    e->pred_head = (e->pred_head + 1) % TEMP_EST_STABLE_POINTS;
+    if (e->pred_len < TEMP_EST_STABLE_POINTS)
+        e->pred_len++;
+}
+
+bool temp_est_add(temp_estimator_t *e, float t_c, int64_t timestamp_us)
+{
+    // Compare against a linear extrapolation of the last two accepted
+    // readings, which tracks the exponential rise; a lone spike is replaced by
+    // the extrapolated value so the fit keeps its fixed step, while a run of
+    // out-of-band readings is taken as a real step and re-seeds the filter
+    bool accept = true;
+    float expected = t_c;
+    if (e->hist_len == 2)
+    {
+        expected = 2.0f * e->hist[1] - e->hist[0];
+        if (absf(t_c - expected) > TEMP_EST_SPIKE_C && e->spike_run < TEMP_EST_SPIKE_RUN)
+        {
+            accept = false;
+            e->spike_run++;
+        }
+    }
+
+    if (accept)
+    {
+        if (e->spike_run)
+            e->hist_len = 0;
+        e->spike_run = 0;
+        expected = t_c;
+        e->accepted++;
+        e->last = t_c;
+    }
+    else
+    {
+        e->rejected++;
+    }
+
+    e->hist[0] = e->hist[1];
+    e->hist[1] = expected;
+    if (e->hist_len < 2)
+        e->hist_len++;
+
+    e->block_sum += expected;
+    e->block_ts_sum += timestamp_us;
+    if (++e->block_len == TEMP_EST_BLOCK)
+        temp_est_close_block(e);
+    return accept;
+}
+
+void temp_est_get(const temp_estimator_t *e, temp_estimate_t *out)
+{
+    out->samples = e->accepted;
+    out->rejected = e->rejected;
+    out->converged = false;
+    out->confidence = 0;
+
+    if (e->pred_len == 0)
+    {
+        out->value_c = e->accepted ? e->last : -273.15f;
+        return;
+    }
+
+    uint8_t newest = (e->pred_head + TEMP_EST_STABLE_POINTS - 1) % TEMP_EST_STABLE_POINTS;
+    float lo = e->predictions[0];
+    float hi = e->predictions[0];
+    for (uint8_t i = 1; i < e->pred_len; i++)
+    {
+        if (e->predictions[i] < lo)
+            lo = e->predictions[i];
+        if (e->predictions[i] > hi)
+            hi = e->predictions[i];
+    }
+    float spread = hi - lo;
+    out->value_c = e->predictions[newest];
+    out->converged = e->pred_len == TEMP_EST_STABLE_POINTS && spread <= TEMP_EST_TOLERANCE_C;
+
+    // Confidence: prediction stability, fit residual and outlier share
+    int conf_spread = 100 - (int)(spread * 50.0f / TEMP_EST_TOLERANCE_C);
+    int conf_noise = 100;
+    float c, k;
+    if (temp_est_fit(e, &c, &k))
+        conf_noise = 100 - (int)(temp_est_residual(e, c, k) * 100.0f / TEMP_EST_NOISE_LIMIT_C);
+
+    int confidence = conf_spread < conf_noise ? conf_spread : conf_noise;
+    if (confidence < 0)
+        confidence = 0;
+    uint32_t total = e->accepted + e->rejected;
+    out->confidence = (int)((int64_t)confidence * e->accepted / total);
+}
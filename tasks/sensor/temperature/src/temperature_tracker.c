@@ -1,53 +1,147 @@
 #include "temperature_task.h"
-#include "mlx90614.h"
+#include "temp_estimator.h"
+#include "sensor_hal.h"
+#include "vitals_store.h"
 #include "esp_log.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+
+#define TEMP_MAX_RETRY       5
+#define TEMP_RETRY_DELAY_US  500000
+#define TEMP_READ_PERIOD_US  100000
+
+typedef enum {
+    TEMP_STATE_IDLE,
+    TEMP_STATE_READ,
+    TEMP_STATE_BACKOFF,
+} temp_state_t;
 
 // static const char *TAG = "TEMP";
 static float s_temp = -273.15f;
 static float s_temp_backup = -273.15f;
+static float s_ambient = -273.15f;
+static int64_t s_sample_us = 0;
 static bool s_valid_temp = false;
+static uint32_t s_sample_seq = 0; // vitals_store sequence number of s_sample_us
+
+static temp_state_t s_state = TEMP_STATE_IDLE;
+static int s_attempt = 0;
+static int64_t s_request_us = 0;
+static int64_t s_next_us = 0;
+static temperature_stats_t s_stats;
+static temp_estimator_t s_scan;
+static atomic_bool s_scan_request = false; // set by any task, consumed by temperature_tick()
 
 void temperature_init(void)
 {
+    sensor_hal_temp_init();
     s_temp = -273.15f;
+    s_state = TEMP_STATE_IDLE;
+    s_next_us = 0;
+    temp_est_init(&s_scan, TEMP_READ_PERIOD_US);
 }
 
-void temperature_update(void)
+static void temperature_finish(int64_t now, bool ok)
 {
-    int max_retry = 5;
-    float last_valid = -273.15f;
-
-    for (int i = 0; i < max_retry; ++i)
+    if (ok)
+    {
+        uint32_t latency = (uint32_t)(now - s_request_us);
+        s_stats.reads_ok++;
+        s_stats.last_latency_us = latency;
+        if (latency > s_stats.max_latency_us)
+            s_stats.max_latency_us = latency;
+    }
+    else
     {
-        float t = mlx90614_read_temp();
+        // ESP_LOGE(TAG, "Failed to get valid temperature in this round.");
+        s_stats.reads_failed++;
+        s_temp = s_temp_backup;
+    }
 
-        if (t > -273.15f)
-        {
-            last_valid = t;
-            // ESP_LOGI(TAG, "Temperature: %.2f C", t);
-            printf("%.2f\n", t);
-            break;
-        }
-        else
+    s_state = TEMP_STATE_IDLE;
+    s_next_us = s_request_us + TEMP_READ_PERIOD_US;
+}
+
+static void temperature_read_once(void)
+{
+    int64_t start = esp_timer_get_time();
+    mlx90614_reading_t r;
+    esp_err_t err = sensor_hal_temp_read(&r);
+    int64_t now = r.timestamp_us;
+
+    uint32_t hold = (uint32_t)(now - start);
+    s_stats.last_bus_hold_us = hold;
+    if (hold > s_stats.max_bus_hold_us)
+        s_stats.max_bus_hold_us = hold;
+
+    if (err == ESP_OK)
+    {
+        float t = r.object_c;
+        // ESP_LOGI(TAG, "Temperature: %.2f C", t);
+        printf("%.2f\n", t);
+        s_temp = t;
+        s_temp_backup = t;
+        s_ambient = r.ambient_c;
+        s_sample_us = r.timestamp_us;
+        temp_est_add(&s_scan, t, r.timestamp_us);
+        s_sample_seq = vitals_add_temp(vitals_store(), r.timestamp_us, t, r.ambient_c);
+        if (sensor_hal_is_replay())
         {
-            // ESP_LOGW(TAG, "mlx90614_read_temp failed (retry %d)", i + 1);
+            temp_estimate_t est;
+            temp_est_get(&s_scan, &est);
+            float rec[] = {t, est.value_c, (float)est.confidence};
+            sensor_hal_note_output(rec, sizeof(rec));
         }
+        s_valid_temp = true;
+        temperature_finish(now, true);
+        return;
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(500));
+    // ESP_LOGW(TAG, "mlx90614_read failed (retry %d)", s_attempt + 1);
+    if (++s_attempt >= TEMP_MAX_RETRY)
+    {
+        temperature_finish(now, false);
+        return;
     }
 
-    if (last_valid > -273.15f)
+    // Back off without sleeping so the bus is released between attempts
+    s_stats.retries++;
+    s_next_us = now + TEMP_RETRY_DELAY_US;
+    s_state = TEMP_STATE_BACKOFF;
+}
+
+void temperature_start_scan(void)
+{
+    atomic_store(&s_scan_request, true);
+}
+
+void temperature_tick(void)
+{
+    // The estimator is only ever reset here, between readings
+    if (atomic_exchange(&s_scan_request, false))
     {
-        s_temp = last_valid;
-        s_temp_backup = last_valid;
-        s_valid_temp = true;
+        s_temp = -273.15f;
+        temp_est_init(&s_scan, TEMP_READ_PERIOD_US);
     }
-    else
+
+    int64_t now = esp_timer_get_time();
+    if (now < s_next_us)
+        return;
+
+    switch (s_state)
     {
-        // ESP_LOGE(TAG, "Failed to get valid temperature in this round.");
-        s_temp = s_temp_backup;
+    case TEMP_STATE_IDLE:
+        s_request_us = now;
+        s_attempt = 0;
+        s_state = TEMP_STATE_READ;
+        temperature_read_once();
+        break;
+
+    case TEMP_STATE_READ:
+    case TEMP_STATE_BACKOFF:
+        s_state = TEMP_STATE_READ;
+        temperature_read_once();
+        break;
     }
 }
 
@@ -55,3 +149,38 @@ float temperature_get_data(void)
 {
     return s_temp;
 }
+
+float temperature_get_ambient(void)
+{
+    return s_ambient;
+}
+
+int64_t temperature_get_timestamp_us(void)
+{
+    return s_sample_us;
+}
+
+void temperature_get_scan(temperature_scan_t *out)
+{
+    // A scan that has not started yet must not report the previous result
+    if (atomic_load(&s_scan_request))
+    {
+        *out = (temperature_scan_t){.value_c = -273.15f};
+        return;
+    }
+
+    temp_estimate_t est;
+    temp_est_get(&s_scan, &est);
+    out->value_c = est.value_c;
+    out->confidence = est.confidence;
+    out->converged = est.converged;
+    out->samples = est.samples;
+    out->rejected = est.rejected;
+    out->seq = s_sample_seq;
+    out->timestamp_ms = est.samples ? (uint32_t)(s_sample_us / 1000) : 0;
+}
+
+void temperature_get_stats(temperature_stats_t *out)
+{
+    *out = s_stats;
+}
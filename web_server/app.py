@@ -1,4 +1,5 @@
 from flask import Flask, render_template, request, jsonify
+import base64
 import json
 import os
 import time
@@ -18,10 +19,34 @@ def save_data(data):
     with open(DATA_FILE, "w") as f:
         json.dump(data, f, indent=4)
 
+def decode_track(b64):
+    """Expands a GPS track batch into [lat, lon, unix_time] points.
+
+    Format 1: version byte, then zigzag varints of lat/lon in 1e-6 degrees
+    and time in 0.1 s; absolute for the first point, deltas after it.
+    """
+    buf = base64.b64decode(b64)
+    if not buf or buf[0] != 1:
+        return []
+    vals, u, shift = [], 0, 0
+    for b in buf[1:]:
+        u |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            vals.append((u >> 1) ^ -(u & 1))
+            u, shift = 0, 0
+    points, lat, lon, t = [], 0, 0, 0
+    for i in range(0, len(vals) - 2, 3):
+        lat, lon, t = lat + vals[i], lon + vals[i + 1], t + vals[i + 2]
+        points.append([lat / 1e6, lon / 1e6, t / 10])
+    return points
+
 def start_mqtt():
     def on_message(c, u, msg):
         try:
             data = json.loads(msg.payload.decode())
+            if "track" in data:
+                data["track"] = decode_track(data["track"])
             data["_last_ts"] = time.time()
             cur = read_data(); cur.update(data); save_data(cur)
         except Exception as e: